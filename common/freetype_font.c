@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -19,7 +20,12 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_OUTLINE_H
 #include "image.h"
+#include "imageCommands.h"
+#include "imageText.h"
+#include "freetype_font.h"
+#include "utf8.h"
 
 #ifdef DMALLOC
 #include "dmalloc.h"
@@ -36,30 +42,20 @@ void draw_bitmap_Indexed( FT_Bitmap* bitmap, FT_Int x, FT_Int y, IMAGE_T *image,
 		int dy = ddy - (y_max - j) + (bitmap->rows - y);
 		for ( i = x, p = 0; i < x_max; i++, p++ ) {
 			if ( i < 0 || j < 0 || i >= mx || j >= my ) continue;
-			uint8_t  src = bitmap->buffer[q * bitmap->width + p];
+			uint8_t  src = bitmap->buffer[q * bitmap->pitch + p];
 			if (src > 127) setPixelIndexed( image, ddx + i, dy, 1, index );
 		}
 	}
 }
 
 void draw_bitmap_RGB( FT_Bitmap* bitmap, FT_Int x, FT_Int y, IMAGE_T *image, int ddx, int ddy, const RGBA8_T *rgb ) {
-	FT_Int  i, j, p, q;
-	FT_Int  x_max = x + bitmap->width;
+	FT_Int  j, q;
 	FT_Int  y_max = y + bitmap->rows;
-	int	mx = image->width;
-	int	my = image->height;
-	RGBA8_T my_rgb = *rgb;
 
+	// one blend per glyph row, the grey levels are the coverage. blendSpanRGBA clips to the clip rectangle.
 	for ( j = y, q = 0; j < y_max; j++, q++ ) {
 		int dy = ddy - (y_max - j) + (bitmap->rows - y);
-		for ( i = x, p = 0; i < x_max; i++, p++ ) {
-			if ( i < 0 || dy < 0 || i >= mx || dy >= my ) continue;
-			uint8_t  src = bitmap->buffer[q * bitmap->width + p];
-			if (src == 0) continue;
-
-			my_rgb.alpha = src;
-			setPixelRGBA( image, ddx + i, dy, 1, &my_rgb ); // use alpha blend
-		}
+		blendSpanRGBA( image, ddx + x, dy, bitmap->width, rgb, bitmap->buffer + (q * bitmap->pitch) );
 	}
 }
 
@@ -77,6 +73,8 @@ void drop_last_space_in_string( char *string ) {
 static FT_Library	library;
 static FT_Face		*font_face = NULL;
 static char		**font_names;
+static int		*font_fallback;		// font tried for missing characters, or -1
+static struct FT_CHARMAP_T_ **font_charmap;	// cached glyph indices, made on first use
 static int		fonts = 0;
 static int		max_fonts = 0;
 
@@ -97,7 +95,10 @@ uint8_t load_Freetype_Font( const char *font_name ) {
 	if (fonts == 0) {
 		font_face = calloc(10, sizeof(FT_Face) );
 		font_names = calloc(10, sizeof(char *) );
+		font_fallback = calloc(10, sizeof(int) );
+		font_charmap = calloc(10, sizeof(*font_charmap) );
 		font_names[0] = strdup( font_name );
+		font_fallback[0] = -1;
 		FT_New_Face( library, font_name, 0, &( font_face[0] ) );
 		fonts++;
 		max_fonts = 10;
@@ -112,168 +113,688 @@ uint8_t load_Freetype_Font( const char *font_name ) {
 		max_fonts += 10;
 		font_face = realloc( font_face, sizeof(FT_Face) * max_fonts );
 		font_names = realloc( font_names, sizeof(char *) * max_fonts );
+		font_fallback = realloc( font_fallback, sizeof(int) * max_fonts );
+		font_charmap = realloc( font_charmap, sizeof(*font_charmap) * max_fonts );
 	}
 	font_names[fonts] = strdup( font_name );
+	font_fallback[fonts] = -1;
+	font_charmap[fonts] = NULL;
 	FT_New_Face( library, font_name, 0, &( font_face[fonts] ) );
 	fonts++;
 	return(fonts - 1);
 }
 
-/* CHAR *******************************************************************************************************/
-/* CHAR *******************************************************************************************************/
+/* CHARACTER MAP **********************************************************************************************/
+/* CHARACTER MAP **********************************************************************************************/
 
-int measure_FT_Char( uint8_t c, uint8_t font, uint16_t size ) {
-	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
-	FT_Error	error;
+// The glyph index of each character is looked up once and kept in a hash for the font, with the font that has it:
+// characters the font does not have are looked for in its fallback fonts.
+
+#define FT_CHARMAP_ENTRIES	1024
+#define FT_NO_CODEPOINT		0xFFFFFFFF
+
+typedef struct FT_CHARMAP_T_ {
+	uint32_t	c;		// FT_NO_CODEPOINT for an unused entry
+	uint8_t		font;
+	FT_UInt		index;
+} FT_CHARMAP_T;
+
+void set_FT_Fallback_Font( uint8_t font, uint8_t fallback ) {
+	int i, j;
+
+	assert(font < fonts && fallback < fonts);
+	font_fallback[font] = (fallback == font) ? -1 : fallback;
+
+	// fallback chains can pass through any font, so forget every cached lookup
+	for (i = 0; i < fonts; i++) {
+		if (font_charmap[i] == NULL) continue;
+		for (j = 0; j < FT_CHARMAP_ENTRIES; j++) font_charmap[i][j].c = FT_NO_CODEPOINT;
+	}
+}
+
+static void get_FT_Glyph_Index( uint32_t c, uint8_t font, uint8_t *glyph_font, FT_UInt *index ) {
+	FT_CHARMAP_T	*entry;
+	int		f, n;
 
 	assert(font < fonts);
-	g_slot = font_face[font]->glyph;
 
-	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
-	assert(error == 0);
+	if (font_charmap[font] == NULL) {
+		font_charmap[font] = malloc( FT_CHARMAP_ENTRIES * sizeof(FT_CHARMAP_T) );
+		if (font_charmap[font] == NULL) {
+			fprintf(stderr, "freetype_font: memory exhausted\n");
+			exit(EXIT_FAILURE);
+		}
+		for (n = 0; n < FT_CHARMAP_ENTRIES; n++) font_charmap[font][n].c = FT_NO_CODEPOINT;
+	}
 
-	pen.x = 20; pen.y = 20;
+	entry = &font_charmap[font][((c * 2654435761u) >> 16) & (FT_CHARMAP_ENTRIES - 1)];
+
+	if (entry->c != c) {
+		f = font;
+		entry->index = FT_Get_Char_Index( font_face[f], c );
 
-	FT_Set_Transform( font_face[font], 0, &pen );
-	error = FT_Load_Char( font_face[font], c, FT_LOAD_RENDER );
-	if ( error )  return 0;                 /* ignore errors */
+		// n stops a loop of fallbacks
+		for (n = 0; entry->index == 0 && font_fallback[f] >= 0 && n < fonts; n++) {
+			f = font_fallback[f];
+			entry->index = FT_Get_Char_Index( font_face[f], c );
+		}
+		if (entry->index == 0) f = font;	/* the font's own missing glyph */
 
-	return( g_slot->bitmap_left + g_slot->bitmap.width );
+		entry->c = c;
+		entry->font = f;
+	}
+
+	*glyph_font = entry->font;
+	*index = entry->index;
+}
+
+/* GLYPH CACHE ************************************************************************************************/
+/* GLYPH CACHE ************************************************************************************************/
+
+// Rendered glyphs are kept in one 8 bit coverage atlas, keyed by font, size, glyph index and the fraction of a
+// pixel of the pen position (FreeType renders a glyph differently at each). The atlas is packed in shelves: rows
+// of glyphs of about the same height. When there is no room the least recently used shelf that is tall enough
+// is emptied and reused, so drawing text that was drawn recently costs only blits from the atlas.
+
+#define FT_ATLAS_SIZE		512
+#define FT_ATLAS_SHELVES	(FT_ATLAS_SIZE / 4)
+#define FT_GLYPH_ENTRIES	1024
+#define FT_GLYPH_BUCKETS	2048
+
+typedef struct {
+	FT_UInt		index;
+	uint16_t	size;
+	uint8_t		font;
+	uint16_t	fraction;	// pen position modulo one pixel, x and y in 26.6
+	int		left;		// bitmap position relative to the pen's whole pixel
+	int		top;
+	int		width;
+	int		rows;
+	int		atlas_x;
+	int		atlas_y;
+	FT_Vector	advance;
+	int		shelf;		// -1 for glyphs without pixels, or unused entries
+	int		next;		// hash chain, or free list
+} FT_GLYPH_T;
+
+typedef struct {
+	int		y;
+	int		height;
+	int		used;
+	uint32_t	stamp;
+} FT_SHELF_T;
+
+static uint8_t		*ft_atlas = NULL;
+static FT_SHELF_T	ft_shelves[FT_ATLAS_SHELVES];
+static int		ft_shelf_count = 0;
+static int		ft_shelf_bottom = 0;
+static FT_GLYPH_T	ft_glyphs[FT_GLYPH_ENTRIES];
+static int		ft_buckets[FT_GLYPH_BUCKETS];
+static int		ft_free_glyph = -1;
+static uint32_t		ft_stamp = 0;
+
+void flush_FT_Glyph_Cache( void ) {
+	int i;
+
+	for (i = 0; i < FT_GLYPH_BUCKETS; i++) ft_buckets[i] = -1;
+	for (i = 0; i < FT_GLYPH_ENTRIES; i++) {
+		ft_glyphs[i].shelf = -1;
+		ft_glyphs[i].next = (i + 1 < FT_GLYPH_ENTRIES) ? i + 1 : -1;
+	}
+	ft_free_glyph = 0;
+	ft_shelf_count = 0;
+	ft_shelf_bottom = 0;
+}
+
+static unsigned ft_glyph_hash( FT_UInt index, uint8_t font, uint16_t size, uint16_t fraction ) {
+	uint32_t h = (index * 2654435761u) ^ (font * 40503u) ^ (size * 69069u) ^ (fraction * 2246822519u);
+	return (h ^ (h >> 15)) & (FT_GLYPH_BUCKETS - 1);
+}
+
+static void ft_unlink_glyph( int g ) {
+	FT_GLYPH_T	*glyph = &ft_glyphs[g];
+	int		*link = &ft_buckets[ft_glyph_hash( glyph->index, glyph->font, glyph->size, glyph->fraction )];
+
+	while (*link != g) link = &ft_glyphs[*link].next;
+	*link = glyph->next;
+
+	glyph->shelf = -1;
+	glyph->next = ft_free_glyph;
+	ft_free_glyph = g;
+}
+
+static void ft_empty_shelf( int s ) {
+	int g;
+
+	for (g = 0; g < FT_GLYPH_ENTRIES; g++) {
+		if (ft_glyphs[g].shelf == s) ft_unlink_glyph( g );
+	}
+	ft_shelves[s].used = 0;
 }
 
-void draw_FT_CharIndexed( int x, int y, uint8_t c, uint8_t font, uint16_t size, int8_t index, IMAGE_T *image) {
+// Find room for a bitmap in the atlas. Returns the shelf, or -1 if the bitmap can never fit.
+static int ft_atlas_place( int width, int rows, int *x, int *y ) {
+	int	height = (rows + 3) & ~3;
+	int	s, best = -1;
+
+	if (width > FT_ATLAS_SIZE || height > FT_ATLAS_SIZE) return -1;
+
+	// the shortest shelf with room that does not waste more than half its height
+	for (s = 0; s < ft_shelf_count; s++) {
+		FT_SHELF_T *shelf = &ft_shelves[s];
+		if (shelf->height >= height && shelf->height <= height + height / 2 &&
+		    shelf->used + width <= FT_ATLAS_SIZE &&
+		    (best < 0 || shelf->height < ft_shelves[best].height)) best = s;
+	}
+
+	if (best < 0 && ft_shelf_bottom + height <= FT_ATLAS_SIZE && ft_shelf_count < FT_ATLAS_SHELVES) {
+		best = ft_shelf_count++;
+		ft_shelves[best].y = ft_shelf_bottom;
+		ft_shelves[best].height = height;
+		ft_shelves[best].used = 0;
+		ft_shelf_bottom += height;
+	}
+
+	// otherwise reuse the least recently used shelf that is tall enough
+	if (best < 0) {
+		for (s = 0; s < ft_shelf_count; s++) {
+			if (ft_shelves[s].height >= height &&
+			    (best < 0 || ft_shelves[s].stamp < ft_shelves[best].stamp)) best = s;
+		}
+		if (best < 0) {
+			flush_FT_Glyph_Cache();
+			return ft_atlas_place( width, rows, x, y );
+		}
+		ft_empty_shelf( best );
+	}
+
+	*x = ft_shelves[best].used;
+	*y = ft_shelves[best].y;
+	ft_shelves[best].used += width;
+	return best;
+}
+
+// The bitmap, position and advance of glyph index of font drawn with the pen at pen (in 26.6), as FreeType would give them in
+// its glyph slot. The bitmap stays valid until the next glyph is fetched.
+static FT_Error get_FT_Glyph( FT_UInt index, uint8_t font, uint16_t size, const FT_Vector *pen,
+                              FT_Bitmap *bitmap, int *left, int *top, FT_Vector *advance ) {
+	uint16_t	fraction = (pen->x & 63) | ((pen->y & 63) << 6);
+	int		px = pen->x >> 6, py = pen->y >> 6;
+	unsigned	h = ft_glyph_hash( index, font, size, fraction );
+	FT_GLYPH_T	*glyph;
 	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
+	FT_Vector	origin;
 	FT_Error	error;
+	int		g, s, x, y, j;
 
 	assert(font < fonts);
+
+	if (ft_atlas == NULL) {
+		ft_atlas = calloc( FT_ATLAS_SIZE, FT_ATLAS_SIZE );
+		if (ft_atlas == NULL) {
+			fprintf(stderr, "freetype_font: memory exhausted\n");
+			exit(EXIT_FAILURE);
+		}
+		flush_FT_Glyph_Cache();
+	}
+
+	++ft_stamp;
+
+	for (g = ft_buckets[h]; g >= 0; g = ft_glyphs[g].next) {
+		glyph = &ft_glyphs[g];
+		if (glyph->index == index && glyph->font == font && glyph->size == size && glyph->fraction == fraction) {
+			if (glyph->shelf >= 0) ft_shelves[glyph->shelf].stamp = ft_stamp;
+			memset( bitmap, 0, sizeof(*bitmap) );
+			bitmap->rows = glyph->rows;
+			bitmap->width = glyph->width;
+			bitmap->pitch = FT_ATLAS_SIZE;
+			bitmap->buffer = ft_atlas + glyph->atlas_y * FT_ATLAS_SIZE + glyph->atlas_x;
+			bitmap->num_grays = 256;
+			bitmap->pixel_mode = FT_PIXEL_MODE_GRAY;
+			*left = px + glyph->left;
+			*top = py + glyph->top;
+			*advance = glyph->advance;
+			return 0;
+		}
+	}
+
+	// not cached, render it with the pen at the same fraction of a pixel
 	g_slot = font_face[font]->glyph;
 
 	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
 	assert(error == 0);
 
-	pen.x = 20; pen.y = 20;
+	origin.x = pen->x & 63;
+	origin.y = pen->y & 63;
+	FT_Set_Transform( font_face[font], 0, &origin );
+	error = FT_Load_Glyph( font_face[font], index, FT_LOAD_RENDER );
+	if ( error )  return error;
 
-	FT_Set_Transform( font_face[font], 0, &pen );
-	error = FT_Load_Char( font_face[font], c, FT_LOAD_RENDER );
-	if ( error )  return;                 /* ignore errors */
+	*bitmap = g_slot->bitmap;
+	*left = px + g_slot->bitmap_left;
+	*top = py + g_slot->bitmap_top;
+	*advance = g_slot->advance;
 
-	draw_bitmap_Indexed( &g_slot->bitmap, g_slot->bitmap_left, g_slot->bitmap_top, image, x, y, index );
+	if (bitmap->pixel_mode != FT_PIXEL_MODE_GRAY) return 0;
+
+	s = -1;
+	x = y = 0;
+	if (bitmap->width > 0 && bitmap->rows > 0) {
+		s = ft_atlas_place( bitmap->width, bitmap->rows, &x, &y );
+		if (s < 0) return 0;		/* too big to cache, draw from the slot */
+	}
+
+	if (ft_free_glyph < 0) {
+		flush_FT_Glyph_Cache();
+		if (bitmap->width > 0 && bitmap->rows > 0) s = ft_atlas_place( bitmap->width, bitmap->rows, &x, &y );
+	}
+
+	g = ft_free_glyph;
+	glyph = &ft_glyphs[g];
+	ft_free_glyph = glyph->next;
+
+	glyph->index = index;
+	glyph->size = size;
+	glyph->font = font;
+	glyph->fraction = fraction;
+	glyph->left = g_slot->bitmap_left;
+	glyph->top = g_slot->bitmap_top;
+	glyph->width = bitmap->width;
+	glyph->rows = bitmap->rows;
+	glyph->atlas_x = x;
+	glyph->atlas_y = y;
+	glyph->advance = g_slot->advance;
+	glyph->shelf = s;
+	glyph->next = ft_buckets[h];
+	ft_buckets[h] = g;
+
+	if (s >= 0) {
+		ft_shelves[s].stamp = ft_stamp;
+		for (j = 0; j < glyph->rows; j++) {
+			memcpy( ft_atlas + (y + j) * FT_ATLAS_SIZE + x, bitmap->buffer + j * bitmap->pitch, glyph->width );
+		}
+		bitmap->buffer = ft_atlas + y * FT_ATLAS_SIZE + x;
+		bitmap->pitch = FT_ATLAS_SIZE;
+	}
+
+	return 0;
 }
 
-void draw_FT_CharRGB( int x, int y, uint8_t c, uint8_t font, uint16_t size, const RGBA8_T *rgb, IMAGE_T *image) {
-	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
+/* METRICS ****************************************************************************************************/
+/* METRICS ****************************************************************************************************/
+
+// Layout only needs the advance and the extent of each glyph, so these are loaded without rendering and kept in a
+// table for each font and size, direct mapped by glyph index. The least recently used table is reused for a new
+// font and size.
+
+#define FT_METRIC_TABLES	8
+#define FT_METRIC_GLYPHS	512
+#define FT_NO_GLYPH		0xFFFFFFFF
+
+typedef struct {
+	FT_UInt		index;		// FT_NO_GLYPH if not loaded
+	int		ink;		// false for glyphs without an outline
+	FT_Pos		advance;	// pen advance in 26.6
+	FT_Pos		right;		// right edge of the outline from the pen, in 26.6
+} FT_METRIC_T;
+
+typedef struct {
+	uint16_t	size;		// 0 for an unused table
+	uint8_t		font;
+	uint32_t	stamp;
+	FT_Fixed	x_scale;	// font units to 26.6, for kerning
+	FT_Pos		ascent;		// line metrics in 26.6
+	FT_Pos		descent;
+	FT_Pos		height;
+	FT_METRIC_T	glyphs[FT_METRIC_GLYPHS];
+} FT_METRICS_T;
+
+static FT_METRICS_T	ft_metrics[FT_METRIC_TABLES];
+static uint32_t		ft_metrics_stamp = 0;
+
+static FT_METRICS_T *get_FT_Metrics( uint8_t font, uint16_t size ) {
+	FT_METRICS_T	*table = NULL;
 	FT_Error	error;
+	int		i;
 
 	assert(font < fonts);
-	g_slot = font_face[font]->glyph;
 
-	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
+	for (i = 0; i < FT_METRIC_TABLES; i++) {
+		if (ft_metrics[i].size == size && ft_metrics[i].font == font) {
+			table = &ft_metrics[i];
+			break;
+		}
+		if (table == NULL || ft_metrics[i].stamp < table->stamp) table = &ft_metrics[i];
+	}
+
+	if (table->size != size || table->font != font) {
+		error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
+		assert(error == 0);
+
+		table->size = size;
+		table->font = font;
+		table->x_scale = font_face[font]->size->metrics.x_scale;
+		table->ascent = font_face[font]->size->metrics.ascender;
+		table->descent = -font_face[font]->size->metrics.descender;
+		table->height = font_face[font]->size->metrics.height;
+		for (i = 0; i < FT_METRIC_GLYPHS; i++) table->glyphs[i].index = FT_NO_GLYPH;
+	}
+
+	table->stamp = ++ft_metrics_stamp;
+	return table;
+}
+
+static const FT_METRIC_T *get_FT_Metric( FT_METRICS_T *table, FT_UInt index ) {
+	FT_METRIC_T	*metric = &table->glyphs[index & (FT_METRIC_GLYPHS - 1)];
+	FT_Face		face = font_face[table->font];
+	FT_BBox		box;
+	FT_Error	error;
+
+	if (metric->index == index) return metric;
+
+	metric->index = index;
+	metric->ink = 0;
+	metric->advance = 0;
+	metric->right = 0;
+
+	error = FT_Set_Char_Size( face, table->size * 18, table->size * 27, 256, 256 );
 	assert(error == 0);
 
-	pen.x = 20; pen.y = 20;
+	FT_Set_Transform( face, 0, 0 );
+	error = FT_Load_Glyph( face, index, FT_LOAD_DEFAULT );
+	if ( error )  return metric;
 
-	FT_Set_Transform( font_face[font], 0, &pen );
-	error = FT_Load_Char( font_face[font], c, FT_LOAD_RENDER );
-	if ( error )  return;                 /* ignore errors */
+	metric->advance = face->glyph->advance.x;
 
-	draw_bitmap_RGB( &g_slot->bitmap, g_slot->bitmap_left, g_slot->bitmap_top, image, x, y, rgb );
+	if (face->glyph->format == FT_GLYPH_FORMAT_OUTLINE && face->glyph->outline.n_points > 0) {
+		FT_Outline_Get_CBox( &face->glyph->outline, &box );
+		metric->right = box.xMax;
+		metric->ink = 1;
+	}
+	return metric;
 }
 
-/* STRING *******************************************************************************************************/
-/* STRING *******************************************************************************************************/
+// The kerning between two glyphs in 26.6, rounded to a whole pixel.
+static FT_Pos kern_FT_Pair( FT_METRICS_T *table, FT_UInt prev, FT_UInt index ) {
+	FT_Face		face = font_face[table->font];
+	FT_Vector	delta;
 
+	if (!FT_HAS_KERNING( face )) return 0;
 
-int measure_FT_String( char *string, uint8_t font, uint16_t size) {
-	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
+	if (FT_Get_Kerning( face, prev, index, FT_KERNING_UNSCALED, &delta ) != 0) return 0;
+	return (FT_MulFix( delta.x, table->x_scale ) + 32) & ~63;
+}
+
+/* LAYOUT *****************************************************************************************************/
+/* LAYOUT *****************************************************************************************************/
+
+// Strings are UTF-8. Each character is drawn from the first of the font and its fallbacks that has it, and
+// glyphs next to each other from the same font are kerned.
+
+typedef struct {
+	const char	*next;		// the rest of the string
+	uint8_t		font;
+	uint16_t	size;
+	FT_Vector	pen;		// 26.6
+	int		prev_font;	// font of the glyph before, or -1
+	FT_UInt		prev_glyph;
+} FT_LAYOUT_T;
+
+static void start_FT_Layout( FT_LAYOUT_T *layout, const char *string, uint8_t font, uint16_t size ) {
+	layout->next = string;
+	layout->font = font;
+	layout->size = size;
+	layout->pen.x = 20; layout->pen.y = 20;
+	layout->prev_font = -1;
+	layout->prev_glyph = 0;
+}
+
+// Decode the next character, find its glyph and kern the pen. The caller moves the pen by the advance.
+static FT_METRICS_T *next_FT_Layout( FT_LAYOUT_T *layout, uint32_t *c, uint8_t *glyph_font, FT_UInt *glyph ) {
+	FT_METRICS_T *table;
+
+	decodeUtf8( &layout->next, c );
+	get_FT_Glyph_Index( *c, layout->font, glyph_font, glyph );
+
+	table = get_FT_Metrics( *glyph_font, layout->size );
+	if (layout->prev_font == *glyph_font) layout->pen.x += kern_FT_Pair( table, layout->prev_glyph, *glyph );
+
+	layout->prev_font = *glyph_font;
+	layout->prev_glyph = *glyph;
+	return table;
+}
+
+void measure_FT_Text( const char *string, uint8_t font, uint16_t size, FT_TEXT_METRICS_T *metrics ) {
+	FT_METRICS_T		*table = get_FT_Metrics( font, size );
+	const FT_METRIC_T	*metric;
+	FT_LAYOUT_T		layout;
+	FT_UInt			glyph;
+	uint8_t			glyph_font;
+	uint32_t		c;
+
+	metrics->width = 0;
+	metrics->ascent = (table->ascent + 63) >> 6;
+	metrics->descent = (table->descent + 63) >> 6;
+	metrics->height = (table->height + 63) >> 6;
+
+	start_FT_Layout( &layout, string, font, size );
+
+	while (*layout.next != '\0') {
+		table = next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+		metric = get_FT_Metric( table, glyph );
+
+		// trailing spaces do not count, as with measure_FT_String
+		if (c != ' ') {
+			if (metric->ink) metrics->width = (layout.pen.x + metric->right + 63) >> 6;
+			else metrics->width = layout.pen.x >> 6;
+		}
+		layout.pen.x += metric->advance;
+	}
+
+	metrics->advance = layout.pen.x >> 6;
+}
+
+/* CHAR *******************************************************************************************************/
+/* CHAR *******************************************************************************************************/
+
+int measure_FT_Char( uint32_t c, uint8_t font, uint16_t size ) {
+	const FT_METRIC_T	*metric;
+	FT_UInt			glyph;
+	uint8_t			glyph_font;
+
+	if (c == ' ') return 0;
+
+	get_FT_Glyph_Index( c, font, &glyph_font, &glyph );
+	metric = get_FT_Metric( get_FT_Metrics( glyph_font, size ), glyph );
+
+	return metric->ink ? (20 + metric->right + 63) >> 6 : 0;
+}
+
+void draw_FT_CharIndexed( int x, int y, uint32_t c, uint8_t font, uint16_t size, int8_t index, IMAGE_T *image) {
+	FT_Bitmap	bitmap;
+	FT_Vector	pen, advance;
 	FT_Error	error;
-	int		n, nc;
+	FT_UInt		glyph;
+	uint8_t		glyph_font;
+	int		left, top;
 
-	drop_last_space_in_string( string );
+	pen.x = 20; pen.y = 20;
 
-	assert(font < fonts);
-	g_slot = font_face[font]->glyph;
+	get_FT_Glyph_Index( c, font, &glyph_font, &glyph );
+	error = get_FT_Glyph( glyph, glyph_font, size, &pen, &bitmap, &left, &top, &advance );
+	if ( error )  return;                 /* ignore errors */
 
-	nc = strlen( string );
-	if (nc == 0) return 0;
+	draw_bitmap_Indexed( &bitmap, left, top, image, x, y, index );
+}
 
-	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
-	assert(error == 0);
+void draw_FT_CharRGB( int x, int y, uint32_t c, uint8_t font, uint16_t size, const RGBA8_T *rgb, IMAGE_T *image) {
+	FT_Bitmap	bitmap;
+	FT_Vector	pen, advance;
+	FT_Error	error;
+	FT_UInt		glyph;
+	uint8_t		glyph_font;
+	int		left, top;
 
 	pen.x = 20; pen.y = 20;
-	int max_x = 0;
 
-	for (n = 0; n < nc; n++ ) {
-		FT_Set_Transform( font_face[font], 0, &pen );
-		error = FT_Load_Char( font_face[font], string[n], FT_LOAD_RENDER );
-		if ( error )  return(max_x);                 /* ignore errors */
+	get_FT_Glyph_Index( c, font, &glyph_font, &glyph );
+	error = get_FT_Glyph( glyph, glyph_font, size, &pen, &bitmap, &left, &top, &advance );
+	if ( error )  return;                 /* ignore errors */
+
+	draw_bitmap_RGB( &bitmap, left, top, image, x, y, rgb );
+}
 
-		max_x = g_slot->bitmap.width + g_slot->bitmap_left;
-		pen.x += g_slot->advance.x;
-		pen.y += g_slot->advance.y;
-	}
-	return( max_x );
+/* STRING *******************************************************************************************************/
+/* STRING *******************************************************************************************************/
+
+
+int measure_FT_String( char *string, uint8_t font, uint16_t size) {
+	FT_TEXT_METRICS_T	metrics;
+
+	drop_last_space_in_string( string );
+
+	measure_FT_Text( string, font, size, &metrics );
+	return metrics.width;
 }
 
 void draw_FT_StringIndexed( int x, int y, char *string, uint8_t font, uint16_t size, int8_t index, IMAGE_T *image) {
-	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
+	FT_LAYOUT_T	layout;
+	FT_Bitmap	bitmap;
+	FT_Vector	advance;
 	FT_Error	error;
-	int		n, nc;
+	FT_UInt		glyph;
+	uint8_t		glyph_font;
+	uint32_t	c;
+	int		left, top;
 
 	drop_last_space_in_string( string );
 
-	assert(font < fonts);
-	g_slot = font_face[font]->glyph;
+	start_FT_Layout( &layout, string, font, size );
 
-	nc = strlen( string );
-	if (nc == 0) return;
+	while (*layout.next != '\0') {
+		next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+		error = get_FT_Glyph( glyph, glyph_font, size, &layout.pen, &bitmap, &left, &top, &advance );
+		if ( error )  return;                 /* ignore errors */
 
-	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
-	assert(error == 0);
+		draw_bitmap_Indexed( &bitmap, left, top, image, x, y, index );
+		layout.pen.x += advance.x;
+		layout.pen.y += advance.y;
+	}
+}
 
-	pen.x = 20; pen.y = 20;
+static void draw_FT_TextRGB( int x, int y, const char *string, uint8_t font, uint16_t size, const RGBA8_T *rgb, IMAGE_T *image) {
+	FT_LAYOUT_T	layout;
+	FT_Bitmap	bitmap;
+	FT_Vector	advance;
+	FT_Error	error;
+	FT_UInt		glyph;
+	uint8_t		glyph_font;
+	uint32_t	c;
+	int		left, top;
 
-	for (n = 0; n < nc; n++ ) {
-		FT_Set_Transform( font_face[font], 0, &pen );
-		error = FT_Load_Char( font_face[font], string[n], FT_LOAD_RENDER );
+	start_FT_Layout( &layout, string, font, size );
+
+	while (*layout.next != '\0') {
+		next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+		error = get_FT_Glyph( glyph, glyph_font, size, &layout.pen, &bitmap, &left, &top, &advance );
 		if ( error )  return;                 /* ignore errors */
 
-		draw_bitmap_Indexed( &g_slot->bitmap, g_slot->bitmap_left, g_slot->bitmap_top, image, x, y, index );
-		pen.x += g_slot->advance.x;
-		pen.y += g_slot->advance.y;
+		draw_bitmap_RGB( &bitmap, left, top, image, x, y, rgb );
+		layout.pen.x += advance.x;
+		layout.pen.y += advance.y;
 	}
 }
 
 void draw_FT_StringRGB( int x, int y, char *string, uint8_t font, uint16_t size, const RGBA8_T *rgb, IMAGE_T *image) {
-	FT_GlyphSlot	g_slot;
-	FT_Vector	pen;
+	drop_last_space_in_string( string );
+
+	draw_FT_TextRGB( x, y, string, font, size, rgb, image );
+}
+
+// The string is rendered once into a coverage mask, combining overlapping glyphs as blending them one after the
+// other would, and the mask is blended from then on.
+void draw_FT_CachedStringRGB( IMAGE_TEXT_CACHE_T *cache, int x, int y, const char *string, uint8_t font, uint16_t size,
+                              const RGBA8_T *rgb, IMAGE_T *image ) {
+	IMAGE_TEXT_T	*text = findImageText( cache, string, font, size );
+	FT_LAYOUT_T	layout;
+	FT_Bitmap	bitmap;
+	FT_Vector	advance;
 	FT_Error	error;
-	int		n, nc;
+	FT_UInt		glyph;
+	uint8_t		glyph_font, *dst, *src;
+	uint32_t	c;
+	int		left, top, x0, y0, x1, y1, i, j;
+
+	if (text == NULL) {
+		// the glyph boxes relative to x and y give the size of the mask
+		x0 = y0 = INT_MAX;
+		x1 = y1 = INT_MIN;
+
+		start_FT_Layout( &layout, string, font, size );
+		while (*layout.next != '\0') {
+			next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+			error = get_FT_Glyph( glyph, glyph_font, size, &layout.pen, &bitmap, &left, &top, &advance );
+			if ( error )  break;
+
+			if (bitmap.width > 0 && bitmap.rows > 0) {
+				if (left < x0) x0 = left;
+				if (-top < y0) y0 = -top;
+				if (left + (int)bitmap.width > x1) x1 = left + bitmap.width;
+				if (-top + (int)bitmap.rows > y1) y1 = -top + bitmap.rows;
+			}
+			layout.pen.x += advance.x;
+			layout.pen.y += advance.y;
+		}
+		if (x1 <= x0) return;		/* nothing to draw */
 
-	drop_last_space_in_string( string );
+		text = addImageText( cache, string, font, size, x0, y0, x1 - x0, y1 - y0 );
+		if (text == NULL) {
+			draw_FT_TextRGB( x, y, string, font, size, rgb, image );
+			return;
+		}
 
-	assert(font < fonts);
-	g_slot = font_face[font]->glyph;
+		start_FT_Layout( &layout, string, font, size );
+		while (*layout.next != '\0') {
+			next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+			error = get_FT_Glyph( glyph, glyph_font, size, &layout.pen, &bitmap, &left, &top, &advance );
+			if ( error )  break;
+
+			for (j = 0; j < (int)bitmap.rows; j++) {
+				dst = (uint8_t *)text->mask.buffer + (-top + j - y0) * text->mask.pitch + (left - x0);
+				src = bitmap.buffer + j * bitmap.pitch;
+				for (i = 0; i < (int)bitmap.width; i++) dst[i] = dst[i] + src[i] - (dst[i] * src[i]) / 255;
+			}
+			layout.pen.x += advance.x;
+			layout.pen.y += advance.y;
+		}
+	}
 
-	nc = strlen( string );
-	if (nc == 0) return;
+	drawImageTextRGB( text, x, y, rgb, image );
+}
 
-	error = FT_Set_Char_Size( font_face[font], size * 18, size * 27, 256, 256 );
-	assert(error == 0);
+void record_FT_StringRGB( IMAGE_COMMANDS_T *commands, int x, int y, char *string, uint8_t font, uint16_t size, const RGBA8_T *rgb ) {
+	FT_LAYOUT_T	layout;
+	FT_Bitmap	bitmap;
+	FT_Vector	advance;
+	FT_Error	error;
+	FT_UInt		glyph;
+	uint8_t		glyph_font;
+	uint32_t	c;
+	int		left, top;
 
-	pen.x = 20; pen.y = 20;
+	drop_last_space_in_string( string );
+
+	start_FT_Layout( &layout, string, font, size );
 
-	for (n = 0; n < nc; n++ ) {
-		FT_Set_Transform( font_face[font], 0, &pen );
-		error = FT_Load_Char( font_face[font], string[n], FT_LOAD_RENDER );
+	// the glyphs are rendered now, on this thread, and only their coverage is blended when the commands run.
+	while (*layout.next != '\0') {
+		next_FT_Layout( &layout, &c, &glyph_font, &glyph );
+		error = get_FT_Glyph( glyph, glyph_font, size, &layout.pen, &bitmap, &left, &top, &advance );
 		if ( error )  return;                 /* ignore errors */
 
-		draw_bitmap_RGB( &g_slot->bitmap, g_slot->bitmap_left, g_slot->bitmap_top, image, x, y, rgb );
-		pen.x += g_slot->advance.x;
-		pen.y += g_slot->advance.y;
+		recordImageMaskRGB( commands, x + left, y - top, bitmap.width, bitmap.rows, bitmap.pitch,
+		                    bitmap.buffer, rgb );
+		layout.pen.x += advance.x;
+		layout.pen.y += advance.y;
 	}
 }
@@ -32,25 +32,49 @@
 //-------------------------------------------------------------------------
 
 #include "image.h"
+#include "imageCommands.h"
+#include "imageText.h"
 
 //-------------------------------------------------------------------------
 
 #define FONT_WIDTH 8
 #define FONT_HEIGHT 16
 
+typedef struct
+{
+    int width;	// from x to the right edge of the last glyph, without trailing spaces
+    int advance;	// how far the pen moves
+    int ascent;	// above the baseline
+    int descent;	// below the baseline
+    int height;	// baseline to baseline
+} FT_TEXT_METRICS_T;
+
 //-------------------------------------------------------------------------
 
 void init_Freetype_Render( void );
 
 uint8_t load_Freetype_Font( const char *font_name );
 
-int measure_FT_Char( uint8_t c, uint8_t font, uint16_t size );
+// Rendered glyphs are cached between draws. This empties the cache.
+
+void flush_FT_Glyph_Cache( void );
+
+// Strings are UTF-8 and characters are Unicode codepoints. A character
+// the font does not have is drawn from its fallback font, if it has one.
+
+void set_FT_Fallback_Font( uint8_t font, uint8_t fallback );
+
+// Measuring uses glyph metrics cached for each font and size, nothing is rendered.
+
+void measure_FT_Text( const char *string, uint8_t font, uint16_t size, FT_TEXT_METRICS_T *metrics );
+
+int measure_FT_Char( uint32_t c, uint8_t font, uint16_t size );
 
 void
 draw_FT_CharIndexed(
     int x,
     int y,
-    uint8_t c,
+    uint32_t c,
     uint8_t font,
     uint16_t size,
     int8_t index,
@@ -60,7 +84,7 @@ void
 draw_FT_CharRGB(
     int x,
     int y,
-    uint8_t c,
+    uint32_t c,
     uint8_t font,
     uint16_t size,
     const RGBA8_T *rgb,
@@ -88,6 +112,31 @@ draw_FT_StringRGB(
     const RGBA8_T *rgb,
     IMAGE_T *image);
 
+// Draw a string through a text cache, see imageText.h.
+
+void
+draw_FT_CachedStringRGB(
+    IMAGE_TEXT_CACHE_T *cache,
+    int x,
+    int y,
+    const char *string,
+    uint8_t font,
+    uint16_t size,
+    const RGBA8_T *rgb,
+    IMAGE_T *image);
+
+// Render the glyphs now and record them for executeImageCommands().
+
+void
+record_FT_StringRGB(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    char *string,
+    uint8_t font,
+    uint16_t size,
+    const RGBA8_T *rgb);
+
 //-------------------------------------------------------------------------
 
 #endif
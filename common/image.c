@@ -29,8 +29,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "image.h"
+#include "imageBuffer.h"
+#include "imageConvert.h"
+#include "imageDither.h"
+#include "imageJobs.h"
+#include "imageSpan.h"
 
 #ifdef DMALLOC
 #include "dmalloc.h"
@@ -57,9 +63,12 @@ void setPixelRGBA16(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGB
 void setPixelDitheredRGBA16(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
 void setPixelRGBA32(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
 
-void setPixelAlphaRGBA16(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
-void setPixelAlphaRGB888(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
-void setPixelAlphaRGBA32(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
+void setPixelAlphaSpan(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba);
+
+void blendSpanAlpha(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba, const uint8_t *coverage);
+void blendSpanRGBA16(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba, const uint8_t *coverage);
+void blendSpanRGB888(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba, const uint8_t *coverage);
+void blendSpanRGBA32(IMAGE_T *image, int32_t x, int32_t y, int32_t num, const RGBA8_T *rgba, const uint8_t *coverage);
 
 void getPixel4BPP(IMAGE_T *image, int32_t x, int32_t y, int8_t *index);
 void getPixel8BPP(IMAGE_T *image, int32_t x, int32_t y, int8_t *index);
@@ -70,15 +79,12 @@ void getPixelRGBA32(IMAGE_T *image, int32_t x, int32_t y, RGBA8_T *rgba);
 
 //-------------------------------------------------------------------------
 
-bool initImage(
+static bool
+setImageType(
     IMAGE_T *image,
     VC_IMAGE_TYPE_T type,
-    int32_t width,
-    int32_t height,
     bool dither)
 {
-    assert(image != NULL);
-
     switch (type)
     {
     case VC_IMAGE_4BPP:
@@ -89,6 +95,7 @@ bool initImage(
         image->getPixelDirect = NULL;
         image->setPixelIndexed = setPixel4BPP;
         image->getPixelIndexed = getPixel4BPP;
+        image->blendSpan = NULL;
 
         break;
 
@@ -100,6 +107,7 @@ bool initImage(
         image->getPixelDirect = NULL;
         image->setPixelIndexed = setPixel8BPP;
         image->getPixelIndexed = getPixel8BPP;
+        image->blendSpan = NULL;
 
         break;
 
@@ -120,17 +128,19 @@ bool initImage(
         image->getPixelDirect = getPixelRGB565;
         image->setPixelIndexed = NULL;
         image->getPixelIndexed = NULL;
+        image->blendSpan = blendSpanAlpha;
 
         break;
 
     case VC_IMAGE_RGB888:
 
         image->bitsPerPixel = 24;
-        image->setPixelAlpha = setPixelAlphaRGB888;
+        image->setPixelAlpha = setPixelAlphaSpan;
         image->setPixelDirect = setPixelRGB888;
         image->getPixelDirect = getPixelRGB888;
         image->setPixelIndexed = NULL;
         image->getPixelIndexed = NULL;
+        image->blendSpan = blendSpanRGB888;
 
         break;
 
@@ -141,11 +151,13 @@ bool initImage(
         {
             image->setPixelAlpha = setPixelDitheredRGBA16;
             image->setPixelDirect = setPixelDitheredRGBA16;
+            image->blendSpan = blendSpanAlpha;
         }
         else
         {
-            image->setPixelAlpha = setPixelAlphaRGBA16;
+            image->setPixelAlpha = setPixelAlphaSpan;
             image->setPixelDirect = setPixelRGBA16;
+            image->blendSpan = blendSpanRGBA16;
         }
         image->getPixelDirect = getPixelRGBA16;
         image->setPixelIndexed = NULL;
@@ -156,11 +168,12 @@ bool initImage(
     case VC_IMAGE_RGBA32:
 
         image->bitsPerPixel = 32;
-        image->setPixelAlpha = setPixelAlphaRGBA32;
+        image->setPixelAlpha = setPixelAlphaSpan;
         image->setPixelDirect = setPixelRGBA32;
         image->getPixelDirect = getPixelRGBA32;
         image->setPixelIndexed = NULL;
         image->getPixelIndexed = NULL;
+        image->blendSpan = blendSpanRGBA32;
 
         break;
 
@@ -173,6 +186,26 @@ bool initImage(
     }
 
     image->type = type;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool initImage(
+    IMAGE_T *image,
+    VC_IMAGE_TYPE_T type,
+    int32_t width,
+    int32_t height,
+    bool dither)
+{
+    assert(image != NULL);
+
+    if (setImageType(image, type, dither) == false)
+    {
+        return false;
+    }
+
     image->width = width;
     image->height = height;
     image->stride = width * image->bitsPerPixel / 8;
@@ -180,7 +213,7 @@ bool initImage(
     image->alignedHeight = ALIGN_TO_16(height);
     image->size = image->pitch * image->alignedHeight;
 
-    image->buffer = calloc(2, image->size);
+    image->buffer = allocImageBuffer(image->type, image->size);
 
     if (image->buffer == NULL)
     {
@@ -188,11 +221,264 @@ bool initImage(
         exit(EXIT_FAILURE);
     }
 
+    image->parent = NULL;
+    image->xOrigin = 0;
+    image->yOrigin = 0;
+    image->ownsBuffer = true;
+    image->mapping = NULL;
+    image->mappingSize = 0;
+
+    resetImageClip(image);
+    clearImageDirty(image);
+    markImageDirty(image, 0, 0, image->width, image->height);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initImageBuffer(
+    IMAGE_T *image,
+    VC_IMAGE_TYPE_T type,
+    int32_t width,
+    int32_t height,
+    int32_t pitch,
+    int32_t alignedHeight,
+    void *buffer,
+    bool dither)
+{
+    assert(image != NULL);
+    assert(buffer != NULL);
+
+    if (setImageType(image, type, dither) == false)
+    {
+        return false;
+    }
+
+    int64_t stride = (int64_t)width * image->bitsPerPixel / 8;
+    int64_t size = (int64_t)pitch * alignedHeight;
+
+    if ((width <= 0) || (height <= 0) ||
+        (stride > INT32_MAX) || (size > INT32_MAX) ||
+        (pitch < stride) || (alignedHeight < height))
+    {
+        fprintf(stderr, "image: buffer is too small for the image\n");
+        return false;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->stride = stride;
+    image->pitch = pitch;
+    image->alignedHeight = alignedHeight;
+    image->size = size;
+
+    image->buffer = buffer;
+    image->parent = NULL;
+    image->xOrigin = 0;
+    image->yOrigin = 0;
+    image->ownsBuffer = false;
+    image->mapping = NULL;
+    image->mappingSize = 0;
+
+    resetImageClip(image);
+    clearImageDirty(image);
+    markImageDirty(image, 0, 0, image->width, image->height);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initImageView(
+    IMAGE_T *view,
+    IMAGE_T *parent,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    assert(view != NULL);
+    assert(parent != NULL);
+
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > parent->width) width = parent->width - x;
+    if (y + height > parent->height) height = parent->height - y;
+
+    if ((width <= 0) || (height <= 0))
+    {
+        fprintf(stderr, "image: view is outside the parent image\n");
+        return false;
+    }
+
+    if ((x * parent->bitsPerPixel) % 8)
+    {
+        fprintf(stderr, "image: view must start on a byte boundary\n");
+        return false;
+    }
+
+    *view = *parent;
+
+    view->width = width;
+    view->height = height;
+    view->stride = width * view->bitsPerPixel / 8;
+    view->alignedHeight = height;
+    view->size = view->pitch * height;
+    view->buffer = (uint8_t *)(parent->buffer)
+                 + (y * parent->pitch)
+                 + (x * parent->bitsPerPixel / 8);
+
+    view->parent = parent;
+    view->xOrigin = parent->xOrigin + x;
+    view->yOrigin = parent->yOrigin + y;
+    view->ownsBuffer = false;
+    view->mapping = NULL;
+    view->mappingSize = 0;
+
+    view->clip.x = x;
+    view->clip.y = y;
+    view->clip.width = width;
+    view->clip.height = height;
+    if (clipImageRect(parent, &view->clip) == false)
+    {
+        view->clip.width = 0;
+        view->clip.height = 0;
+    }
+    view->clip.x -= x;
+    view->clip.y -= y;
+    view->clipDepth = 0;
+
+    clearImageDirty(view);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+clipImageRect(
+    const IMAGE_T *image,
+    VC_RECT_T *rect)
+{
+    const VC_RECT_T *clip = &(image->clip);
+    int32_t x1 = (rect->x > clip->x) ? rect->x : clip->x;
+    int32_t y1 = (rect->y > clip->y) ? rect->y : clip->y;
+    int32_t x2 = rect->x + rect->width;
+    int32_t y2 = rect->y + rect->height;
+
+    if (x2 > clip->x + clip->width) x2 = clip->x + clip->width;
+    if (y2 > clip->y + clip->height) y2 = clip->y + clip->height;
+
+    if ((x2 <= x1) || (y2 <= y1))
+    {
+        return false;
+    }
+
+    rect->x = x1;
+    rect->y = y1;
+    rect->width = x2 - x1;
+    rect->height = y2 - y1;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+pushImageClip(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    if (image->clipDepth >= IMAGE_CLIP_DEPTH)
+    {
+        return false;
+    }
+
+    image->clipStack[image->clipDepth++] = image->clip;
+
+    VC_RECT_T rect = { .x = x, .y = y, .width = width, .height = height };
+
+    if (clipImageRect(image, &rect) == false)
+    {
+        rect.x = image->clip.x;
+        rect.y = image->clip.y;
+        rect.width = 0;
+        rect.height = 0;
+    }
+
+    image->clip = rect;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+popImageClip(
+    IMAGE_T *image)
+{
+    if (image->clipDepth <= 0)
+    {
+        return false;
+    }
+
+    image->clip = image->clipStack[--image->clipDepth];
+
     return true;
 }
 
 //-------------------------------------------------------------------------
 
+void
+resetImageClip(
+    IMAGE_T *image)
+{
+    image->clip.x = 0;
+    image->clip.y = 0;
+    image->clip.width = image->width;
+    image->clip.height = image->height;
+    image->clipDepth = 0;
+}
+
+//-------------------------------------------------------------------------
+
+// Clears are split into bands of rows that are filled by the job pool.
+
+typedef struct
+{
+    IMAGE_T *image;
+    const RGBA8_T *rgb;
+    int8_t index;
+} CLEAR_JOB_T;
+
+static void
+clearRows(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    CLEAR_JOB_T *job = context;
+    IMAGE_T *image = job->image;
+    int32_t num = (last - first) * image->width;
+
+    if (job->rgb != NULL)
+    {
+	image->setPixelDirect(image, 0, first, num, job->rgb);
+    }
+    else
+    {
+	image->setPixelIndexed(image, 0, first, num, job->index);
+    }
+}
+
+//-------------------------------------------------------------------------
+
 void
 clearImageIndexed(
     IMAGE_T *image,
@@ -200,7 +486,9 @@ clearImageIndexed(
 {
     if (image->setPixelIndexed != NULL)
     {
-	image->setPixelIndexed(image, 0, 0, image->height * ALIGN_TO_32(image->width), index);
+	CLEAR_JOB_T job = { .image = image, .index = index };
+	runImageJobRows(clearRows, &job, image->height, image->pitch * image->height);
+	markImageDirty(image, 0, 0, image->width, image->height);
     }
 }
 
@@ -213,12 +501,80 @@ clearImageRGB(
 {
     if (image->setPixelDirect != NULL)
     {
-	image->setPixelDirect(image, 0, 0, image->height * ALIGN_TO_32(image->width), rgb);
+	CLEAR_JOB_T job = { .image = image, .rgb = rgb };
+	runImageJobRows(clearRows, &job, image->height, image->pitch * image->height);
+	markImageDirty(image, 0, 0, image->width, image->height);
     }
 }
 
 //-------------------------------------------------------------------------
 
+static void
+markSpanDirty(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t num)
+{
+    if (num < 1) num = 1;
+
+    if (x + num <= image->width)
+    {
+        markImageDirty(image, x, y, num, 1);
+    }
+    else
+    {
+        int32_t rows = (x + num + image->width - 1) / image->width;
+        markImageDirty(image, 0, y, image->width, rows);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// Clip a span to the clip rectangle, returning the number of pixels that
+// may be drawn from the new x, or 0 if none. Without a clip a span may run
+// on into the following rows, as it always has; with one it stops at the
+// edge.
+
+static int32_t
+clipSpan(
+    const IMAGE_T *image,
+    int32_t *x,
+    int32_t y,
+    int32_t num)
+{
+    const VC_RECT_T *clip = &(image->clip);
+
+    if (num < 1) num = 1;
+
+    if (*x < clip->x)
+    {
+        num -= clip->x - *x;
+        *x = clip->x;
+    }
+
+    if ((num < 1) || (*x >= clip->x + clip->width) ||
+        (y < clip->y) || (y >= clip->y + clip->height))
+    {
+        return 0;
+    }
+
+    if ((clip->width == image->width) && (clip->height == image->height))
+    {
+        int32_t origin = (y * image->width) + *x;
+        int32_t max = image->width * image->height;
+        if (origin + num > max) num = max - origin;
+    }
+    else if (*x + num > clip->x + clip->width)
+    {
+        num = clip->x + clip->width - *x;
+    }
+
+    return num;
+}
+
+//-------------------------------------------------------------------------
+
 bool
 setPixelIndexed(
     IMAGE_T *image,
@@ -228,16 +584,13 @@ setPixelIndexed(
     int8_t index)
 {
     bool result = false;
-    int32_t origin = (y * image->width) + x;
-    int32_t max = image->width * image->height;
-    if (origin + num > max) num = max - origin;
+    num = clipSpan(image, &x, y, num);
 
-    if ((image->setPixelIndexed != NULL) &&
-        (x >= 0) && (x < image->width) &&
-        (y >= 0) && (y < image->height))
+    if ((image->setPixelIndexed != NULL) && (num > 0))
     {
         result = true;
         image->setPixelIndexed(image, x, y, num, index);
+        markSpanDirty(image, x, y, num);
     }
 
     return result;
@@ -254,16 +607,13 @@ setPixelRGB(
     const RGBA8_T *rgb)
 {
     bool result = false;
-    int32_t origin = (y * image->width) + x;
-    int32_t max = image->width * image->height;
-    if (origin + num > max) num = max - origin;
+    num = clipSpan(image, &x, y, num);
 
-    if ((image->setPixelDirect != NULL) &&
-        (x >= 0) && (x < image->width) &&
-        (y >= 0) && (y < image->height))
+    if ((image->setPixelDirect != NULL) && (num > 0))
     {
         result = true;
         image->setPixelDirect(image, x, y, num, rgb);
+        markSpanDirty(image, x, y, num);
     }
 
     return result;
@@ -280,16 +630,48 @@ setPixelRGBA(		// mix src and dest using alpha.
     const RGBA8_T *rgb)
 {
     bool result = false;
-    int32_t origin = (y * image->width) + x;
-    int32_t max = image->width * image->height;
-    if (origin + num > max) num = max - origin;
+    num = clipSpan(image, &x, y, num);
 
-    if ((image->setPixelDirect != NULL) &&
-        (x >= 0) && (x < image->width) &&
-        (y >= 0) && (y < image->height))
+    if ((image->setPixelDirect != NULL) && (num > 0))
     {
         result = true;
         image->setPixelAlpha(image, x, y, num, rgb);
+        markSpanDirty(image, x, y, num);
+    }
+
+    return result;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+blendSpanRGBA(		// mix src into a single row, alpha scaled by coverage.
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t num,
+    const RGBA8_T *rgb,
+    const uint8_t *coverage)
+{
+    bool result = false;
+
+    const VC_RECT_T *clip = &(image->clip);
+
+    if (x < clip->x)
+    {
+        if (coverage != NULL) coverage += clip->x - x;
+        num -= clip->x - x;
+        x = clip->x;
+    }
+    if (x + num > clip->x + clip->width) num = clip->x + clip->width - x;
+
+    if ((image->blendSpan != NULL) &&
+        (num > 0) &&
+        (y >= clip->y) && (y < clip->y + clip->height))
+    {
+        result = true;
+        image->blendSpan(image, x, y, num, rgb, coverage);
+        markImageDirty(image, x, y, num, 1);
     }
 
     return result;
@@ -341,15 +723,43 @@ getPixelRGB(
 
 //-------------------------------------------------------------------------
 
-void
-destroyImage(
+bool
+isImageDithered(
+    const IMAGE_T *image)
+{
+    return (image->setPixelDirect == setPixelDitheredRGB565) ||
+           (image->setPixelDirect == setPixelDitheredRGBA16);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+releaseImageBuffer(
     IMAGE_T *image)
 {
-    if (image->buffer)
+    if (image->buffer && image->ownsBuffer)
+    {
+        freeImageBuffer(image->buffer);
+    }
+
+    if (image->mapping)
     {
-        free(image->buffer);
+        munmap(image->mapping, image->mappingSize);
     }
 
+    image->ownsBuffer = false;
+    image->mapping = NULL;
+    image->mappingSize = 0;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyImage(
+    IMAGE_T *image)
+{
+    releaseImageBuffer(image);
+
     image->type = VC_IMAGE_MIN;
     image->width = 0;
     image->height = 0;
@@ -358,28 +768,189 @@ destroyImage(
     image->bitsPerPixel = 0;
     image->size = 0;
     image->buffer = NULL;
+    image->setPixelAlpha = NULL;
     image->setPixelDirect = NULL;
     image->getPixelDirect = NULL;
     image->setPixelIndexed = NULL;
     image->getPixelIndexed = NULL;
+    image->blendSpan = NULL;
+    image->parent = NULL;
+    image->xOrigin = 0;
+    image->yOrigin = 0;
+    resetImageClip(image);
+    clearImageDirty(image);
+}
+
+//-------------------------------------------------------------------------
+//
+// The dirty list holds up to IMAGE_DIRTY_RECTS rectangles. A new area is
+// merged with every rectangle it overlaps or touches. When the list is
+// full it is merged with the rectangle that grows the least.
+//
+//-------------------------------------------------------------------------
+
+static int64_t
+rectArea(
+    const VC_RECT_T *rect)
+{
+    return (int64_t)(rect->width) * rect->height;
+}
+
+static void
+rectUnion(
+    VC_RECT_T *a,
+    const VC_RECT_T *b)
+{
+    int32_t x1 = (a->x < b->x) ? a->x : b->x;
+    int32_t y1 = (a->y < b->y) ? a->y : b->y;
+    int32_t x2 = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int32_t y2 = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+
+    a->x = x1;
+    a->y = y1;
+    a->width = x2 - x1;
+    a->height = y2 - y1;
+}
+
+static bool
+rectTouches(
+    const VC_RECT_T *a,
+    const VC_RECT_T *b)
+{
+    return (a->x <= b->x + b->width) && (b->x <= a->x + a->width) &&
+           (a->y <= b->y + b->height) && (b->y <= a->y + a->height);
+}
+
+//-------------------------------------------------------------------------
+
+void
+markImageDirty(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > image->width) width = image->width - x;
+    if (y + height > image->height) height = image->height - y;
+
+    if ((width <= 0) || (height <= 0))
+    {
+        return;
+    }
+
+    // A view's pixels are also the parent's, so the parent is marked
+    // whether or not the view already has this area in its own list.
+
+    if (image->parent != NULL)
+    {
+        markImageDirty(image->parent,
+                       x + image->xOrigin - image->parent->xOrigin,
+                       y + image->yOrigin - image->parent->yOrigin,
+                       width,
+                       height);
+    }
+
+    addImageDirtyRect(&(image->dirty), x, y, width, height);
 }
 
 //-------------------------------------------------------------------------
 
-void memfill(void *dest, size_t destsize, size_t elemsize) {
-        void     *nextdest = (void *) dest + elemsize;
-        size_t   movesize, donesize = elemsize;
-
-        //destsize -= elemsize;
-        while (destsize) {
-                movesize = (donesize < destsize) ? donesize : destsize;
-                memcpy(nextdest, dest, movesize);
-                nextdest += movesize;
-                destsize -= movesize;
-                donesize += movesize;
+void
+addImageDirtyRect(
+    IMAGE_DIRTY_T *dirty,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    int32_t i;
+    for (i = 0 ; i < dirty->count ; i++)
+    {
+        VC_RECT_T *r = &(dirty->rects[i]);
+
+        if ((x >= r->x) && (x + width <= r->x + r->width) &&
+            (y >= r->y) && (y + height <= r->y + r->height))
+        {
+            return;
         }
+    }
+
+    VC_RECT_T rect = { x, y, width, height };
+
+    i = 0;
+    while (i < dirty->count)
+    {
+        if (rectTouches(&rect, &(dirty->rects[i])))
+        {
+            rectUnion(&rect, &(dirty->rects[i]));
+            dirty->rects[i] = dirty->rects[--(dirty->count)];
+            i = 0;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    while (dirty->count == IMAGE_DIRTY_RECTS)
+    {
+        int32_t best = 0;
+        int64_t bestGrowth = INT64_MAX;
+
+        for (i = 0 ; i < dirty->count ; i++)
+        {
+            VC_RECT_T merged = dirty->rects[i];
+            rectUnion(&merged, &rect);
+
+            int64_t growth = rectArea(&merged) - rectArea(&(dirty->rects[i]));
+
+            if (growth < bestGrowth)
+            {
+                best = i;
+                bestGrowth = growth;
+            }
+        }
+
+        rectUnion(&rect, &(dirty->rects[best]));
+        dirty->rects[best] = dirty->rects[--(dirty->count)];
+
+        i = 0;
+        while (i < dirty->count)
+        {
+            if (rectTouches(&rect, &(dirty->rects[i])))
+            {
+                rectUnion(&rect, &(dirty->rects[i]));
+                dirty->rects[i] = dirty->rects[--(dirty->count)];
+                i = 0;
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    dirty->rects[dirty->count++] = rect;
+}
+
+//-------------------------------------------------------------------------
+
+void
+clearImageDirty(
+    IMAGE_T *image)
+{
+    image->dirty.count = 0;
 }
 
+//-----------------------------------------------------------------------
+//
+// The setPixel functions write num pixels starting at (x, y), carrying on
+// at the start of the next row when the end of a row is reached. Each row
+// is filled separately, so the padding at the end of a row is left alone.
+//
 //-----------------------------------------------------------------------
 
 void
@@ -392,64 +963,37 @@ setPixel4BPP(
 {
     index &= 0x0F;
 
-    uint8_t *value = (uint8_t*)(image->buffer + (x/2) + (y * image->pitch));
+    if (num < 1) num = 1;
 
-    if (num == 0 || num == 1) {
-	if (x % 2) {
-	    *value = (*value & 0xF0) | (index);		// odd
-	} else {
-	    *value = (*value & 0x0F) | (index << 4);	// even
-	}
-    } else if (num == 2) {
-	if (x % 2) {  // start odd
-	    *value = (*value & 0xF0) | (index);
-	    value++;
-	    *value = (*value & 0x0F) | (index << 4);
-	} else {				// start even 1 byte
-	    *value = (index) | (index << 4);
-	}
-    } else if (num == 3) {
-	if (x % 2) {	// start odd
-	    *value = (*value & 0xF0) | (index);	// odd
-	    value++;
-	    *value = (index) | (index << 4);	// even odd
-	} else {
-	    *value = (index) | (index << 4);	// even odd
-	    value++;
-	    *value = (*value & 0x0F) | (index << 4); // even
-	}
-    } else if (num == 4) {
-	if (x % 2) {	// start odd
-	    *value = (*value & 0xF0) | (index);	// odd
-	    value++;
-	    *value = (index) | (index << 4);	// even odd
-	    value++;
-	    *value = (*value & 0x0F) | (index << 4); // even
-	} else {
-	    *value = (index) | (index << 4);	// even odd
-	    value++;
-	    *value = (index) | (index << 4);	// even odd
-	}
-    } else if (num >= 5) {
-	int byt = num / 2;
-	int odd = num % 2;
-	if (x % 2) {	// start odd
-	    *value = (*value & 0xF0) | (index);	// odd
-	    value++;
-	    *value = (index) | (index << 4);	// even odd
-	    memfill( value, sizeof(uint8_t) * byt, sizeof(uint8_t) );	// even odd even odd
-	    if (odd == 0) {
-		value += byt;
-		*value = (*value & 0x0F) | (index << 4); // even
-	    }
-	} else {
-	    *value = (index) | (index << 4);	// even odd
-	    memfill( value, sizeof(uint8_t) * byt, sizeof(uint8_t) );	// even odd even odd
-	    if (odd == 1) {
-		value += byt;
-		*value = (*value & 0xF0) | (index); // odd
-	    }
-	}
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            num -= count;
+
+            uint8_t *value = (uint8_t*)(image->buffer + (x/2) + (y * image->pitch));
+
+            if (x % 2)
+            {
+                *value = (*value & 0xF0) | (index);	// odd
+                value++;
+                count--;
+            }
+
+            spanFill8(value, (index) | (index << 4), count / 2);	// even odd
+
+            if (count % 2)
+            {
+                value += count / 2;
+                *value = (*value & 0x0F) | (index << 4); // even
+            }
+        }
+
+        x = 0;
+        y++;
     }
 }
 
@@ -463,10 +1007,23 @@ setPixel8BPP(
     int32_t num,
     int8_t index)
 {
-    uint8_t *value;  value = (uint8_t*) (image->buffer + x + (y * image->pitch));
-    *value = index;
-    if (num >= 2)
-	memfill( value, sizeof(uint8_t) * num, sizeof(uint8_t) );
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint8_t *value = (uint8_t*)(image->buffer + x + (y * image->pitch));
+            spanFill8(value, index, count);
+            num -= count;
+        }
+
+        x = 0;
+        y++;
+    }
 }
 
 //-----------------------------------------------------------------------
@@ -484,13 +1041,23 @@ setPixelRGB565(
     uint8_t b5 = rgba->blue >> 3;
 
     uint16_t pixel = (r5 << 11) | (g6 << 5) | b5;
-    uint16_t *value;  value = (uint16_t*) (image->buffer + (x * 2) + (y *image->pitch));
 
-    *value = pixel;
-    if (num >= 2) {
-	int yy = (num - x) / image->width;
-	int extra = (image->pitch - image->stride) * yy;
-	memfill( value, (sizeof(uint16_t) * num) + extra, sizeof(uint16_t) );
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint16_t *value = (uint16_t*)(image->buffer + (x * 2) + (y * image->pitch));
+            spanFill16(value, pixel, count);
+            num -= count;
+        }
+
+        x = 0;
+        y++;
     }
 }
 
@@ -504,55 +1071,31 @@ setPixelDitheredRGB565(
     int32_t num,
     const RGBA8_T *rgba)
 {
-    static int16_t dither8[64] =
-    {
-        1, 6, 2, 7, 1, 6, 2, 7,
-        4, 2, 5, 4, 4, 3, 6, 4,
-        1, 7, 1, 6, 2, 7, 1, 7,
-        5, 3, 5, 3, 5, 4, 5, 3,
-        1, 6, 2, 7, 1, 6, 2, 7,
-        4, 3, 6, 4, 4, 2, 6, 4,
-        2, 7, 1, 7, 2, 7, 1, 6,
-        5, 3, 5, 3, 5, 3, 5, 3,
-    };
+    if (num < 1) num = 1;
 
-    static int16_t dither4[64] =
+    while ((num > 0) && (y < image->height))
     {
-        1, 3, 1, 3, 1, 3, 1, 3,
-        2, 1, 3, 2, 2, 1, 3, 2,
-        1, 3, 1, 3, 1, 3, 1, 3,
-        2, 2, 2, 1, 3, 2, 2, 2,
-        1, 3, 1, 3, 1, 3, 1, 3,
-        2, 1, 3, 2, 2, 1, 3, 2,
-        1, 3, 1, 3, 1, 3, 1, 3,
-        3, 2, 2, 2, 2, 2, 2, 2,
-    };
-
-    int32_t i;
-    for (i=0; i < num; i++) {
-	int32_t index = (x & 7) | ((y & 7) << 3);
-
-	int16_t r = rgba->red + dither8[index];
-	if (r > 255) r = 255;
-
-	int16_t g = rgba->green + dither4[index];
-	if (g > 255) g = 255;
-
-	int16_t b = rgba->blue + dither8[index];
-	if (b > 255) b = 255;
+        int32_t count = image->width - x;
+        if (count > num) count = num;
 
-	RGBA8_T dithered = { r, g, b, rgba->alpha };
-
-	setPixelRGB565(image, x, y, 1, &dithered);
+        if (count > 0)
+        {
+            uint16_t pattern[8];
+            ditherPattern16(VC_IMAGE_RGB565, rgba,
+                            x + image->xOrigin, y + image->yOrigin,
+                            pattern, count);
+
+            uint16_t *value = (uint16_t*)(image->buffer + (x * 2) + (y * image->pitch));
+            spanFillPattern16(value, pattern, count);
+            num -= count;
+        }
 
-	x++;
-	if (x > image->width) {
-	    x = 0; y++;
-	    if (y > image->height) return;
-	}
+        x = 0;
+        y++;
     }
 }
 
+
 //-------------------------------------------------------------------------
 
 void
@@ -563,214 +1106,233 @@ setPixelRGB888(
     int32_t num,
     const RGBA8_T *rgba)
 {
-    uint8_t *line;  line = (uint8_t *) (image->buffer) + (y * image->pitch) + (3 * x);
-    line[0] = rgba->red;
-    line[1] = rgba->green;
-    line[2] = rgba->blue;
-    if (num >= 2) {
-	int yy = (num - x) / image->width;
-	int extra = (image->pitch - image->stride) * yy;
-	memfill( line, (sizeof(uint8_t) * 3 * num) + extra, sizeof(uint8_t) * 3 );
+    uint8_t pixel[3] = { rgba->red, rgba->green, rgba->blue };
+
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint8_t *line = (uint8_t *)(image->buffer) + (y * image->pitch) + (3 * x);
+            spanFill24(line, pixel, count);
+            num -= count;
+        }
+
+        x = 0;
+        y++;
     }
 }
 
 //-------------------------------------------------------------------------
 
 void
-setPixelAlphaRGB888(
+setPixelRGBA16(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
     const RGBA8_T *rgba)
 {
-    uint8_t *line;  line = (uint8_t *) (image->buffer) + (y * image->pitch) + (3 * x);
-    int ad = 255 - rgba->alpha;
-    int as = rgba->alpha;
-    int tmp;
-
-    tmp = ((line[0] * ad)/255) + ((rgba->red * as)/255);
-    line[0] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((line[1] * ad)/255) + ((rgba->green * as)/255);
-    line[1] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((line[2] * ad)/255) + ((rgba->blue * as)/255);
-    line[2] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-
-    if (num >= 2) {
-	if (x < image->width) {
-		setPixelAlphaRGB888( image, x + 1, y, num - 1, rgba );
-	} else {
-		setPixelAlphaRGB888( image, 0, y + 1, num - 1, rgba );
-	}
+    uint8_t r4 = rgba->red  >> 4;
+    uint8_t g4 = rgba->green >> 4;
+    uint8_t b4 = rgba->blue >> 4;
+    uint8_t a4 = rgba->alpha >> 4;
+
+    uint16_t pixel = (r4 << 12) | (g4 << 8) | (b4 << 4) | a4;
+
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint16_t *value = (uint16_t*)(image->buffer + (x * 2) + (y * image->pitch));
+            spanFill16(value, pixel, count);
+            num -= count;
+        }
+
+        x = 0;
+        y++;
     }
 }
 
 //-----------------------------------------------------------------------
 
 void
-setPixelRGBA16(
+setPixelDitheredRGBA16(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
     const RGBA8_T *rgba)
 {
-    uint8_t r4 = rgba->red  >> 4;
-    uint8_t g4 = rgba->green >> 4;
-    uint8_t b4 = rgba->blue >> 4;
-    uint8_t a4 = rgba->alpha >> 4;
+    if (num < 1) num = 1;
 
-    uint16_t pixel = (r4 << 12) | (g4 << 8) | (b4 << 4) | a4;
-    uint16_t *value;  value = (uint16_t*) (image->buffer + (x * 2) + (y * image->pitch));
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint16_t pattern[8];
+            ditherPattern16(VC_IMAGE_RGBA16, rgba,
+                            x + image->xOrigin, y + image->yOrigin,
+                            pattern, count);
+
+            uint16_t *value = (uint16_t*)(image->buffer + (x * 2) + (y * image->pitch));
+            spanFillPattern16(value, pattern, count);
+            num -= count;
+        }
 
-    *value = pixel;
-    if (num >= 2) {
-	int yy = (num - x) / image->width;
-	int extra = (image->pitch - image->stride) * yy;
-	memfill( value, (sizeof(uint16_t) * num) + extra, sizeof(uint16_t) );
+        x = 0;
+        y++;
     }
 }
 
+
 //-----------------------------------------------------------------------
 
 void
-setPixelAlphaRGBA16(
+setPixelRGBA32(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
     const RGBA8_T *rgba)
 {
-    uint16_t *value;  value = (uint16_t*) (image->buffer + (x * 2) + (y *image->pitch));
-    uint8_t src_r4 = (*value & 0xF000) >> 8;
-    uint8_t src_g4 = (*value & 0x0F00) >> 4;
-    uint8_t src_b4 = (*value & 0x00F0);
-    uint8_t src_a4 = (*value & 0x000F);
-
-    int ad = 255 - rgba->alpha;
-    int as = rgba->alpha;
-    int tmp;
-
-    tmp = ((src_r4 * ad)/255) + ((rgba->red * as)/255);
-    src_r4 = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((src_g4 * ad)/255) + ((rgba->green * as)/255);
-    src_g4 = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((src_b4 * ad)/255) + ((rgba->blue * as)/255);
-    src_b4 = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-
-    *value = ((src_r4 >> 4) << 12) | ((src_g4 >> 4) << 8) | ((src_b4 >> 4) << 4) | src_a4;
-
-    if (num >= 2) {
-	if (x < image->width) {
-		setPixelAlphaRGBA16( image, x + 1, y, num - 1, rgba );
-	} else {
-		setPixelAlphaRGBA16( image, 0, y + 1, num - 1, rgba );
-	}
+    uint32_t pixel;
+    memcpy(&pixel, rgba, sizeof(pixel));
+
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
+    {
+        int32_t count = image->width - x;
+        if (count > num) count = num;
+
+        if (count > 0)
+        {
+            uint32_t *line = (uint32_t *)(image->buffer + (y * image->pitch)) + x;
+            spanFill32(line, pixel, count);
+            num -= count;
+        }
+
+        x = 0;
+        y++;
     }
 }
 
 //-----------------------------------------------------------------------
 
 void
-setPixelDitheredRGBA16(
+setPixelAlphaSpan(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
     const RGBA8_T *rgba)
 {
-    static int16_t dither16[64] =
+    if (num < 1) num = 1;
+
+    while ((num > 0) && (y < image->height))
     {
-         1,  12,   4,  15,   1,  13,   4,  15,
-         8,   4,  11,   7,   9,   5,  12,   8,
-         3,  14,   2,  13,   3,  15,   2,  14,
-        10,   6,   9,   5,  11,   7,  10,   6,
-         1,  12,   4,  15,   1,  12,   4,  15,
-         9,   5,  12,   8,   8,   5,  11,   8,
-         3,  14,   2,  13,   3,  14,   2,  13,
-        11,   7,  10,   6,  10,   7,   9,   6,
-    };
+        int32_t count = image->width - x;
+        if (count > num) count = num;
 
-    int32_t i;
-    for (i=0; i < num; i++) {
-	int32_t index = (x & 7) | ((y & 7) << 3);
+        if (count > 0)
+        {
+            image->blendSpan(image, x, y, count, rgba, NULL);
+            num -= count;
+        }
 
-	int16_t r = rgba->red + dither16[index];
-	if (r > 255) r = 255;
+        x = 0;
+        y++;
+    }
+}
 
-	int16_t g = rgba->green + dither16[index];
-	if (g > 255) g = 255;
+//-----------------------------------------------------------------------
 
-	int16_t b = rgba->blue + dither16[index];
-	if (b > 255) b = 255;
+void
+blendSpanAlpha(		// for types that have no blend kernel.
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t num,
+    const RGBA8_T *rgba,
+    const uint8_t *coverage)
+{
+    RGBA8_T rgb = *rgba;
 
-	int16_t a = rgba->alpha + dither16[index];
-	if (b > 255) b = 255;
+    int32_t i;
+    for (i = 0 ; i < num ; i++)
+    {
+        if (coverage != NULL)
+        {
+            if (coverage[i] == 0) continue;
+            rgb.alpha = (coverage[i] * rgba->alpha) / 255;
+        }
 
-	RGBA8_T dithered = { r, g, b, a };
+        image->setPixelAlpha(image, x + i, y, 1, &rgb);
+    }
+}
 
-	setPixelRGBA16(image, x, y, 1, &dithered);
+//-----------------------------------------------------------------------
 
-	x++;
-	if (x > image->width) {
-	    x = 0; y++;
-	    if (y > image->height) return;
-	}
-    }
+void
+blendSpanRGBA16(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t num,
+    const RGBA8_T *rgba,
+    const uint8_t *coverage)
+{
+    const uint8_t colour[4] = { rgba->red, rgba->green, rgba->blue, rgba->alpha };
+    uint16_t *value = (uint16_t*)(image->buffer + (x * 2) + (y * image->pitch));
+
+    spanBlendRGBA16(value, colour, coverage, num);
 }
 
 //-----------------------------------------------------------------------
 
 void
-setPixelRGBA32(
+blendSpanRGB888(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
-    const RGBA8_T *rgba)
+    const RGBA8_T *rgba,
+    const uint8_t *coverage)
 {
-    uint8_t *line = (uint8_t *)(image->buffer) + (y * image->pitch) + (4 * x);
+    const uint8_t colour[4] = { rgba->red, rgba->green, rgba->blue, rgba->alpha };
+    uint8_t *line = (uint8_t *)(image->buffer) + (y * image->pitch) + (3 * x);
 
-    line[0] = rgba->red;
-    line[1] = rgba->green;
-    line[2] = rgba->blue;
-    line[3] = rgba->alpha;
-    if (num >= 2) {
-	int yy = (num - x) / image->width;
-	int extra = (image->pitch - image->stride) * yy;
-	memfill( line, (sizeof(uint8_t) * 4 * num) + extra, sizeof(uint8_t) * 4 );
-    }
+    spanBlendRGB888(line, colour, coverage, num);
 }
 
 //-----------------------------------------------------------------------
 
 void
-setPixelAlphaRGBA32(
+blendSpanRGBA32(
     IMAGE_T *image,
     int32_t x,
     int32_t y,
     int32_t num,
-    const RGBA8_T *rgba)
+    const RGBA8_T *rgba,
+    const uint8_t *coverage)
 {
-    uint8_t *line; line = (uint8_t *)(image->buffer) + (y * image->pitch) + (4 * x);
-    int ad = 255 - rgba->alpha;
-    int as = rgba->alpha;
-    int tmp;
-
-    tmp = ((line[0] * ad)/255) + ((rgba->red * as)/255);
-    line[0] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((line[1] * ad)/255) + ((rgba->green * as)/255);
-    line[1] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-    tmp = ((line[2] * ad)/255) + ((rgba->blue * as)/255);
-    line[2] = tmp < 255 ? (tmp >= 0 ? tmp : 0) : 255;
-
-    if (num >= 2) {
-	if (x < image->width) {
-		setPixelAlphaRGBA32( image, x + 1, y, num - 1, rgba );
-	} else {
-		setPixelAlphaRGBA32( image, 0, y + 1, num - 1, rgba );
-	}
-    }
+    const uint8_t colour[4] = { rgba->red, rgba->green, rgba->blue, rgba->alpha };
+    uint8_t *line = (uint8_t *)(image->buffer) + (y * image->pitch) + (4 * x);
+
+    spanBlendRGBA32(line, colour, coverage, num);
 }
 
 //-----------------------------------------------------------------------
@@ -904,6 +1466,81 @@ static size_t imageTypeInfoEntries = sizeof(imageTypeInfo)/
 
 //-----------------------------------------------------------------------
 
+// Rows are converted with the row converters in imageConvert.c, in
+// bands of rows shared out by the job pool.
+
+typedef struct
+{
+    IMAGE_T *src_image;
+    IMAGE_T *dst_image;
+    int32_t src_x;
+    int32_t src_y;
+    int32_t dst_x;
+    int32_t dst_y;
+    int32_t width;
+    bool dithered;
+    bool reverse;
+} COPY_JOB_T;
+
+static void
+copyRows(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    COPY_JOB_T *job = context;
+    IMAGE_T *src_image = job->src_image;
+    IMAGE_T *dst_image = job->dst_image;
+
+    int32_t n;
+    for (n = first ; n < last ; n++)
+    {
+        int32_t i = (job->reverse) ? (last - 1 - (n - first)) : n;
+
+        const uint8_t *src_row = (uint8_t *)(src_image->buffer) + (src_image->pitch * (job->src_y + i));
+        uint8_t *dst_row = (uint8_t *)(dst_image->buffer) + (dst_image->pitch * (job->dst_y + i));
+
+        if (job->dithered)
+        {
+            // Convert relative to the start of the owning row so that
+            // views keep the same dither phase as their parent.
+
+            convertImageRowDithered(src_image->type, src_row, job->src_x,
+                                    dst_image->type,
+                                    dst_row - (dst_image->xOrigin * dst_image->bitsPerPixel / 8),
+                                    job->dst_x + dst_image->xOrigin,
+                                    job->dst_y + dst_image->yOrigin + i,
+                                    job->width, NULL);
+        }
+        else
+        {
+            convertImageRow(src_image->type, src_row, job->src_x,
+                            dst_image->type, dst_row, job->dst_x,
+                            job->width, NULL);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+// True if the pixels of the two images can overlap, which is the case for
+// an image and its views, or for two views of the same image.
+
+static bool
+imagesShareBuffer(
+    const IMAGE_T *a,
+    const IMAGE_T *b)
+{
+    const uint8_t *aStart = a->buffer;
+    const uint8_t *aEnd = aStart + (a->pitch * (a->height - 1)) + a->stride;
+    const uint8_t *bStart = b->buffer;
+    const uint8_t *bEnd = bStart + (b->pitch * (b->height - 1)) + b->stride;
+
+    return (aStart < bEnd) && (bStart < aEnd);
+}
+
+//-------------------------------------------------------------------------
+
 void
 copyImageRGB(
     IMAGE_T *src_image,
@@ -912,48 +1549,59 @@ copyImageRGB(
     int32_t src_w, int32_t src_h,
     int32_t dst_x, int32_t dst_y)
 {
+    if (src_x < 0) { src_w += src_x; dst_x -= src_x; src_x = 0; }
+    if (src_y < 0) { src_h += src_y; dst_y -= src_y; src_y = 0; }
+
+    const VC_RECT_T *clip = &(dst_image->clip);
+    int32_t clip_x = clip->x - dst_x;
+    int32_t clip_y = clip->y - dst_y;
+
+    if (clip_x > 0) { src_w -= clip_x; src_x += clip_x; dst_x = clip->x; }
+    if (clip_y > 0) { src_h -= clip_y; src_y += clip_y; dst_y = clip->y; }
+
     if (src_w + src_x > src_image->width)  src_w = src_image->width - src_x;
     if (src_h + src_y > src_image->height) src_h = src_image->height - src_y;
-    int32_t dst_w = src_w;  if (dst_w + dst_x > dst_image->width)  dst_w = dst_image->width - dst_x;
-    int32_t dst_h = src_h;  if (dst_h + dst_y > dst_image->height) dst_h = dst_image->height - dst_y;
-    if (dst_w != src_w) src_w = dst_w;  if (dst_h != src_h) src_h = dst_h;
-    int32_t i, j, k;
-    int32_t stride = src_w * src_image->bitsPerPixel / 8;
-
-    if (src_image == dst_image) {
-	uint8_t *tmpbuf = calloc(src_h, stride);
-
-	for (i=0; i < src_h; i++) {
-	    j = i + src_y;
-	    memcpy( tmpbuf + (stride * i), src_image->buffer + (src_image->pitch * j) + src_x, stride );
-	}
-	for (i=0; i < dst_h; i++) {
-	    j = i + dst_y;
-	    memcpy( dst_image->buffer + (dst_image->pitch * j) + dst_x, tmpbuf + (stride * i), stride );
-	}
-	free( tmpbuf );
-    } else {
-	if (src_image->type == dst_image->type) {
-	    for (i=0; i < src_h; i++) {
-		j = i + src_y;
-		k = i + dst_y;
-		memcpy( dst_image->buffer + (dst_image->pitch * k) + dst_x,
-		    src_image->buffer + (src_image->pitch * j) + src_x, stride );
-	    }
-	} else {
-	    RGBA8_T  rgb;
-	    for (i=0; i < src_h; i++) {
-		int y1 = i + src_y;
-		int y2 = i + dst_y;
-		for (j=0; j < src_w; j++) {
-		    int x1 = j + src_x;
-		    int x2 = j + dst_x;
-		    getPixelRGB( src_image, x1, y1, &rgb );
-		    setPixelRGB( dst_image, x2, y2, 1, &rgb );
-		}
-	    }
-	}
+    if (src_w + dst_x > clip->x + clip->width)  src_w = clip->x + clip->width - dst_x;
+    if (src_h + dst_y > clip->y + clip->height) src_h = clip->y + clip->height - dst_y;
+
+    if ((src_w <= 0) || (src_h <= 0))
+    {
+        return;
     }
+
+    if (canConvertImageType(src_image->type, dst_image->type, false) == false)
+    {
+        return;
+    }
+
+    COPY_JOB_T job =
+    {
+        .src_image = src_image,
+        .dst_image = dst_image,
+        .src_x = src_x,
+        .src_y = src_y,
+        .dst_x = dst_x,
+        .dst_y = dst_y,
+        .width = src_w,
+        .dithered = isImageDithered(dst_image),
+        .reverse = false
+    };
+
+    if (imagesShareBuffer(src_image, dst_image))
+    {
+        // Walk the rows in the direction that does not overwrite rows
+        // still to be read, on this thread.
+
+        job.reverse = (dst_y + dst_image->yOrigin > src_y + src_image->yOrigin);
+        copyRows(&job, 0, src_h);
+    }
+    else
+    {
+        size_t bytes = ((size_t)(dst_image->pitch) * src_h * src_w) / dst_image->width;
+        runImageJobRows(copyRows, &job, src_h, bytes);
+    }
+
+    markImageDirty(dst_image, dst_x, dst_y, src_w, src_h);
 }
 
 //-----------------------------------------------------------------------
@@ -979,7 +1627,7 @@ expand_and_duplicate_Image(
     image->alignedHeight = ALIGN_TO_16(image->height);
     image->size = image->pitch * image->alignedHeight;
 
-    image->buffer = calloc(2,image->size);
+    image->buffer = allocImageBuffer(image->type, image->size);
 
     if (image->buffer == NULL)
     {
@@ -998,42 +1646,80 @@ expand_and_duplicate_Image(
     if (y>0) {
 	memcpy( image->buffer + (image->pitch * old_y), image->buffer, (image->pitch * y) );
     }
-    free( old_buffer );
+
+    // The image now has a buffer of its own, even if it was a view or
+    // a mapped file.
+    void *new_buffer = image->buffer;
+    image->buffer = old_buffer;
+    releaseImageBuffer( image );
+    image->buffer = new_buffer;
+
+    image->parent = NULL;
+    image->xOrigin = 0;
+    image->yOrigin = 0;
+    image->ownsBuffer = true;
+
+    resetImageClip( image );
+    clearImageDirty( image );
+    markImageDirty( image, 0, 0, image->width, image->height );
 }
 
 //-----------------------------------------------------------------------
 
+typedef struct
+{
+    IMAGE_T *image;
+    int32_t bytes;
+    uint8_t ch1;
+    uint8_t ch2;
+} SWAP_JOB_T;
+
+static void
+swapRows(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    SWAP_JOB_T *job = context;
+    IMAGE_T *image = job->image;
+    int32_t i, j;
+
+    for (i=first; i < last; i++) {
+	uint8_t *buffer = (uint8_t *) (image->buffer) + (i * image->pitch);
+	for(j=0; j < image->width; j++, buffer += job->bytes) {
+	    uint8_t swap = buffer[job->ch1 - 1];
+	    buffer[job->ch1 - 1] = buffer[job->ch2 - 1];
+	    buffer[job->ch2 - 1] = swap;
+	}
+    }
+}
+
+//-------------------------------------------------------------------------
+
 void
 swap_color_channels(
     IMAGE_T *image,
     uint8_t ch1,
     uint8_t ch2)
 {
-    int32_t i, j;
+    SWAP_JOB_T job = { .image = image, .ch1 = ch1, .ch2 = ch2 };
 
            if (image->type == VC_IMAGE_RGB565) {
+	return;
     } else if (image->type == VC_IMAGE_RGB888) {
 	if (ch1 > 3 || ch1 < 1 || ch2 > 3 || ch2 < 1) return;
-	for (i=0; i < image->height; i++) {
-	    for(j=0; j < image->width; j++) {
-		uint8_t *buffer = (uint8_t *) (image->buffer) + (i * image->pitch) + (3 * j);
-		uint8_t swap = buffer[ch1 - 1];
-		buffer[ch1 - 1] = buffer[ch2 - 1];
-		buffer[ch2 - 1] = swap;
-	    }
-	}
+	job.bytes = 3;
     } else if (image->type == VC_IMAGE_RGBA16) {
+	return;
     } else if (image->type == VC_IMAGE_RGBA32) {
 	if (ch1 > 4 || ch1 < 1 || ch2 > 4 || ch2 < 1) return;
-	for (i=0; i < image->height; i++) {
-	    for(j=0; j < image->width; j++) {
-		uint8_t *buffer = (uint8_t *) (image->buffer) + (i * image->pitch) + (4 * j);
-		uint8_t swap = buffer[ch1 - 1];
-		buffer[ch1 - 1] = buffer[ch2 - 1];
-		buffer[ch2 - 1] = swap;
-	    }
-	}
+	job.bytes = 4;
+    } else {
+	return;
     }
+
+    runImageJobRows(swapRows, &job, image->height, image->pitch * image->height);
+    markImageDirty(image, 0, 0, image->width, image->height);
 }
 
 
@@ -48,6 +48,17 @@ typedef struct
 
 //-------------------------------------------------------------------------
 
+#define IMAGE_DIRTY_RECTS 8
+#define IMAGE_CLIP_DEPTH 8
+
+typedef struct
+{
+    int32_t count;
+    VC_RECT_T rects[IMAGE_DIRTY_RECTS];
+} IMAGE_DIRTY_T;
+
+//-------------------------------------------------------------------------
+
 typedef struct IMAGE_T_ IMAGE_T;
 
 struct IMAGE_T_
@@ -66,6 +77,17 @@ struct IMAGE_T_
     void (*getPixelDirect)(IMAGE_T*, int32_t, int32_t, RGBA8_T*);
     void (*setPixelIndexed)(IMAGE_T*, int32_t, int32_t, int32_t, int8_t);
     void (*getPixelIndexed)(IMAGE_T*, int32_t, int32_t, int8_t*);
+    void (*blendSpan)(IMAGE_T*, int32_t, int32_t, int32_t, const RGBA8_T*, const uint8_t*);
+    IMAGE_DIRTY_T dirty;	// areas changed since the last upload
+    IMAGE_T *parent;	// image this is a view into, or NULL
+    int32_t xOrigin;	// position in the buffer that owns the pixels
+    int32_t yOrigin;
+    bool ownsBuffer;	// false for views, the parent frees the buffer
+    void *mapping;	// file mapping holding the buffer, or NULL
+    size_t mappingSize;
+    VC_RECT_T clip;	// drawing is limited to this area
+    VC_RECT_T clipStack[IMAGE_CLIP_DEPTH];
+    int32_t clipDepth;
 };
 
 //-------------------------------------------------------------------------
@@ -106,6 +128,64 @@ initImage(
     int32_t height,
     bool dither);
 
+// Wrap a buffer that the image does not own, such as a mapped file.
+
+bool
+initImageBuffer(
+    IMAGE_T *image,
+    VC_IMAGE_TYPE_T type,
+    int32_t width,
+    int32_t height,
+    int32_t pitch,
+    int32_t alignedHeight,
+    void *buffer,
+    bool dither);
+
+// A view is an IMAGE_T for a rectangle of another image. It shares the
+// parent's buffer and pitch, so drawing into it draws into the parent,
+// and areas marked dirty in the view are also marked in the parent. The
+// parent must outlive the view. For VC_IMAGE_4BPP, x must be even. The
+// view starts with the parent's current clip rectangle.
+
+bool
+initImageView(
+    IMAGE_T *view,
+    IMAGE_T *parent,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+// The clip rectangle limits every drawing function except the clears.
+// pushImageClip() intersects the current clip with a rectangle and saves
+// the previous one, which popImageClip() restores. Both return false when
+// the stack is full or empty.
+
+bool
+pushImageClip(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+bool
+popImageClip(
+    IMAGE_T *image);
+
+void
+resetImageClip(
+    IMAGE_T *image);
+
+// Clip a rectangle to the clip rectangle. Returns false if nothing is left.
+
+bool
+clipImageRect(
+    const IMAGE_T *image,
+    VC_RECT_T *rect);
+
+//-------------------------------------------------------------------------
+
 void
 clearImageIndexed(
     IMAGE_T *image,
@@ -140,6 +220,15 @@ setPixelRGB(
     int32_t num,
     const RGBA8_T *rgb);
 
+bool
+blendSpanRGBA(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t num,
+    const RGBA8_T *rgb,
+    const uint8_t *coverage);
+
 bool
 getPixelIndexed(
     IMAGE_T *image,
@@ -154,12 +243,40 @@ getPixelRGB(
     int32_t y,
     RGBA8_T *rgb);
 
+bool
+isImageDithered(
+    const IMAGE_T *image);
+
 void
 destroyImage(
     IMAGE_T *image);
 
 //-------------------------------------------------------------------------
 
+void
+markImageDirty(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+void
+clearImageDirty(
+    IMAGE_T *image);
+
+// Add an area to a dirty list without clipping it to an image.
+
+void
+addImageDirtyRect(
+    IMAGE_DIRTY_T *dirty,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+//-------------------------------------------------------------------------
+
 void
 copyImageRGB(
     IMAGE_T *src_image,
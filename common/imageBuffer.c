@@ -0,0 +1,417 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "imageBuffer.h"
+
+//-------------------------------------------------------------------------
+
+#define IMAGE_BUFFER_PAGE_SIZE 4096
+#define IMAGE_BUFFER_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define IMAGE_BUFFER_CLASSES 256
+#define IMAGE_BUFFER_DEFAULT_POOL_LIMIT (32 * 1024 * 1024)
+
+#define ALIGN_TO(x, a)  (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+//-------------------------------------------------------------------------
+//
+// Each buffer is preceded by a header that takes up exactly one alignment
+// unit, so the pixels that follow it are still aligned.
+//
+//-------------------------------------------------------------------------
+
+typedef struct IMAGE_BUFFER_HEADER_T_ IMAGE_BUFFER_HEADER_T;
+
+struct IMAGE_BUFFER_HEADER_T_
+{
+    size_t capacity;    // bytes available after the header
+    size_t mapped;      // length of the mmap, or 0 if from posix_memalign
+    VC_IMAGE_TYPE_T type;
+    IMAGE_BUFFER_HEADER_T *next;
+};
+
+#define IMAGE_BUFFER_HEADER_SIZE IMAGE_BUFFER_ALIGNMENT
+
+//-------------------------------------------------------------------------
+
+static IMAGE_BUFFER_HEADER_T *freeLists[IMAGE_BUFFER_CLASSES];
+static size_t poolBytes = 0;
+static size_t poolLimit = IMAGE_BUFFER_DEFAULT_POOL_LIMIT;
+static bool hugePages = false;
+
+static IMAGE_BUFFER_STATS_T typeStats[VC_IMAGE_MAX];
+static IMAGE_BUFFER_STATS_T totalStats;
+
+//-------------------------------------------------------------------------
+//
+// Sizes are counted in alignment units of 64 bytes. Below one page every
+// size has its own class, above that each power of two is split into
+// eight classes, so all the buffers in a class are within 12.5% of each
+// other.
+//
+//-------------------------------------------------------------------------
+
+static int
+sizeClass(
+    size_t size)
+{
+    size_t units = (size + IMAGE_BUFFER_ALIGNMENT - 1) / IMAGE_BUFFER_ALIGNMENT;
+    size_t pageUnits = IMAGE_BUFFER_PAGE_SIZE / IMAGE_BUFFER_ALIGNMENT;
+
+    if (units < pageUnits)
+    {
+        return units;
+    }
+
+    int log2 = (8 * sizeof(unsigned long long)) - 1 - __builtin_clzll(units);
+    int sub = (units >> (log2 - 3)) & 7;
+    int class = pageUnits + ((log2 - __builtin_ctzll(pageUnits)) * 8) + sub;
+
+    if (class >= IMAGE_BUFFER_CLASSES)
+    {
+        class = IMAGE_BUFFER_CLASSES - 1;
+    }
+
+    return class;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+countAllocation(
+    IMAGE_BUFFER_STATS_T *stats,
+    size_t bytes,
+    bool reused)
+{
+    stats->buffers++;
+    stats->bytes += bytes;
+    stats->allocations++;
+
+    if (reused)
+    {
+        stats->reused++;
+    }
+
+    if (stats->bytes > stats->peakBytes)
+    {
+        stats->peakBytes = stats->bytes;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+countFree(
+    IMAGE_BUFFER_STATS_T *stats,
+    size_t bytes)
+{
+    stats->buffers--;
+    stats->bytes -= bytes;
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_BUFFER_HEADER_T *
+takeFromPool(
+    size_t size)
+{
+    IMAGE_BUFFER_HEADER_T **link = &(freeLists[sizeClass(size)]);
+
+    while (*link != NULL)
+    {
+        IMAGE_BUFFER_HEADER_T *header = *link;
+
+        if (header->capacity >= size)
+        {
+            *link = header->next;
+            header->next = NULL;
+            poolBytes -= header->capacity;
+
+            return header;
+        }
+
+        link = &(header->next);
+    }
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_BUFFER_HEADER_T *
+mapBuffer(
+    size_t total)
+{
+    size_t length = ALIGN_TO(total, IMAGE_BUFFER_HUGE_PAGE_SIZE);
+    void *block = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    block = mmap(NULL,
+                 length,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                 -1,
+                 0);
+#endif
+
+    if (block == MAP_FAILED)
+    {
+        // no reserved huge pages, ask for transparent huge pages instead.
+
+        block = mmap(NULL,
+                     length,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1,
+                     0);
+
+        if (block == MAP_FAILED)
+        {
+            return NULL;
+        }
+
+#ifdef MADV_HUGEPAGE
+        madvise(block, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    IMAGE_BUFFER_HEADER_T *header = block;
+    header->mapped = length;
+    header->capacity = length - IMAGE_BUFFER_HEADER_SIZE;
+
+    return header;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+releaseBuffer(
+    IMAGE_BUFFER_HEADER_T *header)
+{
+    if (header->mapped)
+    {
+        munmap(header, header->mapped);
+    }
+    else
+    {
+        free(header);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void *
+allocImageBuffer(
+    VC_IMAGE_TYPE_T type,
+    size_t size)
+{
+    assert(sizeof(IMAGE_BUFFER_HEADER_T) <= IMAGE_BUFFER_HEADER_SIZE);
+
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    bool reused = true;
+    IMAGE_BUFFER_HEADER_T *header = takeFromPool(size);
+
+    if (header != NULL)
+    {
+        memset((uint8_t *)header + IMAGE_BUFFER_HEADER_SIZE, 0, size);
+    }
+    else
+    {
+        reused = false;
+
+        size_t total = ALIGN_TO(size + IMAGE_BUFFER_HEADER_SIZE,
+                                IMAGE_BUFFER_ALIGNMENT);
+
+        if (hugePages && (total >= IMAGE_BUFFER_HUGE_PAGE_SIZE))
+        {
+            header = mapBuffer(total);
+        }
+
+        if (header == NULL)
+        {
+            void *block = NULL;
+
+            if (posix_memalign(&block, IMAGE_BUFFER_ALIGNMENT, total) != 0)
+            {
+                return NULL;
+            }
+
+            memset(block, 0, total);
+
+            header = block;
+            header->mapped = 0;
+            header->capacity = total - IMAGE_BUFFER_HEADER_SIZE;
+        }
+    }
+
+    header->type = type;
+    header->next = NULL;
+
+    if ((type >= 0) && (type < VC_IMAGE_MAX))
+    {
+        countAllocation(&(typeStats[type]), header->capacity, reused);
+    }
+    countAllocation(&totalStats, header->capacity, reused);
+
+    return (uint8_t *)header + IMAGE_BUFFER_HEADER_SIZE;
+}
+
+//-------------------------------------------------------------------------
+
+void
+freeImageBuffer(
+    void *buffer)
+{
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    IMAGE_BUFFER_HEADER_T *header =
+        (IMAGE_BUFFER_HEADER_T *)((uint8_t *)buffer - IMAGE_BUFFER_HEADER_SIZE);
+
+    if ((header->type >= 0) && (header->type < VC_IMAGE_MAX))
+    {
+        countFree(&(typeStats[header->type]), header->capacity);
+    }
+    countFree(&totalStats, header->capacity);
+
+    if (poolBytes + header->capacity <= poolLimit)
+    {
+        int class = sizeClass(header->capacity);
+
+        header->next = freeLists[class];
+        freeLists[class] = header;
+        poolBytes += header->capacity;
+    }
+    else
+    {
+        releaseBuffer(header);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+size_t
+getImageBufferCapacity(
+    const void *buffer)
+{
+    if (buffer == NULL)
+    {
+        return 0;
+    }
+
+    const IMAGE_BUFFER_HEADER_T *header =
+        (const IMAGE_BUFFER_HEADER_T *)((const uint8_t *)buffer
+                                        - IMAGE_BUFFER_HEADER_SIZE);
+
+    return header->capacity + IMAGE_BUFFER_HEADER_SIZE;
+}
+
+//-------------------------------------------------------------------------
+
+void
+setImageBufferPoolLimit(
+    size_t bytes)
+{
+    poolLimit = bytes;
+
+    if (poolBytes > poolLimit)
+    {
+        releaseImageBufferPool();
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+setImageBufferHugePages(
+    bool enable)
+{
+    hugePages = enable;
+}
+
+//-------------------------------------------------------------------------
+
+void
+releaseImageBufferPool(void)
+{
+    int class;
+    for (class = 0 ; class < IMAGE_BUFFER_CLASSES ; class++)
+    {
+        while (freeLists[class] != NULL)
+        {
+            IMAGE_BUFFER_HEADER_T *header = freeLists[class];
+            freeLists[class] = header->next;
+            releaseBuffer(header);
+        }
+    }
+
+    poolBytes = 0;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+getImageBufferStats(
+    VC_IMAGE_TYPE_T type,
+    IMAGE_BUFFER_STATS_T *stats)
+{
+    if (type == VC_IMAGE_MIN)
+    {
+        memcpy(stats, &totalStats, sizeof(IMAGE_BUFFER_STATS_T));
+        return true;
+    }
+
+    if ((type < 0) || (type >= VC_IMAGE_MAX))
+    {
+        return false;
+    }
+
+    memcpy(stats, &(typeStats[type]), sizeof(IMAGE_BUFFER_STATS_T));
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+size_t
+getImageBufferPoolBytes(void)
+{
+    return poolBytes;
+}
+
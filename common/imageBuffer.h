@@ -0,0 +1,110 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_BUFFER_H
+#define IMAGE_BUFFER_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bcm_host.h"
+
+//-------------------------------------------------------------------------
+//
+// Pixel buffers for IMAGE_T. Every buffer is zero filled and aligned to
+// IMAGE_BUFFER_ALIGNMENT bytes. Freed buffers are kept in size class free
+// lists (up to the pool limit) so that images created and destroyed for
+// each scene reuse the same memory. Large buffers can optionally be backed
+// by huge pages.
+//
+// A new buffer is the size asked for rounded up to the alignment. One
+// reused from a free list may be up to 12.5% larger, and one backed by
+// huge pages is a whole number of them. The stats count these capacities,
+// which is the memory the buffers really hold.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_BUFFER_ALIGNMENT 64
+
+typedef struct
+{
+    uint32_t buffers;       // buffers currently allocated
+    uint64_t bytes;         // capacity of the buffers currently allocated
+    uint64_t peakBytes;     // largest value bytes has reached
+    uint32_t allocations;   // total number of allocations
+    uint32_t reused;        // allocations satisfied from the free lists
+} IMAGE_BUFFER_STATS_T;
+
+//-------------------------------------------------------------------------
+
+void *
+allocImageBuffer(
+    VC_IMAGE_TYPE_T type,
+    size_t size);
+
+void
+freeImageBuffer(
+    void *buffer);
+
+// The memory a buffer really takes: its capacity and the header in front
+// of it.
+
+size_t
+getImageBufferCapacity(
+    const void *buffer);
+
+//-------------------------------------------------------------------------
+
+void
+setImageBufferPoolLimit(
+    size_t bytes);
+
+void
+setImageBufferHugePages(
+    bool enable);
+
+void
+releaseImageBufferPool(void);
+
+//-------------------------------------------------------------------------
+
+// Passing VC_IMAGE_MIN as the type returns the totals for all types.
+
+bool
+getImageBufferStats(
+    VC_IMAGE_TYPE_T type,
+    IMAGE_BUFFER_STATS_T *stats);
+
+size_t
+getImageBufferPoolBytes(void);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,952 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "imageCommands.h"
+#include "imageGraphics.h"
+#include "imageJobs.h"
+#include "imagePen.h"
+#include "imageRaster.h"
+#include "simple_font.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+void
+initImageCommands(
+    IMAGE_COMMANDS_T *commands)
+{
+    commands->commands = NULL;
+    commands->count = 0;
+    commands->capacity = 0;
+    commands->data = NULL;
+    commands->dataSize = 0;
+    commands->dataCapacity = 0;
+    commands->tiles = NULL;
+    commands->tilesWide = 0;
+    commands->tilesHigh = 0;
+    commands->tileCapacity = 0;
+    commands->bins = NULL;
+    commands->binCapacity = 0;
+}
+
+//-------------------------------------------------------------------------
+
+void
+resetImageCommands(
+    IMAGE_COMMANDS_T *commands)
+{
+    commands->count = 0;
+    commands->dataSize = 0;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyImageCommands(
+    IMAGE_COMMANDS_T *commands)
+{
+    free(commands->commands);
+    free(commands->data);
+    free(commands->tiles);
+    free(commands->bins);
+
+    initImageCommands(commands);
+}
+
+//-------------------------------------------------------------------------
+
+static void *
+growArray(
+    void *array,
+    int32_t *capacity,
+    size_t needed,
+    size_t size)
+{
+    if (needed <= (size_t)(*capacity))
+    {
+        return array;
+    }
+
+    size_t newCapacity = (*capacity) ? 2 * (size_t)(*capacity) : 64;
+
+    while (newCapacity < needed)
+    {
+        newCapacity *= 2;
+    }
+
+    array = realloc(array, newCapacity * size);
+
+    if (array == NULL)
+    {
+        fprintf(stderr, "imageCommands: memory exhausted\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *capacity = (int32_t)newCapacity;
+
+    return array;
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_COMMAND_T *
+addCommand(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_COMMAND_KIND_T kind,
+    bool indexed,
+    int8_t index,
+    const RGBA8_T *rgb)
+{
+    commands->commands = growArray(commands->commands,
+                                   &(commands->capacity),
+                                   commands->count + 1,
+                                   sizeof(IMAGE_COMMAND_T));
+
+    IMAGE_COMMAND_T *command = &(commands->commands[commands->count++]);
+
+    memset(command, 0, sizeof(IMAGE_COMMAND_T));
+
+    command->kind = kind;
+    command->indexed = indexed;
+    command->index = index;
+
+    if (rgb != NULL)
+    {
+        command->rgb = *rgb;
+    }
+
+    return command;
+}
+
+//-------------------------------------------------------------------------
+//
+// Points, text and coverage are copied into one buffer and referred to by
+// offset, so that growing the buffer does not invalidate commands. With
+// no data the space is only reserved.
+//
+//-------------------------------------------------------------------------
+
+static size_t
+addData(
+    IMAGE_COMMANDS_T *commands,
+    const void *data,
+    size_t size)
+{
+    size_t offset = (commands->dataSize + 7) & ~(size_t)7;
+
+    if (offset + size > commands->dataCapacity)
+    {
+        size_t capacity = (commands->dataCapacity)
+                        ? 2 * commands->dataCapacity
+                        : 4096;
+
+        while (capacity < offset + size)
+        {
+            capacity *= 2;
+        }
+
+        uint8_t *buffer = realloc(commands->data, capacity);
+
+        if (buffer == NULL)
+        {
+            fprintf(stderr, "imageCommands: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+
+        commands->data = buffer;
+        commands->dataCapacity = capacity;
+    }
+
+    if (data != NULL)
+    {
+        memcpy(commands->data + offset, data, size);
+    }
+
+    commands->dataSize = offset + size;
+
+    return offset;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+setBoundsCorners(
+    IMAGE_COMMAND_T *command,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2)
+{
+    command->x1 = x1;
+    command->y1 = y1;
+    command->x2 = x2;
+    command->y2 = y2;
+
+    command->bounds.x = (x1 < x2) ? x1 : x2;
+    command->bounds.y = (y1 < y2) ? y1 : y2;
+    command->bounds.width = abs(x2 - x1) + 1;
+    command->bounds.height = abs(y2 - y1) + 1;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+recordBox(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_COMMAND_KIND_T kind,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    bool indexed,
+    int8_t index,
+    const RGBA8_T *rgb)
+{
+    IMAGE_COMMAND_T *command = addCommand(commands, kind, indexed, index, rgb);
+
+    setBoundsCorners(command, x1, y1, x2, y2);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageBoxIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index)
+{
+    recordBox(commands, IMAGE_COMMAND_BOX, x1, y1, x2, y2, true, index, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageBoxRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb)
+{
+    recordBox(commands, IMAGE_COMMAND_BOX, x1, y1, x2, y2, false, 0, rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageBoxFilledIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index)
+{
+    recordBox(commands,
+              IMAGE_COMMAND_BOX_FILLED,
+              x1, y1, x2, y2,
+              true, index, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageBoxFilledRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb)
+{
+    recordBox(commands,
+              IMAGE_COMMAND_BOX_FILLED,
+              x1, y1, x2, y2,
+              false, 0, rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageLineIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index)
+{
+    recordBox(commands, IMAGE_COMMAND_LINE, x1, y1, x2, y2, true, index, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageLineRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb)
+{
+    recordBox(commands, IMAGE_COMMAND_LINE, x1, y1, x2, y2, false, 0, rgb);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+recordPolygon(
+    IMAGE_COMMANDS_T *commands,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    bool indexed,
+    int8_t index,
+    const RGBA8_T *rgb)
+{
+    if (poly->points < 3)
+    {
+        return;
+    }
+
+    size_t data = addData(commands,
+                          poly->p,
+                          poly->points * sizeof(POLYPOINT_T));
+
+    IMAGE_COMMAND_T *command = addCommand(commands,
+                                          IMAGE_COMMAND_POLYGON,
+                                          indexed,
+                                          index,
+                                          rgb);
+
+    command->count = poly->points;
+    command->data = data;
+    command->rule = rule;
+    command->antialias = antialias;
+
+    int32_t left = poly->p[0].x;
+    int32_t top = poly->p[0].y;
+    int32_t right = left;
+    int32_t bottom = top;
+
+    int32_t i;
+    for (i = 1 ; i < poly->points ; i++)
+    {
+        if (poly->p[i].x < left) left = poly->p[i].x;
+        if (poly->p[i].y < top) top = poly->p[i].y;
+        if (poly->p[i].x > right) right = poly->p[i].x;
+        if (poly->p[i].y > bottom) bottom = poly->p[i].y;
+    }
+
+    command->bounds.x = left;
+    command->bounds.y = top;
+    command->bounds.width = right - left + 1;
+    command->bounds.height = bottom - top + 1;
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImagePolygonFilledRuleIndexed(
+    IMAGE_COMMANDS_T *commands,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index)
+{
+    recordPolygon(commands, poly, rule, false, true, index, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImagePolygonFilledRuleRGB(
+    IMAGE_COMMANDS_T *commands,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb)
+{
+    recordPolygon(commands, poly, rule, antialias, false, 0, rgb);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+recordString(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    const char *string,
+    bool indexed,
+    int8_t index,
+    const RGBA8_T *rgb)
+{
+    if (string == NULL)
+    {
+        return;
+    }
+
+    // The same layout as drawStringRGB(), to find the bounding box.
+
+    int32_t columns = 0;
+    int32_t widest = 0;
+    int32_t lines = 1;
+    const char *c = string;
+
+    while (*c != '\0')
+    {
+        if (*c == '\n')
+        {
+            columns = 0;
+            ++lines;
+            ++c;
+        }
+        else
+        {
+            nextFontGlyph(&c);
+
+            if (++columns > widest)
+            {
+                widest = columns;
+            }
+        }
+    }
+
+    size_t data = addData(commands, string, (c - string) + 1);
+
+    IMAGE_COMMAND_T *command = addCommand(commands,
+                                          IMAGE_COMMAND_STRING,
+                                          indexed,
+                                          index,
+                                          rgb);
+
+    command->x1 = x;
+    command->y1 = y;
+    command->data = data;
+    command->bounds.x = x;
+    command->bounds.y = y;
+    command->bounds.width = widest * FONT_WIDTH;
+    command->bounds.height = lines * FONT_HEIGHT;
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordStringIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    const char *string,
+    int8_t index)
+{
+    recordString(commands, x, y, string, true, index, NULL);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordStringRGB(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    const char *string,
+    const RGBA8_T *rgb)
+{
+    recordString(commands, x, y, string, false, 0, rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageMaskRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height,
+    int32_t pitch,
+    const uint8_t *coverage,
+    const RGBA8_T *rgb)
+{
+    if ((width <= 0) || (height <= 0))
+    {
+        return;
+    }
+
+    // Copy the rows without their padding.
+
+    size_t data = addData(commands, NULL, (size_t)width * height);
+
+    int32_t j;
+    for (j = 0 ; j < height ; j++)
+    {
+        memcpy(commands->data + data + (j * width),
+               coverage + (j * pitch),
+               width);
+    }
+
+    IMAGE_COMMAND_T *command = addCommand(commands,
+                                          IMAGE_COMMAND_MASK,
+                                          false,
+                                          0,
+                                          rgb);
+
+    command->count = width;
+    command->data = data;
+    command->bounds.x = x;
+    command->bounds.y = y;
+    command->bounds.width = width;
+    command->bounds.height = height;
+}
+
+//-------------------------------------------------------------------------
+
+void
+recordImageCopyRGB(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_T *source,
+    int32_t src_x, int32_t src_y,
+    int32_t src_w, int32_t src_h,
+    int32_t dst_x, int32_t dst_y)
+{
+    IMAGE_COMMAND_T *command = addCommand(commands,
+                                          IMAGE_COMMAND_COPY,
+                                          false,
+                                          0,
+                                          NULL);
+
+    command->source = source;
+    command->x1 = src_x;
+    command->y1 = src_y;
+    command->bounds.x = dst_x;
+    command->bounds.y = dst_y;
+    command->bounds.width = src_w;
+    command->bounds.height = src_h;
+}
+
+//-------------------------------------------------------------------------
+//
+// Drawing one command into the view of a tile whose top left corner is at
+// (x, y) in the image. Only the filled box depends on more than the view:
+// imageBoxFilledRGB() treats a box the full width of the image specially.
+//
+//-------------------------------------------------------------------------
+
+static __thread IMAGE_RASTER_T commandRaster;
+static __thread bool commandRasterInitialised = false;
+
+static void
+drawPolygon(
+    const IMAGE_COMMANDS_T *commands,
+    const IMAGE_COMMAND_T *command,
+    IMAGE_T *view,
+    int32_t x,
+    int32_t y)
+{
+    if (commandRasterInitialised == false)
+    {
+        initImageRaster(&commandRaster);
+        commandRasterInitialised = true;
+    }
+
+    resetImageRaster(&commandRaster);
+
+    const POLYPOINT_T *p =
+        (const POLYPOINT_T *)(commands->data + command->data);
+
+    int32_t i;
+    for (i = 0 ; i < command->count ; i++)
+    {
+        lineToImageRaster(&commandRaster, p[i].x - x, p[i].y - y);
+    }
+
+    if (command->indexed)
+    {
+        fillImageRasterIndexed(&commandRaster,
+                               view,
+                               command->rule,
+                               command->index);
+    }
+    else
+    {
+        fillImageRasterRGB(&commandRaster,
+                           view,
+                           command->rule,
+                           command->antialias,
+                           &(command->rgb));
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+drawCommand(
+    const IMAGE_COMMANDS_T *commands,
+    const IMAGE_COMMAND_T *command,
+    IMAGE_T *view,
+    int32_t x,
+    int32_t y,
+    int32_t imageWidth)
+{
+    int32_t x1 = command->x1 - x;
+    int32_t y1 = command->y1 - y;
+    int32_t x2 = command->x2 - x;
+    int32_t y2 = command->y2 - y;
+
+    switch (command->kind)
+    {
+    case IMAGE_COMMAND_BOX:
+
+        if (command->indexed)
+        {
+            imageBoxIndexed(view, x1, y1, x2, y2, command->index);
+        }
+        else
+        {
+            imageBoxRGB(view, x1, y1, x2, y2, &(command->rgb));
+        }
+
+        break;
+
+    case IMAGE_COMMAND_BOX_FILLED:
+    {
+        IMAGE_PEN_T pen;
+
+        bool valid = (command->indexed)
+                   ? initImagePenIndexed(&pen, view, command->index)
+                   : initImagePenRGB(&pen, view, &(command->rgb));
+
+        if (valid == false)
+        {
+            break;
+        }
+
+        const VC_RECT_T *box = &(command->bounds);
+        int32_t width = (box->width > 1) ? box->width - 1 : 1;
+        int32_t height = box->height;
+
+        if ((box->x == 0) && (box->width - 1 == imageWidth))
+        {
+            --height;
+        }
+
+        imagePenFillRect(&pen, box->x - x, box->y - y, width, height);
+        break;
+    }
+    case IMAGE_COMMAND_LINE:
+
+        if (command->indexed)
+        {
+            imageLineIndexed(view, x1, y1, x2, y2, command->index);
+        }
+        else
+        {
+            imageLineRGB(view, x1, y1, x2, y2, &(command->rgb));
+        }
+
+        break;
+
+    case IMAGE_COMMAND_POLYGON:
+
+        drawPolygon(commands, command, view, x, y);
+        break;
+
+    case IMAGE_COMMAND_STRING:
+    {
+        const char *string = (const char *)(commands->data + command->data);
+
+        if (command->indexed)
+        {
+            drawStringIndexed(x1, y1, string, command->index, view);
+        }
+        else
+        {
+            drawStringRGB(x1, y1, string, &(command->rgb), view);
+        }
+
+        break;
+    }
+    case IMAGE_COMMAND_MASK:
+    {
+        const VC_RECT_T *mask = &(command->bounds);
+        const uint8_t *coverage = commands->data + command->data;
+
+        // Only the rows of the mask that cross the tile.
+
+        int32_t first = (y > mask->y) ? y - mask->y : 0;
+        int32_t last = y + view->height - mask->y;
+
+        if (last > mask->height) last = mask->height;
+
+        int32_t j;
+        for (j = first ; j < last ; j++)
+        {
+            blendSpanRGBA(view,
+                          mask->x - x,
+                          mask->y + j - y,
+                          mask->width,
+                          &(command->rgb),
+                          coverage + (j * command->count));
+        }
+
+        break;
+    }
+    case IMAGE_COMMAND_COPY:
+
+        copyImageRGB(command->source,
+                     view,
+                     command->x1,
+                     command->y1,
+                     command->bounds.width,
+                     command->bounds.height,
+                     command->bounds.x - x,
+                     command->bounds.y - y);
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// Find the tiles that the bounding box of a command overlaps, inside the
+// image's clip rectangle.
+
+static bool
+commandTiles(
+    const IMAGE_COMMAND_T *command,
+    const IMAGE_T *image,
+    int32_t *left,
+    int32_t *top,
+    int32_t *right,
+    int32_t *bottom)
+{
+    VC_RECT_T bounds = command->bounds;
+
+    if (clipImageRect(image, &bounds) == false)
+    {
+        return false;
+    }
+
+    *left = bounds.x / IMAGE_COMMANDS_TILE_SIZE;
+    *top = bounds.y / IMAGE_COMMANDS_TILE_SIZE;
+    *right = (bounds.x + bounds.width - 1) / IMAGE_COMMANDS_TILE_SIZE;
+    *bottom = (bounds.y + bounds.height - 1) / IMAGE_COMMANDS_TILE_SIZE;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    IMAGE_COMMANDS_T *commands;
+    IMAGE_T *image;
+} COMMANDS_JOB_T;
+
+static void
+drawTiles(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    COMMANDS_JOB_T *job = context;
+    IMAGE_COMMANDS_T *commands = job->commands;
+
+    int32_t t;
+    for (t = first ; t < last ; t++)
+    {
+        IMAGE_COMMANDS_TILE_T *tile = &(commands->tiles[t]);
+
+        if (tile->count == 0)
+        {
+            continue;
+        }
+
+        int32_t x = (t % commands->tilesWide) * IMAGE_COMMANDS_TILE_SIZE;
+        int32_t y = (t / commands->tilesWide) * IMAGE_COMMANDS_TILE_SIZE;
+
+        IMAGE_T view;
+
+        if (initImageView(&view,
+                          job->image,
+                          x,
+                          y,
+                          IMAGE_COMMANDS_TILE_SIZE,
+                          IMAGE_COMMANDS_TILE_SIZE) == false)
+        {
+            continue;
+        }
+
+        // Other threads are drawing into the parent, so the view keeps
+        // its dirty areas to itself until all of the tiles are done.
+
+        view.parent = NULL;
+
+        int32_t i;
+        for (i = 0 ; i < tile->count ; i++)
+        {
+            const IMAGE_COMMAND_T *command =
+                &(commands->commands[commands->bins[tile->first + i]]);
+
+            drawCommand(commands, command, &view, x, y, job->image->width);
+        }
+
+        tile->dirty = view.dirty;
+
+        int32_t r;
+        for (r = 0 ; r < tile->dirty.count ; r++)
+        {
+            tile->dirty.rects[r].x += x;
+            tile->dirty.rects[r].y += y;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+executeImageCommands(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_T *image)
+{
+    commands->tilesWide = (image->width + IMAGE_COMMANDS_TILE_SIZE - 1)
+                        / IMAGE_COMMANDS_TILE_SIZE;
+    commands->tilesHigh = (image->height + IMAGE_COMMANDS_TILE_SIZE - 1)
+                        / IMAGE_COMMANDS_TILE_SIZE;
+
+    int32_t tileCount = commands->tilesWide * commands->tilesHigh;
+
+    commands->tiles = growArray(commands->tiles,
+                                &(commands->tileCapacity),
+                                tileCount,
+                                sizeof(IMAGE_COMMANDS_TILE_T));
+
+    memset(commands->tiles, 0, tileCount * sizeof(IMAGE_COMMANDS_TILE_T));
+
+    //---------------------------------------------------------------------
+    // Count the commands in each tile, then place the command numbers in
+    // the bins in the order they were recorded.
+
+    int32_t left, top, right, bottom;
+    int32_t tx, ty;
+    int32_t binCount = 0;
+    size_t bytes = 0;
+
+    int32_t c;
+    for (c = 0 ; c < commands->count ; c++)
+    {
+        if (commandTiles(&(commands->commands[c]),
+                         image,
+                         &left, &top, &right, &bottom))
+        {
+            for (ty = top ; ty <= bottom ; ty++)
+            {
+                for (tx = left ; tx <= right ; tx++)
+                {
+                    ++(commands->tiles[ty * commands->tilesWide + tx].count);
+                }
+            }
+
+            binCount += (right - left + 1) * (bottom - top + 1);
+
+            const VC_RECT_T *bounds = &(commands->commands[c].bounds);
+            bytes += ((size_t)(bounds->width) * bounds->height
+                      * image->bitsPerPixel) / 8;
+        }
+    }
+
+    if (binCount == 0)
+    {
+        return;
+    }
+
+    commands->bins = growArray(commands->bins,
+                               &(commands->binCapacity),
+                               binCount,
+                               sizeof(int32_t));
+
+    int32_t t;
+    int32_t first = 0;
+    for (t = 0 ; t < tileCount ; t++)
+    {
+        commands->tiles[t].first = first;
+        first += commands->tiles[t].count;
+        commands->tiles[t].count = 0;
+    }
+
+    for (c = 0 ; c < commands->count ; c++)
+    {
+        if (commandTiles(&(commands->commands[c]),
+                         image,
+                         &left, &top, &right, &bottom))
+        {
+            for (ty = top ; ty <= bottom ; ty++)
+            {
+                for (tx = left ; tx <= right ; tx++)
+                {
+                    IMAGE_COMMANDS_TILE_T *tile =
+                        &(commands->tiles[ty * commands->tilesWide + tx]);
+
+                    commands->bins[tile->first + tile->count++] = c;
+                }
+            }
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    COMMANDS_JOB_T job = { .commands = commands, .image = image };
+
+    runImageJobRows(drawTiles, &job, tileCount, bytes);
+
+    for (t = 0 ; t < tileCount ; t++)
+    {
+        const IMAGE_DIRTY_T *dirty = &(commands->tiles[t].dirty);
+
+        int32_t r;
+        for (r = 0 ; r < dirty->count ; r++)
+        {
+            markImageDirty(image,
+                           dirty->rects[r].x,
+                           dirty->rects[r].y,
+                           dirty->rects[r].width,
+                           dirty->rects[r].height);
+        }
+    }
+}
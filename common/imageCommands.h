@@ -0,0 +1,255 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_COMMANDS_H
+#define IMAGE_COMMANDS_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+#include "imageGraphics.h"
+#include "imageRaster.h"
+
+//-------------------------------------------------------------------------
+//
+// A command list records drawing operations and plays them back later.
+// Executing the list bins each command into the square tiles of the image
+// that its bounding box overlaps, then draws the tiles with the job pool
+// in imageJobs.c. Each tile is drawn through a view of the image, so a
+// command only touches the pixels of the tile being drawn, tiles can be
+// drawn in any order on any thread, and within a tile the commands are
+// drawn in the order they were recorded.
+//
+// Recording copies everything a command needs (points, text, coverage),
+// except the source image of a copy, which must stay valid until the
+// list is executed and must not share a buffer with the target image.
+// A list can be executed any number of times and reset to record a new
+// frame without freeing its memory.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_COMMANDS_TILE_SIZE 64
+
+typedef enum
+{
+    IMAGE_COMMAND_BOX,
+    IMAGE_COMMAND_BOX_FILLED,
+    IMAGE_COMMAND_LINE,
+    IMAGE_COMMAND_POLYGON,
+    IMAGE_COMMAND_STRING,
+    IMAGE_COMMAND_MASK,
+    IMAGE_COMMAND_COPY
+} IMAGE_COMMAND_KIND_T;
+
+typedef struct
+{
+    IMAGE_COMMAND_KIND_T kind;
+    bool indexed;
+    int8_t index;
+    RGBA8_T rgb;
+    VC_RECT_T bounds;	// every pixel the command can change
+    int32_t x1;		// corners, position or source rectangle
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+    int32_t count;	// points of a polygon, pitch of a mask
+    size_t data;	// offset of points, text or coverage in data
+    IMAGE_FILL_RULE_T rule;
+    bool antialias;
+    IMAGE_T *source;
+} IMAGE_COMMAND_T;
+
+typedef struct
+{
+    int32_t first;	// offset of the tile's command numbers in bins
+    int32_t count;
+    IMAGE_DIRTY_T dirty;	// area changed, in image coordinates
+} IMAGE_COMMANDS_TILE_T;
+
+typedef struct
+{
+    IMAGE_COMMAND_T *commands;
+    int32_t count;
+    int32_t capacity;
+    uint8_t *data;
+    size_t dataSize;
+    size_t dataCapacity;
+    IMAGE_COMMANDS_TILE_T *tiles;	// from the last execution
+    int32_t tilesWide;
+    int32_t tilesHigh;
+    int32_t tileCapacity;
+    int32_t *bins;
+    int32_t binCapacity;
+} IMAGE_COMMANDS_T;
+
+//-------------------------------------------------------------------------
+
+void
+initImageCommands(
+    IMAGE_COMMANDS_T *commands);
+
+void
+resetImageCommands(
+    IMAGE_COMMANDS_T *commands);
+
+void
+destroyImageCommands(
+    IMAGE_COMMANDS_T *commands);
+
+//-------------------------------------------------------------------------
+
+// Each of these records the call of the same name in imageGraphics.h or
+// simple_font.h, and draws the same pixels when executed.
+
+void
+recordImageBoxIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index);
+
+void
+recordImageBoxRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb);
+
+void
+recordImageBoxFilledIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index);
+
+void
+recordImageBoxFilledRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb);
+
+void
+recordImageLineIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int8_t index);
+
+void
+recordImageLineRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const RGBA8_T *rgb);
+
+void
+recordImagePolygonFilledRuleIndexed(
+    IMAGE_COMMANDS_T *commands,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index);
+
+void
+recordImagePolygonFilledRuleRGB(
+    IMAGE_COMMANDS_T *commands,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb);
+
+void
+recordStringIndexed(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    const char *string,
+    int8_t index);
+
+void
+recordStringRGB(
+    IMAGE_COMMANDS_T *commands,
+    int x,
+    int y,
+    const char *string,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// Blend a colour through a coverage mask (one byte a pixel, 0 to 255),
+// such as a rendered glyph.
+
+void
+recordImageMaskRGB(
+    IMAGE_COMMANDS_T *commands,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height,
+    int32_t pitch,
+    const uint8_t *coverage,
+    const RGBA8_T *rgb);
+
+// Record copyImageRGB() from source into the target image.
+
+void
+recordImageCopyRGB(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_T *source,
+    int32_t src_x, int32_t src_y,
+    int32_t src_w, int32_t src_h,
+    int32_t dst_x, int32_t dst_y);
+
+//-------------------------------------------------------------------------
+
+// Draw the commands into image and mark the areas they changed dirty.
+// Afterwards tiles[] holds the area each tile changed.
+
+void
+executeImageCommands(
+    IMAGE_COMMANDS_T *commands,
+    IMAGE_T *image);
+
+//-------------------------------------------------------------------------
+
+#endif
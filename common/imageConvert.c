@@ -0,0 +1,746 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "imageConvert.h"
+#include "imageDither.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONVERT_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#endif
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+#define CONVERT_CHUNK 256
+
+//-------------------------------------------------------------------------
+
+static bool
+isIndexedType(
+    VC_IMAGE_TYPE_T type)
+{
+    return (type == VC_IMAGE_4BPP) || (type == VC_IMAGE_8BPP);
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+isDirectType(
+    VC_IMAGE_TYPE_T type)
+{
+    return (type == VC_IMAGE_RGB565) ||
+           (type == VC_IMAGE_RGB888) ||
+           (type == VC_IMAGE_RGBA16) ||
+           (type == VC_IMAGE_RGBA32);
+}
+
+//-------------------------------------------------------------------------
+
+static int32_t
+bytesPerPixel(
+    VC_IMAGE_TYPE_T type)
+{
+    switch (type)
+    {
+    case VC_IMAGE_8BPP:
+
+        return 1;
+
+    case VC_IMAGE_RGB565:
+    case VC_IMAGE_RGBA16:
+
+        return 2;
+
+    case VC_IMAGE_RGB888:
+
+        return 3;
+
+    case VC_IMAGE_RGBA32:
+
+        return 4;
+
+    default:
+
+        return 0;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static inline uint8_t
+getNibble(
+    const uint8_t *row,
+    int32_t x)
+{
+    return (x & 1) ? (row[x >> 1] & 0x0F) : (row[x >> 1] >> 4);
+}
+
+//-------------------------------------------------------------------------
+
+static inline void
+putNibble(
+    uint8_t *row,
+    int32_t x,
+    uint8_t index)
+{
+    uint8_t *value = row + (x >> 1);
+
+    if (x & 1)
+    {
+        *value = (*value & 0xF0) | (index & 0x0F);
+    }
+    else
+    {
+        *value = (*value & 0x0F) | (index << 4);
+    }
+}
+
+//-------------------------------------------------------------------------
+// Decoders: image type to RGBA32 (red, green, blue, alpha bytes).
+//-------------------------------------------------------------------------
+
+static void
+decodeRGB565(
+    uint8_t *dst,
+    const uint16_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_SSE2)
+    const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+    const __m128i maskF8 = _mm_set1_epi16(0xF8);
+    const __m128i maskFC = _mm_set1_epi16(0xFC);
+    const __m128i mask07 = _mm_set1_epi16(0x07);
+    const __m128i mask03 = _mm_set1_epi16(0x03);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+        __m128i r = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 8), maskF8),
+                                 _mm_srli_epi16(v, 13));
+        __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 3), maskFC),
+                                 _mm_and_si128(_mm_srli_epi16(v, 9), mask03));
+        __m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 3), maskF8),
+                                 _mm_and_si128(_mm_srli_epi16(v, 2), mask07));
+
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        __m128i ba = _mm_or_si128(b, alpha);
+
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+#elif defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(src + i);
+        uint8x8x4_t p;
+
+        p.val[0] = vshrn_n_u16(v, 8);
+        p.val[0] = vsri_n_u8(p.val[0], p.val[0], 5);
+        p.val[1] = vshrn_n_u16(v, 3);
+        p.val[1] = vsri_n_u8(p.val[1], p.val[1], 6);
+        p.val[2] = vmovn_u16(vshlq_n_u16(v, 3));
+        p.val[2] = vsri_n_u8(p.val[2], p.val[2], 5);
+        p.val[3] = vdup_n_u8(255);
+
+        vst4_u8(dst + 4 * i, p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint16_t pixel = src[i];
+
+        uint8_t r5 = (pixel >> 11) & 0x1F;
+        uint8_t g6 = (pixel >> 5) & 0x3F;
+        uint8_t b5 = pixel & 0x1F;
+
+        dst[4 * i] = (r5 << 3) | (r5 >> 2);
+        dst[4 * i + 1] = (g6 << 2) | (g6 >> 4);
+        dst[4 * i + 2] = (b5 << 3) | (b5 >> 2);
+        dst[4 * i + 3] = 255;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+decodeRGBA16(
+    uint8_t *dst,
+    const uint16_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_SSE2)
+    const __m128i maskF0 = _mm_set1_epi16(0xF0);
+    const __m128i mask0F = _mm_set1_epi16(0x0F);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+        __m128i r = _mm_or_si128(_mm_srli_epi16(v, 12),
+                                 _mm_and_si128(_mm_srli_epi16(v, 8), maskF0));
+        __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), maskF0),
+                                 _mm_and_si128(_mm_srli_epi16(v, 8), mask0F));
+        __m128i b = _mm_or_si128(_mm_and_si128(v, maskF0),
+                                 _mm_and_si128(_mm_srli_epi16(v, 4), mask0F));
+        __m128i a = _mm_or_si128(_mm_and_si128(v, mask0F),
+                                 _mm_and_si128(_mm_slli_epi16(v, 4), maskF0));
+
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+#elif defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(src + i);
+        uint8x8x4_t p;
+
+        p.val[0] = vshrn_n_u16(v, 8);
+        p.val[0] = vsri_n_u8(p.val[0], p.val[0], 4);
+        p.val[1] = vshrn_n_u16(v, 4);
+        p.val[1] = vsri_n_u8(p.val[1], p.val[1], 4);
+        p.val[2] = vmovn_u16(v);
+        p.val[2] = vsri_n_u8(p.val[2], p.val[2], 4);
+        p.val[3] = vmovn_u16(vshlq_n_u16(v, 4));
+        p.val[3] = vsri_n_u8(p.val[3], p.val[3], 4);
+
+        vst4_u8(dst + 4 * i, p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint16_t pixel = src[i];
+
+        uint8_t r4 = (pixel >> 12) & 0xF;
+        uint8_t g4 = (pixel >> 8) & 0xF;
+        uint8_t b4 = (pixel >> 4) & 0xF;
+        uint8_t a4 = pixel & 0xF;
+
+        dst[4 * i] = (r4 << 4) | r4;
+        dst[4 * i + 1] = (g4 << 4) | g4;
+        dst[4 * i + 2] = (b4 << 4) | b4;
+        dst[4 * i + 3] = (a4 << 4) | a4;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+decodeRGB888(
+    uint8_t *dst,
+    const uint8_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8x3_t v = vld3_u8(src + 3 * i);
+        uint8x8x4_t p = {{ v.val[0], v.val[1], v.val[2], vdup_n_u8(255) }};
+
+        vst4_u8(dst + 4 * i, p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        dst[4 * i] = src[3 * i];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+decodeIndexed(
+    uint8_t *dst,
+    VC_IMAGE_TYPE_T type,
+    const uint8_t *src,
+    int32_t x,
+    size_t count,
+    const RGBA8_T *palette)
+{
+    size_t i;
+
+    if (type == VC_IMAGE_8BPP)
+    {
+        for (i = 0 ; i < count ; i++)
+        {
+            memcpy(dst + 4 * i, palette + src[x + i], 4);
+        }
+    }
+    else
+    {
+        for (i = 0 ; i < count ; i++)
+        {
+            memcpy(dst + 4 * i, palette + getNibble(src, x + i), 4);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+// Encoders: RGBA32 to image type.
+//-------------------------------------------------------------------------
+
+static void
+encodeRGB565(
+    uint16_t *dst,
+    const uint8_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_SSE2)
+    const __m128i maskR = _mm_set1_epi32(0xF8);
+    const __m128i maskG = _mm_set1_epi32(0x7E0);
+    const __m128i maskB = _mm_set1_epi32(0x1F);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+        __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 4 * i + 16));
+
+        __m128i v0 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p0, maskR), 8),
+                     _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p0, 5), maskG),
+                                  _mm_and_si128(_mm_srli_epi32(p0, 19), maskB)));
+        __m128i v1 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p1, maskR), 8),
+                     _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p1, 5), maskG),
+                                  _mm_and_si128(_mm_srli_epi32(p1, 19), maskB)));
+
+        // sign extend so that the saturating pack keeps all 16 bits
+
+        v0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+        v1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(v0, v1));
+    }
+#elif defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8x4_t p = vld4_u8(src + 4 * i);
+
+        uint16x8_t v = vshll_n_u8(p.val[0], 8);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[1], 8), 5);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[2], 8), 11);
+
+        vst1q_u16(dst + i, v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        const uint8_t *p = src + 4 * i;
+
+        dst[i] = ((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) | (p[2] >> 3);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+encodeRGBA16(
+    uint16_t *dst,
+    const uint8_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_SSE2)
+    const __m128i maskR = _mm_set1_epi32(0xF0);
+    const __m128i maskG = _mm_set1_epi32(0xF00);
+    const __m128i maskB = _mm_set1_epi32(0xF0);
+    const __m128i maskA = _mm_set1_epi32(0xF);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+        __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 4 * i + 16));
+
+        __m128i v0 = _mm_or_si128(
+                        _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p0, maskR), 8),
+                                     _mm_and_si128(_mm_srli_epi32(p0, 4), maskG)),
+                        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p0, 16), maskB),
+                                     _mm_and_si128(_mm_srli_epi32(p0, 28), maskA)));
+        __m128i v1 = _mm_or_si128(
+                        _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p1, maskR), 8),
+                                     _mm_and_si128(_mm_srli_epi32(p1, 4), maskG)),
+                        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p1, 16), maskB),
+                                     _mm_and_si128(_mm_srli_epi32(p1, 28), maskA)));
+
+        v0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+        v1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(v0, v1));
+    }
+#elif defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8x4_t p = vld4_u8(src + 4 * i);
+
+        uint16x8_t v = vshll_n_u8(p.val[0], 8);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[1], 8), 4);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[2], 8), 8);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[3], 8), 12);
+
+        vst1q_u16(dst + i, v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        const uint8_t *p = src + 4 * i;
+
+        dst[i] = ((p[0] >> 4) << 12) |
+                 ((p[1] >> 4) << 8) |
+                 ((p[2] >> 4) << 4) |
+                 (p[3] >> 4);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+encodeRGB888(
+    uint8_t *dst,
+    const uint8_t *src,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(CONVERT_NEON)
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8x4_t p = vld4_u8(src + 4 * i);
+        uint8x8x3_t v = {{ p.val[0], p.val[1], p.val[2] }};
+
+        vst3_u8(dst + 3 * i, v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        dst[3 * i] = src[4 * i];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 2];
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+decodeRow(
+    VC_IMAGE_TYPE_T type,
+    const uint8_t *src,
+    int32_t x,
+    uint8_t *rgba,
+    size_t count,
+    const RGBA8_T *palette)
+{
+    switch (type)
+    {
+    case VC_IMAGE_4BPP:
+    case VC_IMAGE_8BPP:
+
+        decodeIndexed(rgba, type, src, x, count, palette);
+        break;
+
+    case VC_IMAGE_RGB565:
+
+        decodeRGB565(rgba, (const uint16_t *)src + x, count);
+        break;
+
+    case VC_IMAGE_RGB888:
+
+        decodeRGB888(rgba, src + 3 * x, count);
+        break;
+
+    case VC_IMAGE_RGBA16:
+
+        decodeRGBA16(rgba, (const uint16_t *)src + x, count);
+        break;
+
+    case VC_IMAGE_RGBA32:
+
+        memcpy(rgba, src + 4 * x, 4 * count);
+        break;
+
+    default:
+
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+encodeRow(
+    VC_IMAGE_TYPE_T type,
+    const uint8_t *rgba,
+    uint8_t *dst,
+    int32_t x,
+    size_t count)
+{
+    switch (type)
+    {
+    case VC_IMAGE_RGB565:
+
+        encodeRGB565((uint16_t *)dst + x, rgba, count);
+        break;
+
+    case VC_IMAGE_RGB888:
+
+        encodeRGB888(dst + 3 * x, rgba, count);
+        break;
+
+    case VC_IMAGE_RGBA16:
+
+        encodeRGBA16((uint16_t *)dst + x, rgba, count);
+        break;
+
+    case VC_IMAGE_RGBA32:
+
+        memcpy(dst + 4 * x, rgba, 4 * count);
+        break;
+
+    default:
+
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+copyIndexedRow(
+    VC_IMAGE_TYPE_T srcType,
+    const uint8_t *src,
+    int32_t srcX,
+    VC_IMAGE_TYPE_T dstType,
+    uint8_t *dst,
+    int32_t dstX,
+    int32_t count)
+{
+    int32_t i;
+
+    if ((srcType == VC_IMAGE_8BPP) && (dstType == VC_IMAGE_8BPP))
+    {
+        memmove(dst + dstX, src + srcX, count);
+    }
+    else if ((srcType == VC_IMAGE_8BPP) && (dstType == VC_IMAGE_4BPP))
+    {
+        for (i = 0 ; i < count ; i++)
+        {
+            putNibble(dst, dstX + i, src[srcX + i]);
+        }
+    }
+    else if (dstType == VC_IMAGE_8BPP)
+    {
+        for (i = 0 ; i < count ; i++)
+        {
+            dst[dstX + i] = getNibble(src, srcX + i);
+        }
+    }
+    else if (((srcX & 1) == 0) && ((dstX & 1) == 0))
+    {
+        uint8_t last = getNibble(src, srcX + count - 1);
+
+        memmove(dst + (dstX >> 1), src + (srcX >> 1), count >> 1);
+
+        if (count & 1)
+        {
+            putNibble(dst, dstX + count - 1, last);
+        }
+    }
+    else if ((src == dst) && (dstX > srcX))
+    {
+        for (i = count - 1 ; i >= 0 ; i--)
+        {
+            putNibble(dst, dstX + i, getNibble(src, srcX + i));
+        }
+    }
+    else
+    {
+        for (i = 0 ; i < count ; i++)
+        {
+            putNibble(dst, dstX + i, getNibble(src, srcX + i));
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+bool
+canConvertImageType(
+    VC_IMAGE_TYPE_T srcType,
+    VC_IMAGE_TYPE_T dstType,
+    bool havePalette)
+{
+    if (isIndexedType(srcType))
+    {
+        return isIndexedType(dstType) ||
+               (isDirectType(dstType) && havePalette);
+    }
+
+    return isDirectType(srcType) && isDirectType(dstType);
+}
+
+//-------------------------------------------------------------------------
+
+bool
+convertImageRow(
+    VC_IMAGE_TYPE_T srcType,
+    const void *src,
+    int32_t srcX,
+    VC_IMAGE_TYPE_T dstType,
+    void *dst,
+    int32_t dstX,
+    int32_t count,
+    const RGBA8_T *palette)
+{
+    if (canConvertImageType(srcType, dstType, palette != NULL) == false)
+    {
+        return false;
+    }
+
+    if (count <= 0)
+    {
+        return true;
+    }
+
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+
+    if (isIndexedType(dstType))
+    {
+        copyIndexedRow(srcType, s, srcX, dstType, d, dstX, count);
+    }
+    else if (srcType == dstType)
+    {
+        int32_t bpp = bytesPerPixel(srcType);
+        memmove(d + bpp * dstX, s + bpp * srcX, bpp * count);
+    }
+    else if (srcType == VC_IMAGE_RGBA32)
+    {
+        encodeRow(dstType, s + 4 * srcX, d, dstX, count);
+    }
+    else if (dstType == VC_IMAGE_RGBA32)
+    {
+        decodeRow(srcType, s, srcX, d + 4 * dstX, count, palette);
+    }
+    else
+    {
+        uint8_t rgba[4 * CONVERT_CHUNK];
+
+        while (count > 0)
+        {
+            int32_t chunk = (count < CONVERT_CHUNK) ? count : CONVERT_CHUNK;
+
+            decodeRow(srcType, s, srcX, rgba, chunk, palette);
+            encodeRow(dstType, rgba, d, dstX, chunk);
+
+            srcX += chunk;
+            dstX += chunk;
+            count -= chunk;
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+convertImageRowDithered(
+    VC_IMAGE_TYPE_T srcType,
+    const void *src,
+    int32_t srcX,
+    VC_IMAGE_TYPE_T dstType,
+    void *dst,
+    int32_t dstX,
+    int32_t dstY,
+    int32_t count,
+    const RGBA8_T *palette)
+{
+    const uint8_t *thresholds = ditherThresholdRow(dstType, dstY);
+
+    if ((thresholds == NULL) ||
+        (srcType == dstType) ||
+        (canConvertImageType(srcType, dstType, palette != NULL) == false))
+    {
+        return convertImageRow(srcType, src, srcX,
+                               dstType, dst, dstX,
+                               count, palette);
+    }
+
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+    uint8_t rgba[4 * CONVERT_CHUNK];
+
+    while (count > 0)
+    {
+        int32_t chunk = (count < CONVERT_CHUNK) ? count : CONVERT_CHUNK;
+
+        if (srcType == VC_IMAGE_RGBA32)
+        {
+            ditherSpanRGBA(rgba, s + 4 * srcX, thresholds, dstX, chunk);
+        }
+        else
+        {
+            decodeRow(srcType, s, srcX, rgba, chunk, palette);
+            ditherSpanRGBA(rgba, rgba, thresholds, dstX, chunk);
+        }
+
+        encodeRow(dstType, rgba, d, dstX, chunk);
+
+        srcX += chunk;
+        dstX += chunk;
+        count -= chunk;
+    }
+
+    return true;
+}
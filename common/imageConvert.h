@@ -0,0 +1,91 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_CONVERT_H
+#define IMAGE_CONVERT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bcm_host.h"
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// Row converters translate a run of pixels from one image type to
+// another. Every direct colour type has a decoder to RGBA32 and an encoder
+// from RGBA32, so any pair is converted in at most two passes over a small
+// RGBA32 buffer that stays in the L1 cache. The 16 bit decoders and
+// encoders have NEON and SSE2 versions.
+//
+// src and dst point to the start of a row. srcX and dstX are pixel
+// offsets into those rows, which is needed for 4BPP where two pixels
+// share a byte. Indexed sources need a palette (16 or 256 entries) to be
+// converted to direct colour. Conversion to an indexed type is only
+// possible from another indexed type. Encoding truncates each channel in
+// the same way as setPixelRGB() without dithering.
+//
+//-------------------------------------------------------------------------
+
+bool
+canConvertImageType(
+    VC_IMAGE_TYPE_T srcType,
+    VC_IMAGE_TYPE_T dstType,
+    bool havePalette);
+
+bool
+convertImageRow(
+    VC_IMAGE_TYPE_T srcType,
+    const void *src,
+    int32_t srcX,
+    VC_IMAGE_TYPE_T dstType,
+    void *dst,
+    int32_t dstX,
+    int32_t count,
+    const RGBA8_T *palette);
+
+// As convertImageRow(), but RGB565 and RGBA16 destinations are ordered
+// dithered (see imageDither.h). dstY selects the row of the dither matrix.
+
+bool
+convertImageRowDithered(
+    VC_IMAGE_TYPE_T srcType,
+    const void *src,
+    int32_t srcX,
+    VC_IMAGE_TYPE_T dstType,
+    void *dst,
+    int32_t dstX,
+    int32_t dstY,
+    int32_t count,
+    const RGBA8_T *palette);
+
+//-------------------------------------------------------------------------
+
+#endif
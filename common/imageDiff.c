@@ -0,0 +1,217 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "imageDiff.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DIFF_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DIFF_SSE2
+#endif
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+#define DIFF_CHUNK 64
+
+//-------------------------------------------------------------------------
+
+static bool
+chunkDiffers(
+    const uint8_t *a,
+    const uint8_t *b)
+{
+#if defined(DIFF_NEON)
+
+    uint8x16_t same = vandq_u8(
+        vandq_u8(vceqq_u8(vld1q_u8(a), vld1q_u8(b)),
+                 vceqq_u8(vld1q_u8(a + 16), vld1q_u8(b + 16))),
+        vandq_u8(vceqq_u8(vld1q_u8(a + 32), vld1q_u8(b + 32)),
+                 vceqq_u8(vld1q_u8(a + 48), vld1q_u8(b + 48))));
+
+    uint64x2_t same64 = vreinterpretq_u64_u8(same);
+
+    return (vgetq_lane_u64(same64, 0) & vgetq_lane_u64(same64, 1)) != ~0ULL;
+
+#elif defined(DIFF_SSE2)
+
+    const __m128i *pa = (const __m128i *)a;
+    const __m128i *pb = (const __m128i *)b;
+
+    __m128i same = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(pa), _mm_loadu_si128(pb)),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(pa + 1), _mm_loadu_si128(pb + 1))),
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(pa + 2), _mm_loadu_si128(pb + 2)),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(pa + 3), _mm_loadu_si128(pb + 3))));
+
+    return _mm_movemask_epi8(same) != 0xFFFF;
+
+#else
+
+    return memcmp(a, b, DIFF_CHUNK) != 0;
+
+#endif
+}
+
+//-------------------------------------------------------------------------
+//
+// Finds the first and last bytes that differ in a row of length bytes.
+// Whole chunks are skipped from each end, then the chunk that differs is
+// searched a byte at a time.
+//
+//-------------------------------------------------------------------------
+
+static bool
+rowDiffers(
+    const uint8_t *a,
+    const uint8_t *b,
+    int32_t length,
+    int32_t *first,
+    int32_t *last)
+{
+    int32_t start = 0;
+
+    while ((start + DIFF_CHUNK <= length) &&
+           (chunkDiffers(a + start, b + start) == false))
+    {
+        start += DIFF_CHUNK;
+    }
+
+    while ((start < length) && (a[start] == b[start]))
+    {
+        start++;
+    }
+
+    if (start == length)
+    {
+        return false;
+    }
+
+    int32_t end = length;
+
+    while ((end - DIFF_CHUNK >= start) &&
+           (chunkDiffers(a + end - DIFF_CHUNK, b + end - DIFF_CHUNK) == false))
+    {
+        end -= DIFF_CHUNK;
+    }
+
+    while (a[end - 1] == b[end - 1])
+    {
+        end--;
+    }
+
+    *first = start;
+    *last = end - 1;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+diffImage(
+    const IMAGE_T *image,
+    const IMAGE_T *reference,
+    IMAGE_DIRTY_T *changes)
+{
+    changes->count = 0;
+
+    if ((image->type != reference->type) ||
+        (image->width != reference->width) ||
+        (image->height != reference->height))
+    {
+        return false;
+    }
+
+    int32_t bits = image->bitsPerPixel;
+    int32_t length = ((image->width * bits) + 7) / 8;
+
+    int32_t y;
+    for (y = 0 ; y < image->height ; y++)
+    {
+        const uint8_t *a = (uint8_t *)(image->buffer) + (y * image->pitch);
+        const uint8_t *b = (uint8_t *)(reference->buffer) + (y * reference->pitch);
+        int32_t first;
+        int32_t last;
+
+        if (rowDiffers(a, b, length, &first, &last))
+        {
+            int32_t x1 = (first * 8) / bits;
+            int32_t x2 = (((last + 1) * 8) + bits - 1) / bits;
+
+            if (x2 > image->width)
+            {
+                x2 = image->width;
+            }
+
+            addImageDirtyRect(changes, x1, y, x2 - x1, 1);
+        }
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+markImageChanges(
+    IMAGE_T *image,
+    IMAGE_T *snapshot)
+{
+    IMAGE_DIRTY_T changes;
+
+    if (diffImage(image, snapshot, &changes) == false)
+    {
+        return false;
+    }
+
+    clearImageDirty(image);
+
+    int32_t i;
+    for (i = 0 ; i < changes.count ; i++)
+    {
+        const VC_RECT_T *rect = &(changes.rects[i]);
+
+        markImageDirty(image, rect->x, rect->y, rect->width, rect->height);
+        copyImageRGB(image,
+                     snapshot,
+                     rect->x, rect->y,
+                     rect->width, rect->height,
+                     rect->x, rect->y);
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_DIFF_H
+#define IMAGE_DIFF_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// Finds the areas where two images of the same type and size differ.
+// Each row is compared 64 bytes at a time (NEON or SSE2) to find the
+// first and last byte that changed. The changed part of each row is
+// then merged into an IMAGE_DIRTY_T in the same way as markImageDirty(),
+// so the result is at most IMAGE_DIRTY_RECTS rectangles.
+//
+//-------------------------------------------------------------------------
+
+// Returns false if the images can't be compared. changes is empty if
+// the images are the same.
+
+bool
+diffImage(
+    const IMAGE_T *image,
+    const IMAGE_T *reference,
+    IMAGE_DIRTY_T *changes);
+
+// Replaces the dirty list of image with the areas that differ from
+// snapshot, then copies those areas into snapshot. After a frame is
+// redrawn from scratch only the pixels that really changed are uploaded.
+
+bool
+markImageChanges(
+    IMAGE_T *image,
+    IMAGE_T *snapshot);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,426 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "imageConvert.h"
+#include "imageDither.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DITHER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DITHER_SSE2
+#endif
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+//
+// Red and blue use the 8 level matrix and green the 4 level matrix for
+// RGB565. All four channels use the 16 level matrix for RGBA16.
+//
+//-------------------------------------------------------------------------
+
+static const uint8_t thresholdsRGB565[8][64] =
+{
+    {
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+    },
+    {
+         4,  2,  4,  0,  2,  1,  2,  0,  5,  3,  5,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  3,  1,  3,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  2,  1,  2,  0,  5,  3,  5,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  3,  1,  3,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+    },
+    {
+         1,  1,  1,  0,  7,  3,  7,  0,  1,  1,  1,  0,  6,  3,  6,  0,
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  7,  3,  7,  0,  1,  1,  1,  0,  6,  3,  6,  0,
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  7,  3,  7,  0,
+    },
+    {
+         5,  2,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  1,  3,  0,
+         5,  3,  5,  0,  4,  2,  4,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+         5,  2,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  1,  3,  0,
+         5,  3,  5,  0,  4,  2,  4,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+    },
+    {
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+         1,  1,  1,  0,  6,  3,  6,  0,  2,  1,  2,  0,  7,  3,  7,  0,
+    },
+    {
+         4,  2,  4,  0,  3,  1,  3,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  2,  1,  2,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  3,  1,  3,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+         4,  2,  4,  0,  2,  1,  2,  0,  6,  3,  6,  0,  4,  2,  4,  0,
+    },
+    {
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  7,  3,  7,  0,
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  6,  3,  6,  0,
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  7,  3,  7,  0,
+         2,  1,  2,  0,  7,  3,  7,  0,  1,  1,  1,  0,  6,  3,  6,  0,
+    },
+    {
+         5,  3,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+         5,  2,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+         5,  3,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+         5,  2,  5,  0,  3,  2,  3,  0,  5,  2,  5,  0,  3,  2,  3,  0,
+    },
+};
+
+static const uint8_t thresholdsRGBA16[8][64] =
+{
+    {
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 13, 13, 13, 13,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 13, 13, 13, 13,  4,  4,  4,  4, 15, 15, 15, 15,
+    },
+    {
+         8,  8,  8,  8,  4,  4,  4,  4, 11, 11, 11, 11,  7,  7,  7,  7,
+         9,  9,  9,  9,  5,  5,  5,  5, 12, 12, 12, 12,  8,  8,  8,  8,
+         8,  8,  8,  8,  4,  4,  4,  4, 11, 11, 11, 11,  7,  7,  7,  7,
+         9,  9,  9,  9,  5,  5,  5,  5, 12, 12, 12, 12,  8,  8,  8,  8,
+    },
+    {
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+         3,  3,  3,  3, 15, 15, 15, 15,  2,  2,  2,  2, 14, 14, 14, 14,
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+         3,  3,  3,  3, 15, 15, 15, 15,  2,  2,  2,  2, 14, 14, 14, 14,
+    },
+    {
+        10, 10, 10, 10,  6,  6,  6,  6,  9,  9,  9,  9,  5,  5,  5,  5,
+        11, 11, 11, 11,  7,  7,  7,  7, 10, 10, 10, 10,  6,  6,  6,  6,
+        10, 10, 10, 10,  6,  6,  6,  6,  9,  9,  9,  9,  5,  5,  5,  5,
+        11, 11, 11, 11,  7,  7,  7,  7, 10, 10, 10, 10,  6,  6,  6,  6,
+    },
+    {
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+         1,  1,  1,  1, 12, 12, 12, 12,  4,  4,  4,  4, 15, 15, 15, 15,
+    },
+    {
+         9,  9,  9,  9,  5,  5,  5,  5, 12, 12, 12, 12,  8,  8,  8,  8,
+         8,  8,  8,  8,  5,  5,  5,  5, 11, 11, 11, 11,  8,  8,  8,  8,
+         9,  9,  9,  9,  5,  5,  5,  5, 12, 12, 12, 12,  8,  8,  8,  8,
+         8,  8,  8,  8,  5,  5,  5,  5, 11, 11, 11, 11,  8,  8,  8,  8,
+    },
+    {
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+         3,  3,  3,  3, 14, 14, 14, 14,  2,  2,  2,  2, 13, 13, 13, 13,
+    },
+    {
+        11, 11, 11, 11,  7,  7,  7,  7, 10, 10, 10, 10,  6,  6,  6,  6,
+        10, 10, 10, 10,  7,  7,  7,  7,  9,  9,  9,  9,  6,  6,  6,  6,
+        11, 11, 11, 11,  7,  7,  7,  7, 10, 10, 10, 10,  6,  6,  6,  6,
+        10, 10, 10, 10,  7,  7,  7,  7,  9,  9,  9,  9,  6,  6,  6,  6,
+    },
+};
+
+//-------------------------------------------------------------------------
+
+const uint8_t *
+ditherThresholdRow(
+    VC_IMAGE_TYPE_T type,
+    int32_t y)
+{
+    switch (type)
+    {
+    case VC_IMAGE_RGB565:
+
+        return thresholdsRGB565[y & 7];
+
+    case VC_IMAGE_RGBA16:
+
+        return thresholdsRGBA16[y & 7];
+
+    default:
+
+        return NULL;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+ditherSpanRGBA(
+    uint8_t *dst,
+    const uint8_t *src,
+    const uint8_t *thresholds,
+    int32_t x,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(DITHER_SSE2)
+    for ( ; i + 4 <= count ; i += 4)
+    {
+        __m128i t = _mm_loadu_si128((const __m128i *)(thresholds + 4 * ((x + i) & 7)));
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_adds_epu8(v, t));
+    }
+#elif defined(DITHER_NEON)
+    for ( ; i + 4 <= count ; i += 4)
+    {
+        uint8x16_t t = vld1q_u8(thresholds + 4 * ((x + i) & 7));
+        uint8x16_t v = vld1q_u8(src + 4 * i);
+
+        vst1q_u8(dst + 4 * i, vqaddq_u8(v, t));
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        const uint8_t *t = thresholds + 4 * ((x + i) & 7);
+        int c;
+
+        for (c = 0 ; c < 4 ; c++)
+        {
+            int16_t v = src[4 * i + c] + t[c];
+            dst[4 * i + c] = (v > 255) ? 255 : v;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+ditherPattern16(
+    VC_IMAGE_TYPE_T type,
+    const RGBA8_T *rgba,
+    int32_t x,
+    int32_t y,
+    uint16_t *pattern,
+    int32_t count)
+{
+    uint8_t colour[32];
+
+    if (count > 8) count = 8;
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        memcpy(colour + 4 * i, rgba, 4);
+    }
+
+    ditherSpanRGBA(colour, colour, ditherThresholdRow(type, y), x, count);
+    convertImageRow(VC_IMAGE_RGBA32, colour, 0, type, pattern, 0, count, NULL);
+}
+
+//-------------------------------------------------------------------------
+//
+// Floyd-Steinberg error diffusion. Errors are kept in sixteenths for the
+// current and the next row, with one pixel of padding at each end.
+//
+//-------------------------------------------------------------------------
+
+static uint8_t
+quantizeChannel(
+    int16_t value,
+    int bits)
+{
+    int16_t levels = (1 << bits) - 1;
+    int16_t q = (value * levels + 127) / 255;
+
+    switch (bits)
+    {
+    case 4:
+
+        return q * 17;
+
+    case 5:
+
+        return (q << 3) | (q >> 2);
+
+    case 6:
+
+        return (q << 2) | (q >> 4);
+
+    default:
+
+        return value;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+ditherFloydSteinberg(
+    const IMAGE_T *src,
+    IMAGE_T *dst,
+    int32_t width,
+    int32_t height)
+{
+    static const int bitsRGB565[4] = { 5, 6, 5, 8 };
+    static const int bitsRGBA16[4] = { 4, 4, 4, 4 };
+
+    const int *bits = (dst->type == VC_IMAGE_RGB565) ? bitsRGB565 : bitsRGBA16;
+
+    int32_t rowLength = (width + 2) * 4;
+    int16_t *errors = calloc(2 * rowLength, sizeof(int16_t));
+    uint8_t *rgba = malloc(width * 4);
+
+    if ((errors == NULL) || (rgba == NULL))
+    {
+        fprintf(stderr, "imageDither: memory exhausted\n");
+        free(errors);
+        free(rgba);
+        return false;
+    }
+
+    int16_t *current = errors;
+    int16_t *next = errors + rowLength;
+
+    int32_t y;
+    for (y = 0 ; y < height ; y++)
+    {
+        convertImageRow(src->type,
+                        (uint8_t *)(src->buffer) + (y * src->pitch),
+                        0,
+                        VC_IMAGE_RGBA32,
+                        rgba,
+                        0,
+                        width,
+                        NULL);
+
+        memset(next, 0, rowLength * sizeof(int16_t));
+
+        int32_t x;
+        for (x = 0 ; x < width ; x++)
+        {
+            int c;
+            for (c = 0 ; c < 4 ; c++)
+            {
+                int32_t i = (x + 1) * 4 + c;
+                int16_t value = rgba[4 * x + c] + (current[i] / 16);
+
+                if (value < 0) value = 0;
+                if (value > 255) value = 255;
+
+                uint8_t q = quantizeChannel(value, bits[c]);
+                int16_t error = value - q;
+
+                current[i + 4] += error * 7;
+                next[i - 4] += error * 3;
+                next[i] += error * 5;
+                next[i + 4] += error;
+
+                rgba[4 * x + c] = q;
+            }
+        }
+
+        convertImageRow(VC_IMAGE_RGBA32,
+                        rgba,
+                        0,
+                        dst->type,
+                        (uint8_t *)(dst->buffer) + (y * dst->pitch),
+                        0,
+                        width,
+                        NULL);
+
+        int16_t *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    free(errors);
+    free(rgba);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+ditherImage(
+    const IMAGE_T *src,
+    IMAGE_T *dst,
+    IMAGE_DITHER_T mode)
+{
+    if (canConvertImageType(src->type, dst->type, false) == false)
+    {
+        return false;
+    }
+
+    int32_t width = (src->width < dst->width) ? src->width : dst->width;
+    int32_t height = (src->height < dst->height) ? src->height : dst->height;
+
+    bool result = true;
+
+    if ((mode == IMAGE_DITHER_FLOYD_STEINBERG) &&
+        (ditherThresholdRow(dst->type, 0) != NULL))
+    {
+        result = ditherFloydSteinberg(src, dst, width, height);
+    }
+    else
+    {
+        int32_t y;
+        for (y = 0 ; y < height ; y++)
+        {
+            const uint8_t *srcRow = (uint8_t *)(src->buffer) + (y * src->pitch);
+            uint8_t *dstRow = (uint8_t *)(dst->buffer) + (y * dst->pitch);
+
+            if (mode == IMAGE_DITHER_NONE)
+            {
+                convertImageRow(src->type, srcRow, 0,
+                                dst->type, dstRow, 0,
+                                width, NULL);
+            }
+            else
+            {
+                // Dither relative to the owning row, so that a view
+                // matches the pattern of its parent.
+
+                convertImageRowDithered(src->type, srcRow, 0,
+                                        dst->type,
+                                        dstRow - (dst->xOrigin * dst->bitsPerPixel / 8),
+                                        dst->xOrigin,
+                                        y + dst->yOrigin,
+                                        width, NULL);
+            }
+        }
+    }
+
+    markImageDirty(dst, 0, 0, width, height);
+
+    return result;
+}
@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_DITHER_H
+#define IMAGE_DITHER_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bcm_host.h"
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+
+typedef enum
+{
+    IMAGE_DITHER_NONE,
+    IMAGE_DITHER_ORDERED,
+    IMAGE_DITHER_FLOYD_STEINBERG
+} IMAGE_DITHER_T;
+
+//-------------------------------------------------------------------------
+//
+// Ordered dithering adds an 8x8 threshold matrix to each pixel before it
+// is truncated to RGB565 or RGBA16. The thresholds for a row are kept as
+// 16 RGBA32 pixels (the 8 pixel pattern twice), so the thresholds for
+// any four consecutive pixels starting at x are the 16 bytes at
+// row + 4 * (x & 7).
+//
+//-------------------------------------------------------------------------
+
+const uint8_t *
+ditherThresholdRow(
+    VC_IMAGE_TYPE_T type,
+    int32_t y);
+
+// dst = src + thresholds on RGBA32 pixels, saturating at 255. dst and src
+// may be the same. x is the image column of the first pixel.
+
+void
+ditherSpanRGBA(
+    uint8_t *dst,
+    const uint8_t *src,
+    const uint8_t *thresholds,
+    int32_t x,
+    size_t count);
+
+// The dithered values of a solid colour for count (up to 8) pixels
+// starting at (x, y), as RGB565 or RGBA16.
+
+void
+ditherPattern16(
+    VC_IMAGE_TYPE_T type,
+    const RGBA8_T *rgba,
+    int32_t x,
+    int32_t y,
+    uint16_t *pattern,
+    int32_t count);
+
+//-------------------------------------------------------------------------
+
+// Copy src into dst, converting to the type of dst. The images are
+// aligned at the top left and the copy is clipped to the smaller of the
+// two. Floyd-Steinberg error diffusion is intended for offline asset
+// conversion; it has no effect on RGB888 or RGBA32 destinations.
+
+bool
+ditherImage(
+    const IMAGE_T *src,
+    IMAGE_T *dst,
+    IMAGE_DITHER_T mode);
+
+//-------------------------------------------------------------------------
+
+#endif
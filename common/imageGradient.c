@@ -0,0 +1,607 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "imageConvert.h"
+#include "imageGradient.h"
+#include "imageJobs.h"
+#include "imageSpan.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+// Spans of other image types are made as RGBA32 in pieces of this many
+// pixels and converted, so the piece stays in the L1 cache.
+
+#define GRADIENT_CHUNK 128
+
+//-------------------------------------------------------------------------
+
+static void
+rgbaChannels(
+    const RGBA8_T *rgb,
+    double channels[4])
+{
+    channels[0] = rgb->red;
+    channels[1] = rgb->green;
+    channels[2] = rgb->blue;
+    channels[3] = rgb->alpha;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+initGradient(
+    IMAGE_GRADIENT_T *gradient,
+    IMAGE_GRADIENT_KIND_T kind)
+{
+    memset(gradient, 0, sizeof(*gradient));
+    gradient->kind = kind;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+setGradientPoint(
+    IMAGE_GRADIENT_T *gradient,
+    int32_t i,
+    float x,
+    float y,
+    const RGBA8_T *rgb)
+{
+    gradient->points[i].x = x;
+    gradient->points[i].y = y;
+    gradient->points[i].rgb = *rgb;
+}
+
+//-------------------------------------------------------------------------
+
+void
+initImageGradientLinear(
+    IMAGE_GRADIENT_T *gradient,
+    float x1,
+    float y1,
+    const RGBA8_T *rgb1,
+    float x2,
+    float y2,
+    const RGBA8_T *rgb2)
+{
+    initGradient(gradient, IMAGE_GRADIENT_LINEAR);
+    setGradientPoint(gradient, 0, x1, y1, rgb1);
+    setGradientPoint(gradient, 1, x2, y2, rgb2);
+
+    // t is 0 at (x1, y1) and 1 at (x2, y2). If they are the same point
+    // the whole gradient is rgb1.
+
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    double length2 = (dx * dx) + (dy * dy);
+
+    if (length2 > 0.0)
+    {
+        gradient->dtdx = dx / length2;
+        gradient->dtdy = dy / length2;
+        gradient->t = -((x1 * dx) + (y1 * dy)) / length2;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+initImageGradientRadial(
+    IMAGE_GRADIENT_T *gradient,
+    float xc,
+    float yc,
+    float radius,
+    const RGBA8_T *inner,
+    const RGBA8_T *outer)
+{
+    initGradient(gradient, IMAGE_GRADIENT_RADIAL);
+    setGradientPoint(gradient, 0, xc, yc, inner);
+    setGradientPoint(gradient, 1, xc + radius, yc, outer);
+    gradient->radius = radius;
+
+    double from[4];
+    double to[4];
+
+    rgbaChannels(inner, from);
+    rgbaChannels(outer, to);
+
+    int32_t i;
+    for (i = 0 ; i < IMAGE_GRADIENT_RAMP_SIZE ; i++)
+    {
+        double t = (double)i / (IMAGE_GRADIENT_RAMP_SIZE - 1);
+        uint8_t *rgba = (uint8_t *)&(gradient->ramp[i]);
+
+        int32_t c;
+        for (c = 0 ; c < 4 ; c++)
+        {
+            rgba[c] = (uint8_t)(from[c] + ((to[c] - from[c]) * t) + 0.5);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+initImageGradientTriangle(
+    IMAGE_GRADIENT_T *gradient,
+    float x1,
+    float y1,
+    const RGBA8_T *rgb1,
+    float x2,
+    float y2,
+    const RGBA8_T *rgb2,
+    float x3,
+    float y3,
+    const RGBA8_T *rgb3)
+{
+    initGradient(gradient, IMAGE_GRADIENT_TRIANGLE);
+    setGradientPoint(gradient, 0, x1, y1, rgb1);
+    setGradientPoint(gradient, 1, x2, y2, rgb2);
+    setGradientPoint(gradient, 2, x3, y3, rgb3);
+
+    // Each channel is a plane through the three vertices. If they are in
+    // a line the whole gradient is rgb1.
+
+    double c1[4];
+    double c2[4];
+    double c3[4];
+
+    rgbaChannels(rgb1, c1);
+    rgbaChannels(rgb2, c2);
+    rgbaChannels(rgb3, c3);
+
+    double area = ((double)(x2 - x1) * (y3 - y1))
+                - ((double)(x3 - x1) * (y2 - y1));
+
+    int32_t c;
+    for (c = 0 ; c < 4 ; c++)
+    {
+        if (area != 0.0)
+        {
+            gradient->dcdx[c] = (((c2[c] - c1[c]) * (y3 - y1))
+                              - ((c3[c] - c1[c]) * (y2 - y1))) / area;
+            gradient->dcdy[c] = (((c3[c] - c1[c]) * (x2 - x1))
+                              - ((c2[c] - c1[c]) * (x3 - x1))) / area;
+        }
+
+        gradient->colour[c] = c1[c]
+                            - (gradient->dcdx[c] * x1)
+                            - (gradient->dcdy[c] * y1);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+fillRGBA(
+    uint8_t *dst,
+    const RGBA8_T *rgb,
+    int32_t count)
+{
+    uint32_t value;
+    memcpy(&value, rgb, sizeof(value));
+
+    spanFill32((uint32_t *)dst, value, count);
+}
+
+//-------------------------------------------------------------------------
+
+// A linear gradient is split into the pixels before the start, those
+// between the ends, which are stepped, and those after the end.
+
+static void
+linearRow(
+    const IMAGE_GRADIENT_T *gradient,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    uint8_t *dst)
+{
+    const RGBA8_T *rgb1 = &(gradient->points[0].rgb);
+    const RGBA8_T *rgb2 = &(gradient->points[1].rgb);
+
+    double dt = gradient->dtdx;
+    double t = gradient->t
+             + (dt * (x + 0.5))
+             + (gradient->dtdy * (y + 0.5));
+
+    const RGBA8_T *before = (dt < 0.0) ? rgb2 : rgb1;
+    const RGBA8_T *after = (dt < 0.0) ? rgb1 : rgb2;
+
+    int32_t first = 0;
+    int32_t end = count;
+
+    if (dt != 0.0)
+    {
+        double lo = -t / dt;
+        double hi = (1.0 - t) / dt;
+
+        if (dt < 0.0)
+        {
+            double swap = lo;
+            lo = hi;
+            hi = swap;
+        }
+
+        lo = ceil(lo);
+        hi = floor(hi) + 1.0;
+
+        first = (lo < 0.0) ? 0 : (lo > count) ? count : (int32_t)lo;
+        end = (hi < first) ? first : (hi > count) ? count : (int32_t)hi;
+    }
+
+    if (first > 0)
+    {
+        fillRGBA(dst, before, first);
+    }
+
+    if (end > first)
+    {
+        double from[4];
+        double to[4];
+
+        rgbaChannels(rgb1, from);
+        rgbaChannels(rgb2, to);
+
+        double tFirst = t + (dt * first);
+        if (tFirst < 0.0) tFirst = 0.0;
+        if (tFirst > 1.0) tFirst = 1.0;
+
+        int32_t colour[4];
+        int32_t step[4];
+
+        int32_t c;
+        for (c = 0 ; c < 4 ; c++)
+        {
+            double range = to[c] - from[c];
+
+            colour[c] = (int32_t)((from[c] + (range * tFirst) + 0.5) * 65536.0);
+            step[c] = (int32_t)lrint(range * dt * 65536.0);
+        }
+
+        spanGradientRGBA32(dst + (4 * first), colour, step, end - first);
+    }
+
+    if (count > end)
+    {
+        fillRGBA(dst + (4 * end), after, count - end);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+radialRow(
+    const IMAGE_GRADIENT_T *gradient,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    uint8_t *dst)
+{
+    uint32_t *rgba = (uint32_t *)dst;
+
+    if (gradient->radius <= 0.0f)
+    {
+        spanFill32(rgba, gradient->ramp[IMAGE_GRADIENT_RAMP_SIZE - 1], count);
+        return;
+    }
+
+    float scale = (IMAGE_GRADIENT_RAMP_SIZE - 1) / gradient->radius;
+    float dx = (x + 0.5f - gradient->points[0].x) * scale;
+    float dy = (y + 0.5f - gradient->points[0].y) * scale;
+    float dy2 = dy * dy;
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        float d = sqrtf((dx * dx) + dy2) + 0.5f;
+        int32_t index = (d < IMAGE_GRADIENT_RAMP_SIZE - 1)
+                      ? (int32_t)d
+                      : IMAGE_GRADIENT_RAMP_SIZE - 1;
+
+        rgba[i] = gradient->ramp[index];
+        dx += scale;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+triangleRow(
+    const IMAGE_GRADIENT_T *gradient,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    uint8_t *dst)
+{
+    double start[4];
+    int32_t colour[4];
+    int32_t step[4];
+    bool stepped = true;
+
+    int32_t c;
+    for (c = 0 ; c < 4 ; c++)
+    {
+        start[c] = gradient->colour[c]
+                 + (gradient->dcdx[c] * (x + 0.5))
+                 + (gradient->dcdy[c] * (y + 0.5));
+
+        // Far outside the triangle the 16.16 values could overflow; those
+        // spans are clamped one pixel at a time instead.
+
+        double end = start[c] + (gradient->dcdx[c] * count);
+
+        if ((fabs(start[c]) > 16384.0) || (fabs(end) > 16384.0))
+        {
+            stepped = false;
+        }
+
+        colour[c] = (int32_t)floor((start[c] + 0.5) * 65536.0);
+        step[c] = (int32_t)lrint(gradient->dcdx[c] * 65536.0);
+    }
+
+    if (stepped)
+    {
+        spanGradientRGBA32(dst, colour, step, count);
+        return;
+    }
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        for (c = 0 ; c < 4 ; c++)
+        {
+            double value = floor(start[c] + (gradient->dcdx[c] * i) + 0.5);
+            dst[(4 * i) + c] = (value < 0.0) ? 0 : (value > 255.0) ? 255 : value;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+gradientRow(
+    const IMAGE_GRADIENT_T *gradient,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    uint8_t *dst)
+{
+    switch (gradient->kind)
+    {
+    case IMAGE_GRADIENT_LINEAR:
+
+        linearRow(gradient, x, y, count, dst);
+        break;
+
+    case IMAGE_GRADIENT_RADIAL:
+
+        radialRow(gradient, x, y, count, dst);
+        break;
+
+    case IMAGE_GRADIENT_TRIANGLE:
+
+        triangleRow(gradient, x, y, count, dst);
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageGradientSpan(
+    const IMAGE_GRADIENT_T *gradient,
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t count)
+{
+    uint8_t *row = (uint8_t *)(image->buffer) + (y * image->pitch);
+
+    if (image->type == VC_IMAGE_RGBA32)
+    {
+        gradientRow(gradient, x, y, count, row + (4 * x));
+        return;
+    }
+
+    bool dithered = isImageDithered(image);
+    uint32_t rgba[GRADIENT_CHUNK];
+
+    while (count > 0)
+    {
+        int32_t n = (count < GRADIENT_CHUNK) ? count : GRADIENT_CHUNK;
+
+        gradientRow(gradient, x, y, n, (uint8_t *)rgba);
+
+        if (dithered)
+        {
+            // Relative to the start of the owning row, as copyImageRGB()
+            // does, so that views keep the dither phase of the parent.
+
+            convertImageRowDithered(VC_IMAGE_RGBA32, rgba, 0,
+                                    image->type,
+                                    row - (image->xOrigin * image->bitsPerPixel / 8),
+                                    x + image->xOrigin,
+                                    y + image->yOrigin,
+                                    n, NULL);
+        }
+        else
+        {
+            convertImageRow(VC_IMAGE_RGBA32, rgba, 0,
+                            image->type, row, x, n, NULL);
+        }
+
+        x += n;
+        count -= n;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+canFillGradient(
+    const IMAGE_T *image)
+{
+    return canConvertImageType(VC_IMAGE_RGBA32, image->type, false);
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const IMAGE_GRADIENT_T *gradient;
+    IMAGE_T *image;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+} GRADIENT_JOB_T;
+
+static void
+gradientRows(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    GRADIENT_JOB_T *job = context;
+
+    int32_t j;
+    for (j = first ; j < last ; j++)
+    {
+        imageGradientSpan(job->gradient, job->image,
+                          job->x, job->y + j, job->width);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageBoxGradientRGB(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height,
+    const IMAGE_GRADIENT_T *gradient)
+{
+    VC_RECT_T box = { .x = x, .y = y, .width = width, .height = height };
+
+    if ((canFillGradient(image) == false) ||
+        (clipImageRect(image, &box) == false))
+    {
+        return;
+    }
+
+    GRADIENT_JOB_T job = { gradient, image, box.x, box.y, box.width };
+    size_t bytes = ((size_t)(image->pitch) * box.height * box.width)
+                 / image->width;
+
+    runImageJobRows(gradientRows, &job, box.height, bytes);
+
+    markImageDirty(image, box.x, box.y, box.width, box.height);
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const IMAGE_GRADIENT_T *gradient;
+    IMAGE_T *image;
+} GRADIENT_FILL_T;
+
+static void
+gradientSpan(
+    void *context,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    const uint8_t *coverage)
+{
+    GRADIENT_FILL_T *fill = context;
+
+    imageGradientSpan(fill->gradient, fill->image, x, y, count);
+}
+
+//-------------------------------------------------------------------------
+
+void
+fillImageRasterGradient(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    const IMAGE_GRADIENT_T *gradient)
+{
+    if (canFillGradient(image) == false)
+    {
+        return;
+    }
+
+    GRADIENT_FILL_T fill = { gradient, image };
+    VC_RECT_T clip = image->clip;
+
+    closeImageRaster(raster);
+    markImageRasterDirty(raster, image);
+    renderImageRaster(raster, &clip, rule, false, gradientSpan, &fill);
+}
+
+//-------------------------------------------------------------------------
+
+// The raster is kept for each thread so that its buffers are reused.
+
+static __thread IMAGE_RASTER_T triangleRaster;
+static __thread bool triangleRasterInitialised = false;
+
+void
+imageTriangleGradientRGB(
+    IMAGE_T *image,
+    const IMAGE_GRADIENT_T *gradient)
+{
+    if (triangleRasterInitialised == false)
+    {
+        initImageRaster(&triangleRaster);
+        triangleRasterInitialised = true;
+    }
+
+    const IMAGE_GRADIENT_POINT_T *points = gradient->points;
+
+    resetImageRaster(&triangleRaster);
+    moveToImageRaster(&triangleRaster, points[0].x, points[0].y);
+    lineToImageRaster(&triangleRaster, points[1].x, points[1].y);
+    lineToImageRaster(&triangleRaster, points[2].x, points[2].y);
+
+    fillImageRasterGradient(&triangleRaster,
+                            image,
+                            IMAGE_FILL_NON_ZERO,
+                            gradient);
+}
@@ -0,0 +1,166 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_GRADIENT_H
+#define IMAGE_GRADIENT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+#include "imageRaster.h"
+
+//-------------------------------------------------------------------------
+//
+// Gradient fills for direct colour images. A gradient gives a colour for
+// every pixel centre:
+//
+//   linear   - the colour changes from rgb1 at (x1, y1) to rgb2 at
+//              (x2, y2), and is constant along lines at right angles to
+//              that; pixels beyond either end take the colour of that end.
+//   radial   - the colour changes from inner at the centre to outer at
+//              radius, and is outer beyond it.
+//   triangle - the colour is interpolated between the colours of three
+//              vertices (Gouraud shading), and extrapolated outside them.
+//
+// Linear and triangle gradients are affine along a row, so each span is
+// written by stepping the colour in 16.16 fixed point with the vector
+// span kernel. Radial gradients look up a ramp of 256 colours. The colour
+// is written with its alpha, as setPixelRGB() does, not blended.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_GRADIENT_RAMP_SIZE 256
+
+typedef enum
+{
+    IMAGE_GRADIENT_LINEAR,
+    IMAGE_GRADIENT_RADIAL,
+    IMAGE_GRADIENT_TRIANGLE
+} IMAGE_GRADIENT_KIND_T;
+
+typedef struct
+{
+    float x;
+    float y;
+    RGBA8_T rgb;
+} IMAGE_GRADIENT_POINT_T;
+
+typedef struct
+{
+    IMAGE_GRADIENT_KIND_T kind;
+    IMAGE_GRADIENT_POINT_T points[3];
+    float radius;
+    double t;		// linear: position along the gradient at (0, 0)
+    double dtdx;
+    double dtdy;
+    double colour[4];	// triangle: colour at (0, 0)
+    double dcdx[4];
+    double dcdy[4];
+    uint32_t ramp[IMAGE_GRADIENT_RAMP_SIZE];	// radial: RGBA32 colours
+} IMAGE_GRADIENT_T;
+
+//-------------------------------------------------------------------------
+
+void
+initImageGradientLinear(
+    IMAGE_GRADIENT_T *gradient,
+    float x1,
+    float y1,
+    const RGBA8_T *rgb1,
+    float x2,
+    float y2,
+    const RGBA8_T *rgb2);
+
+void
+initImageGradientRadial(
+    IMAGE_GRADIENT_T *gradient,
+    float xc,
+    float yc,
+    float radius,
+    const RGBA8_T *inner,
+    const RGBA8_T *outer);
+
+void
+initImageGradientTriangle(
+    IMAGE_GRADIENT_T *gradient,
+    float x1,
+    float y1,
+    const RGBA8_T *rgb1,
+    float x2,
+    float y2,
+    const RGBA8_T *rgb2,
+    float x3,
+    float y3,
+    const RGBA8_T *rgb3);
+
+//-------------------------------------------------------------------------
+
+// Write count pixels of a row of the image with the gradient. Like
+// imagePenSpanUnclipped(), this neither clips nor marks the span dirty.
+
+void
+imageGradientSpan(
+    const IMAGE_GRADIENT_T *gradient,
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t count);
+
+// Fill a rectangle with the gradient. The rows are shared out to the job
+// pool.
+
+void
+imageBoxGradientRGB(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height,
+    const IMAGE_GRADIENT_T *gradient);
+
+// Fill the triangle of a triangle gradient with it.
+
+void
+imageTriangleGradientRGB(
+    IMAGE_T *image,
+    const IMAGE_GRADIENT_T *gradient);
+
+// Fill any shape with a gradient. The edges are not antialiased.
+
+void
+fillImageRasterGradient(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    const IMAGE_GRADIENT_T *gradient);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -26,11 +26,14 @@
 //-------------------------------------------------------------------------
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
 #include "image.h"
 #include "imageGraphics.h"
+#include "imagePen.h"
+#include "imageRaster.h"
 
 #ifdef DMALLOC
 #include "dmalloc.h"
@@ -57,10 +60,15 @@ imageBoxIndexed(
     int32_t y2,
     int8_t index)
 {
-    imageVerticalLineIndexed(image, x1, y1, y2, index);
-    imageHorizontalLineIndexed(image, x1, x2, y1, index);
-    imageVerticalLineIndexed(image, x2, y1, y2, index);
-    imageHorizontalLineIndexed(image, x1, x2, y2, index);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenIndexed(&pen, image, index))
+    {
+        imagePenLine(&pen, x1, y1, x1, y2);
+        imagePenSpan(&pen, (x1 < x2) ? x1 : x2, y1, abs(x2 - x1));
+        imagePenLine(&pen, x2, y1, x2, y2);
+        imagePenSpan(&pen, (x1 < x2) ? x1 : x2, y2, abs(x2 - x1));
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -74,10 +82,15 @@ imageBoxRGB(
     int32_t y2,
     const RGBA8_T *rgb)
 {
-    imageVerticalLineRGB(image, x1, y1, y2, rgb);
-    imageHorizontalLineRGB(image, x1, x2, y1, rgb);
-    imageVerticalLineRGB(image, x2, y1, y2, rgb);
-    imageHorizontalLineRGB(image, x1, x2, y2, rgb);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenRGB(&pen, image, rgb))
+    {
+        imagePenLine(&pen, x1, y1, x1, y2);
+        imagePenSpan(&pen, (x1 < x2) ? x1 : x2, y1, abs(x2 - x1));
+        imagePenLine(&pen, x2, y1, x2, y2);
+        imagePenSpan(&pen, (x1 < x2) ? x1 : x2, y2, abs(x2 - x1));
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -102,15 +115,18 @@ imageBoxFilledIndexed(
 	x2 = x1;
     }
 
-    if (x == 0 && x2 == image->width) {
-	setPixelIndexed(image, x, y, (y2-y) * image->width, index);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenIndexed(&pen, image, index) == false) {
 	return;
     }
 
-    while (y <= y2) {
-        imageHorizontalLineIndexed(image, x, x2, y, index);
-        y++;
+    if (x == 0 && x2 == image->width) {
+	imagePenFillRect(&pen, 0, y, image->width, y2 - y);
+	return;
     }
+
+    imagePenFillRect(&pen, x, y, (x2 > x) ? (x2 - x) : 1, y2 - y + 1);
 }
 
 //-------------------------------------------------------------------------
@@ -135,15 +151,18 @@ imageBoxFilledRGB(
 	x2 = x1;
     }
 
-    if (x == 0 && x2 == image->width) {
-	setPixelRGB(image, x, y, (y2-y) * image->width, rgb);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenRGB(&pen, image, rgb) == false) {
 	return;
     }
 
-    while (y <= y2) {
-        imageHorizontalLineRGB(image, x, x2, y, rgb);
-        y++;
+    if (x == 0 && x2 == image->width) {
+	imagePenFillRect(&pen, 0, y, image->width, y2 - y);
+	return;
     }
+
+    imagePenFillRect(&pen, x, y, (x2 > x) ? (x2 - x) : 1, y2 - y + 1);
 }
 
 //-------------------------------------------------------------------------
@@ -167,62 +186,11 @@ imageLineIndexed(
     }
     else
     {
-        int32_t dx = abs(x2 - x1);
-        int32_t dy = abs(y2 - y1);
+        IMAGE_PEN_T pen;
 
-        int32_t sign_x = (x1 <= x2) ? 1 : -1;
-        int32_t sign_y = (y1 <= y2) ? 1 : -1;
-
-        int32_t x = x1;
-        int32_t y = y1;
-
-        setPixelIndexed(image, x, y, 1, index);
-
-        if (dx > dy)
-        {
-            int32_t d = 2 * dy - dx;
-            int32_t incrE = 2 * dy;
-            int32_t incrNE = 2 * (dy - dx);
-
-            while (x != x2)
-            {
-                x += sign_x;
-
-                if (d <= 0)
-                {
-                    d += incrE;
-                }
-                else
-                {
-                    d += incrNE;
-                    y += sign_y;
-                }
-
-                setPixelIndexed(image, x, y, 1, index);
-            }
-        }
-        else
+        if (initImagePenIndexed(&pen, image, index))
         {
-            int32_t d = 2 * dx - dy;
-            int32_t incrN = 2 * dx;
-            int32_t incrNE = 2 * (dx - dy);
-
-            while (y != y2)
-            {
-                y += sign_y;
-
-                if (d <= 0)
-                {
-                    d += incrN;
-                }
-                else
-                {
-                    d += incrNE;
-                    x += sign_x;
-                }
-
-                setPixelIndexed(image, x, y, 1, index);
-            }
+            imagePenLine(&pen, x1, y1, x2, y2);
         }
     }
 }
@@ -248,62 +216,11 @@ imageLineRGB(
     }
     else
     {
-        int32_t dx = abs(x2 - x1);
-        int32_t dy = abs(y2 - y1);
-
-        int32_t sign_x = (x1 <= x2) ? 1 : -1;
-        int32_t sign_y = (y1 <= y2) ? 1 : -1;
-
-        int32_t x = x1;
-        int32_t y = y1;
-
-        setPixelRGB(image, x, y, 1, rgb);
-
-        if (dx > dy)
-        {
-            int32_t d = 2 * dy - dx;
-            int32_t incrE = 2 * dy;
-            int32_t incrNE = 2 * (dy - dx);
+        IMAGE_PEN_T pen;
 
-            while (x != x2)
-            {
-                x += sign_x;
-
-                if (d <= 0)
-                {
-                    d += incrE;
-                }
-                else
-                {
-                    d += incrNE;
-                    y += sign_y;
-                }
-
-                setPixelRGB(image, x, y, 1, rgb);
-            }
-        }
-        else
+        if (initImagePenRGB(&pen, image, rgb))
         {
-            int32_t d = 2 * dx - dy;
-            int32_t incrN = 2 * dx;
-            int32_t incrNE = 2 * (dx - dy);
-
-            while (y != y2)
-            {
-                y += sign_y;
-
-                if (d <= 0)
-                {
-                    d += incrN;
-                }
-                else
-                {
-                    d += incrNE;
-                    x += sign_x;
-                }
-
-                setPixelRGB(image, x, y, 1, rgb);
-            }
+            imagePenLine(&pen, x1, y1, x2, y2);
         }
     }
 }
@@ -324,7 +241,11 @@ imageHorizontalLineIndexed(
 	x2 = x1;
     }
 
-    setPixelIndexed(image, x, y, (x2 - x), index);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenIndexed(&pen, image, index)) {
+	imagePenSpan(&pen, x, y, (x2 > x) ? (x2 - x) : 1);
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -343,7 +264,11 @@ imageHorizontalLineRGB(
 	x2 = x1;
     }
 
-    setPixelRGB(image, x, y, (x2 - x), rgb);
+    IMAGE_PEN_T pen;
+
+    if (initImagePenRGB(&pen, image, rgb)) {
+	imagePenSpan(&pen, x, y, (x2 > x) ? (x2 - x) : 1);
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -356,15 +281,11 @@ imageVerticalLineIndexed(
     int32_t y2,
     int8_t index)
 {
-    int32_t sign_y = (y1 <= y2) ? 1 : -1;
-    int32_t y = y1;
-
-    setPixelIndexed(image, x, y, 1, index);
+    IMAGE_PEN_T pen;
 
-    while (y != y2)
+    if (initImagePenIndexed(&pen, image, index))
     {
-        y += sign_y;
-        setPixelIndexed(image, x, y, 1, index);
+        imagePenLine(&pen, x, y1, x, y2);
     }
 }
 
@@ -378,16 +299,41 @@ imageVerticalLineRGB(
     int32_t y2,
     const RGBA8_T *rgb)
 {
-    int32_t sign_y = (y1 <= y2) ? 1 : -1;
-    int32_t y = y1;
+    IMAGE_PEN_T pen;
+
+    if (initImagePenRGB(&pen, image, rgb))
+    {
+        imagePenLine(&pen, x, y1, x, y2);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// Polygons are filled by the scanline rasterizer in imageRaster.c. The
+// raster is kept for each thread so that its buffers are reused.
+
+static __thread IMAGE_RASTER_T polygonRaster;
+static __thread bool polygonRasterInitialised = false;
+
+static IMAGE_RASTER_T *
+polygonToRaster(
+    const POLYGON_T *poly)
+{
+    if (polygonRasterInitialised == false)
+    {
+        initImageRaster(&polygonRaster);
+        polygonRasterInitialised = true;
+    }
 
-    setPixelRGB(image, x, y, 1, rgb);
+    resetImageRaster(&polygonRaster);
 
-    while (y != y2)
+    int32_t i;
+    for (i = 0 ; i < poly->points ; i++)
     {
-        y += sign_y;
-        setPixelRGB(image, x, y, 1, rgb);
+        lineToImageRaster(&polygonRaster, poly->p[i].x, poly->p[i].y);
     }
+
+    return &polygonRaster;
 }
 
 //-------------------------------------------------------------------------
@@ -398,7 +344,7 @@ imagePolygonFilledIndexed(
     POLYGON_T *poly,
     int8_t index)
 {
-
+    imagePolygonFilledRuleIndexed(image, poly, IMAGE_FILL_EVEN_ODD, index);
 }
 
 //-------------------------------------------------------------------------
@@ -409,69 +355,1490 @@ imagePolygonFilledRGB(
     POLYGON_T *poly,
     const RGBA8_T *rgb)
 {
-    int  min_y =  9999999;
-    int  max_y = -9999999;
-    int  nodes, pixelY, i, j;
-    double nodeX[200];
-
-    for (i=0; i < poly->points; i++) {
-	if (poly->p[i].y > max_y) max_y = poly->p[i].y;
-	if (poly->p[i].y < min_y) min_y = poly->p[i].y;
-    }
-
-    //  Loop through the rows of the image.
-    for (pixelY=min_y; pixelY < max_y; pixelY++) {
-	double line_y = pixelY;
-	//  Build a list of nodes.
-	nodes = 0;
-	j = poly->points - 1;
-	for (i=0; i < poly->points; i++) {
-	    double px1 = poly->p[i].x;
-	    double py1 = poly->p[i].y;
-	    double px2 = poly->p[j].x;
-	    double py2 = poly->p[j].y;
-	    if ((py1 < line_y && py2 >= line_y) || (py2 < line_y && py1 >= line_y)) {
-		    nodeX[nodes++]= (px1 + (line_y - py1) / (py2 - py1) * (px2 - px1) );
-		    //printf( "line %d  %g \n", pixelY, nodeX[nodes - 1] );
-	    }
-	    j = i;
-	}
+    imagePolygonFilledRuleRGB(image, poly, IMAGE_FILL_EVEN_ODD, false, rgb);
+}
 
-	//  Sort the nodes, via a simple “Bubble” sort.
-	i = 0;
-	while (i < (nodes - 1)) {
-	    if (nodeX[i] > nodeX[i+1]) {
-		double swap = nodeX[i];
-		nodeX[i] = nodeX[i+1];
-		nodeX[i+1] = swap;
-		if (i) i--;
-	    } else {
-		i++;
-	    }
-	}
+//-------------------------------------------------------------------------
 
-	//  Fill the pixels between node pairs.
-	//   3.2	6.6
-	//   .8 4------6 .6
-	for (i=0; i < nodes; i+= 2) {
-	    RGBA8_T fp = *rgb;
-	    fp.alpha = (1.0 - (nodeX[i] - floor(nodeX[i]))) * 255.0;
-	    int32_t x0 = floor(nodeX[i]);
-	    int32_t x1 = ceil(nodeX[i]);
-
-	    RGBA8_T lp = *rgb;
-	    lp.alpha =  ((nodeX[i+1] - floor(nodeX[i+1]))) * 255.0;
-	    int32_t x2 = ceil(nodeX[i+1]);
-	    int32_t x9 = x2 + 1;
-
-	//    printf( "draw line YY %d   %g %g     x0 %d = %d  x1 %d -- x2 %d  x9 %d = %d\n",
-	//	pixelY, nodeX[i], nodeX[i+1], x0, fp.alpha, x1, x2, x9, lp.alpha );
-	    setPixelRGBA( image, x0, pixelY, 1, &fp );
-	    setPixelRGBA( image, x9, pixelY, 1, &lp );
-	    //setPixelRGBA( image, x0 + 10, pixelY, 1, rgb ); //&fp );
-	    //setPixelRGBA( image, x9 + 10, pixelY, 1, rgb ); //&lp );
-	    imageHorizontalLineRGB( image, x1, x2, pixelY, rgb );
-	}
+void
+imagePolygonFilledRuleIndexed(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index)
+{
+    fillImageRasterIndexed(polygonToRaster(poly), image, rule, index);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePolygonFilledRuleRGB(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb)
+{
+    fillImageRasterRGB(polygonToRaster(poly), image, rule, antialias, rgb);
+}
+
+//-------------------------------------------------------------------------
+//
+// Wide lines are outlined by strokeImageRaster() and filled with the
+// non-zero rule. Integer points are moved to the centre of their pixel.
+//
+//-------------------------------------------------------------------------
+
+static __thread IMAGE_RASTER_POINT_T *strokePoints = NULL;
+static __thread int32_t strokePointsCapacity = 0;
+
+static IMAGE_RASTER_T *
+strokeToRaster(
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    bool closed,
+    const IMAGE_STROKE_T *stroke)
+{
+    if (polygonRasterInitialised == false)
+    {
+        initImageRaster(&polygonRaster);
+        polygonRasterInitialised = true;
+    }
+
+    resetImageRaster(&polygonRaster);
+    strokeImageRaster(&polygonRaster, points, count, closed, stroke);
+
+    return &polygonRaster;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+growStrokePoints(
+    int32_t count)
+{
+    if (count > strokePointsCapacity)
+    {
+        IMAGE_RASTER_POINT_T *points =
+            realloc(strokePoints, count * sizeof(IMAGE_RASTER_POINT_T));
+
+        if (points == NULL)
+        {
+            fprintf(stderr, "imageGraphics: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+
+        strokePoints = points;
+        strokePointsCapacity = count;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_RASTER_T *
+polylineToRaster(
+    const POLYGON_T *poly,
+    bool closed,
+    const IMAGE_STROKE_T *stroke)
+{
+    growStrokePoints(poly->points);
+
+    int32_t i;
+    for (i = 0 ; i < poly->points ; i++)
+    {
+        strokePoints[i].x = poly->p[i].x + 0.5f;
+        strokePoints[i].y = poly->p[i].y + 0.5f;
+    }
+
+    return strokeToRaster(strokePoints, poly->points, closed, stroke);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageLineWideIndexed(
+    IMAGE_T *image,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index)
+{
+    IMAGE_RASTER_POINT_T points[2] =
+    {
+        { x1 + 0.5f, y1 + 0.5f },
+        { x2 + 0.5f, y2 + 0.5f }
+    };
+
+    fillImageRasterIndexed(strokeToRaster(points, 2, false, stroke),
+                           image,
+                           IMAGE_FILL_NON_ZERO,
+                           index);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageLineWideRGB(
+    IMAGE_T *image,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb)
+{
+    IMAGE_RASTER_POINT_T points[2] =
+    {
+        { x1 + 0.5f, y1 + 0.5f },
+        { x2 + 0.5f, y2 + 0.5f }
+    };
+
+    fillImageRasterRGB(strokeToRaster(points, 2, false, stroke),
+                       image,
+                       IMAGE_FILL_NON_ZERO,
+                       true,
+                       rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePolylineIndexed(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index)
+{
+    fillImageRasterIndexed(polylineToRaster(poly, closed, stroke),
+                           image,
+                           IMAGE_FILL_NON_ZERO,
+                           index);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePolylineRGB(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb)
+{
+    fillImageRasterRGB(polylineToRaster(poly, closed, stroke),
+                       image,
+                       IMAGE_FILL_NON_ZERO,
+                       true,
+                       rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageStrokeRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb)
+{
+    fillImageRasterRGB(strokeToRaster(points, count, closed, stroke),
+                       image,
+                       IMAGE_FILL_NON_ZERO,
+                       true,
+                       rgb);
+}
+
+//-------------------------------------------------------------------------
+//
+// Bezier paths are flattened into lines, see imageBezierSegments(). A
+// stroke is drawn through the ends of the lines; a fill adds them to the
+// raster as a contour.
+//
+//-------------------------------------------------------------------------
+
+static IMAGE_RASTER_T *
+bezierToRaster(
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    bool closed,
+    const IMAGE_STROKE_T *stroke)
+{
+    int32_t curves = (count - 1) / degree;
+    int32_t total = 1;
+
+    int32_t i;
+    for (i = 0 ; i < curves ; i++)
+    {
+        total += imageBezierSegments(points + (i * degree),
+                                     degree,
+                                     IMAGE_RASTER_TOLERANCE);
+    }
+
+    growStrokePoints(total);
+
+    strokePoints[0] = points[0];
+    total = 1;
+
+    for (i = 0 ; i < curves ; i++)
+    {
+        const IMAGE_RASTER_POINT_T *curve = points + (i * degree);
+        int32_t segments = imageBezierSegments(curve,
+                                               degree,
+                                               IMAGE_RASTER_TOLERANCE);
+
+        flattenImageBezier(curve, degree, segments, strokePoints + total);
+        total += segments;
+    }
+
+    return strokeToRaster(strokePoints, total, closed, stroke);
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_RASTER_T *
+bezierFilledToRaster(
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree)
+{
+    if (polygonRasterInitialised == false)
+    {
+        initImageRaster(&polygonRaster);
+        polygonRasterInitialised = true;
+    }
+
+    resetImageRaster(&polygonRaster);
+
+    if (count > 0)
+    {
+        moveToImageRaster(&polygonRaster, points[0].x, points[0].y);
+    }
+
+    int32_t i;
+    for (i = 1 ; i + degree <= count ; i += degree)
+    {
+        const IMAGE_RASTER_POINT_T *p = points + i;
+
+        switch (degree)
+        {
+        case 2:
+
+            quadToImageRaster(&polygonRaster, p[0].x, p[0].y, p[1].x, p[1].y);
+            break;
+
+        case 3:
+
+            cubicToImageRaster(&polygonRaster,
+                               p[0].x, p[0].y,
+                               p[1].x, p[1].y,
+                               p[2].x, p[2].y);
+            break;
+
+        default:
+
+            lineToImageRaster(&polygonRaster, p[0].x, p[0].y);
+            break;
+        }
+    }
+
+    return &polygonRaster;
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageBezierIndexed(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index)
+{
+    if ((count < 1) || (degree < 1) || (degree > 3))
+    {
+        return;
+    }
+
+    fillImageRasterIndexed(bezierToRaster(points, count, degree, closed, stroke),
+                           image,
+                           IMAGE_FILL_NON_ZERO,
+                           index);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageBezierRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb)
+{
+    if ((count < 1) || (degree < 1) || (degree > 3))
+    {
+        return;
+    }
+
+    fillImageRasterRGB(bezierToRaster(points, count, degree, closed, stroke),
+                       image,
+                       IMAGE_FILL_NON_ZERO,
+                       true,
+                       rgb);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageBezierFilledIndexed(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index)
+{
+    if ((degree < 1) || (degree > 3))
+    {
+        return;
+    }
+
+    fillImageRasterIndexed(bezierFilledToRaster(points, count, degree),
+                           image,
+                           rule,
+                           index);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageBezierFilledRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb)
+{
+    if ((degree < 1) || (degree > 3))
+    {
+        return;
+    }
+
+    fillImageRasterRGB(bezierFilledToRaster(points, count, degree),
+                       image,
+                       rule,
+                       antialias,
+                       rgb);
+}
+
+//-------------------------------------------------------------------------
+//
+// Circles, ellipses, arcs and sectors are drawn as horizontal spans.
+// A pixel at offset (x, y) from the centre is inside an ellipse with
+// semi-axes a and b if it is inside the ellipse with semi-axes a + 1/2
+// and b + 1/2, which in integers is
+//
+//     (2x)^2 (2b + 1)^2 + (2y)^2 (2a + 1)^2 <= (2a + 1)^2 (2b + 1)^2
+//
+// so a circle of radius r is 2r + 1 pixels across. The extent of each
+// row is found from this test, outlines are the pixels between the
+// extent of a row and the row outside it, and annuli are the pixels
+// between the extents of two ellipses.
+//
+// Arcs and sectors are limited to a wedge of angles, measured in radians
+// from the positive x axis towards positive y (clockwise on the screen).
+// The wedge is the half-open range [start, end), tested exactly with
+// integer cross products, so sectors that share an edge neither overlap
+// nor leave a gap.
+//
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int32_t a;
+    int32_t b;
+    int64_t aa;		// (2a + 1)^2
+    int64_t bb;		// (2b + 1)^2
+} ELLIPSE_T;
+
+typedef struct
+{
+    bool full;
+    bool empty;
+    bool convex;	// otherwise the directions are of the gap
+    int64_t x0;		// start and end directions in 1.20 fixed point
+    int64_t y0;
+    int64_t x1;
+    int64_t y1;
+} WEDGE_T;
+
+typedef struct
+{
+    IMAGE_PEN_T pen;
+    int32_t xc;
+    int32_t yc;
+} ELLIPSE_SPANS_T;
+
+//-------------------------------------------------------------------------
+
+static void
+initEllipse(
+    ELLIPSE_T *ellipse,
+    int32_t a,
+    int32_t b)
+{
+    ellipse->a = a;
+    ellipse->b = b;
+    ellipse->aa = (2 * (int64_t)a + 1) * (2 * (int64_t)a + 1);
+    ellipse->bb = (2 * (int64_t)b + 1) * (2 * (int64_t)b + 1);
+}
+
+//-------------------------------------------------------------------------
+
+static inline bool
+insideEllipse(
+    const ELLIPSE_T *ellipse,
+    int64_t x,
+    int64_t y)
+{
+    return (4 * x * x * ellipse->bb) + (4 * y * y * ellipse->aa)
+           <= (ellipse->aa * ellipse->bb);
+}
+
+//-------------------------------------------------------------------------
+
+// The largest x inside the ellipse on row y, or -1.
+
+static int32_t
+ellipseExtent(
+    const ELLIPSE_T *ellipse,
+    int32_t y)
+{
+    if ((ellipse->a < 0) || (abs(y) > ellipse->b))
+    {
+        return -1;
+    }
+
+    double t = (double)y / (ellipse->b + 0.5);
+    int32_t x = (int32_t)((ellipse->a + 0.5) * sqrt(fmax(0.0, 1.0 - t * t)));
+
+    while ((x >= 0) && (insideEllipse(ellipse, x, y) == false))
+    {
+        --x;
+    }
+
+    while ((x < ellipse->a) && insideEllipse(ellipse, x + 1, y))
+    {
+        ++x;
+    }
+
+    return x;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+initWedge(
+    WEDGE_T *wedge,
+    float start,
+    float end)
+{
+    float sweep = fmodf(end - start, 2.0f * M_PI);
+
+    if (sweep < 0.0f)
+    {
+        sweep += 2.0f * M_PI;
+    }
+
+    wedge->full = (end - start >= 2.0f * M_PI);
+    wedge->empty = (sweep == 0.0f) && (wedge->full == false);
+    wedge->convex = (sweep < M_PI);
+
+    if (wedge->convex == false)
+    {
+        float swap = start;
+        start = end;
+        end = swap;
+    }
+
+    wedge->x0 = llround(cos(start) * (1 << 20));
+    wedge->y0 = llround(sin(start) * (1 << 20));
+    wedge->x1 = llround(cos(end) * (1 << 20));
+    wedge->y1 = llround(sin(end) * (1 << 20));
+}
+
+//-------------------------------------------------------------------------
+
+static inline int64_t
+floorDivide(
+    int64_t n,
+    int64_t d)
+{
+    int64_t q = n / d;
+
+    return ((n % d != 0) && ((n < 0) != (d < 0))) ? q - 1 : q;
+}
+
+//-------------------------------------------------------------------------
+
+// Limit [*lo, *hi] to the x where A x + B >= 0, or > 0 if strict.
+
+static void
+clipHalfPlane(
+    int64_t A,
+    int64_t B,
+    bool strict,
+    int64_t *lo,
+    int64_t *hi)
+{
+    if (A > 0)
+    {
+        int64_t x = (strict) ? floorDivide(-B, A) + 1 : -floorDivide(B, A);
+        if (x > *lo) *lo = x;
+    }
+    else if (A < 0)
+    {
+        int64_t x = (strict) ? -floorDivide(-B, -A) - 1 : floorDivide(B, -A);
+        if (x < *hi) *hi = x;
+    }
+    else if ((B < 0) || (strict && (B == 0)))
+    {
+        *lo = *hi + 1;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// The pixels of row y in [lo, hi] that are inside the wedge, as up to two
+// intervals. Returns the number of intervals.
+
+static int32_t
+wedgeIntervals(
+    const WEDGE_T *wedge,
+    int32_t y,
+    int32_t lo,
+    int32_t hi,
+    int32_t intervals[2][2])
+{
+    if (wedge->full)
+    {
+        intervals[0][0] = lo;
+        intervals[0][1] = hi;
+        return 1;
+    }
+
+    // start x y - start y x >= 0 and end y x - end x y > 0
+
+    int64_t l = lo;
+    int64_t h = hi;
+
+    clipHalfPlane(-wedge->y0, wedge->x0 * y, false, &l, &h);
+    clipHalfPlane(wedge->y1, -wedge->x1 * y, true, &l, &h);
+
+    if (wedge->convex)
+    {
+        // The centre is on both edges, count it as inside.
+
+        if ((y == 0) && (lo <= 0) && (hi >= 0))
+        {
+            if (l > h)
+            {
+                l = h = 0;
+            }
+            else
+            {
+                if (l > 0) l = 0;
+                if (h < 0) h = 0;
+            }
+        }
+
+        if (l > h)
+        {
+            return 0;
+        }
+
+        intervals[0][0] = (int32_t)l;
+        intervals[0][1] = (int32_t)h;
+        return 1;
+    }
+
+    // Outside the gap, which never contains the centre.
+
+    if (l > h)
+    {
+        intervals[0][0] = lo;
+        intervals[0][1] = hi;
+        return 1;
+    }
+
+    int32_t count = 0;
+
+    if (l > lo)
+    {
+        intervals[count][0] = lo;
+        intervals[count++][1] = (int32_t)l - 1;
+    }
+
+    if (h < hi)
+    {
+        intervals[count][0] = (int32_t)h + 1;
+        intervals[count++][1] = hi;
+    }
+
+    return count;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+ellipseSpan(
+    ELLIPSE_SPANS_T *spans,
+    const WEDGE_T *wedge,
+    int32_t y,
+    int32_t lo,
+    int32_t hi)
+{
+    int32_t intervals[2][2];
+    int32_t count = wedgeIntervals(wedge, y, lo, hi, intervals);
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        int32_t x1 = spans->xc + intervals[i][0];
+        int32_t x2 = spans->xc + intervals[i][1] + 1;
+
+        if (x1 < spans->pen.clipLeft) x1 = spans->pen.clipLeft;
+        if (x2 > spans->pen.clipRight) x2 = spans->pen.clipRight;
+
+        if (x2 > x1)
+        {
+            imagePenSpanUnclipped(&(spans->pen), x1, spans->yc + y, x2 - x1);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// The y offset where a ray from the centre at angle leaves the ellipse.
+
+static float
+wedgeEdgeY(
+    float angle,
+    int32_t a,
+    int32_t b)
+{
+    float c = cosf(angle) / (a + 0.5f);
+    float s = sinf(angle) / (b + 0.5f);
+
+    return sinf(angle) / sqrtf((c * c) + (s * s));
+}
+
+//-------------------------------------------------------------------------
+
+// With an outer ellipse only, fill it. With outline set, draw its edge.
+// With an inner ellipse, fill between the two.
+
+static void
+ellipseSpans(
+    ELLIPSE_SPANS_T *spans,
+    int32_t a,
+    int32_t b,
+    int32_t innerA,
+    int32_t innerB,
+    bool outline,
+    float start,
+    float end,
+    bool wedged)
+{
+    if ((a < 0) || (b < 0))
+    {
+        return;
+    }
+
+    ELLIPSE_T outer;
+    ELLIPSE_T inner;
+    WEDGE_T wedge = { .full = true };
+
+    initEllipse(&outer, a, b);
+    initEllipse(&inner, innerA, innerB);
+
+    int32_t top = -b;
+    int32_t bottom = b;
+
+    if (wedged)
+    {
+        initWedge(&wedge, start, end);
+
+        if (wedge.empty)
+        {
+            return;
+        }
+
+        if (wedge.full == false)
+        {
+            // Only the rows the wedge reaches: those of its edges and of
+            // the top or bottom of the ellipse if it contains them.
+
+            float s0 = wedgeEdgeY(start, a, b);
+            float s1 = wedgeEdgeY(end, a, b);
+            float low = fminf(fminf(s0, s1), 0.0f);
+            float high = fmaxf(fmaxf(s0, s1), 0.0f);
+
+            float sweep = fmodf(end - start, 2.0f * M_PI);
+            if (sweep < 0.0f) sweep += 2.0f * M_PI;
+
+            float down = fmodf((0.5f * M_PI) - start, 2.0f * M_PI);
+            if (down < 0.0f) down += 2.0f * M_PI;
+
+            float up = fmodf((1.5f * M_PI) - start, 2.0f * M_PI);
+            if (up < 0.0f) up += 2.0f * M_PI;
+
+            if (down <= sweep) high = b;
+            if (up <= sweep) low = -b;
+
+            top = (int32_t)floorf(low) - 1;
+            bottom = (int32_t)ceilf(high) + 1;
+
+            if (top < -b) top = -b;
+            if (bottom > b) bottom = b;
+        }
+    }
+
+    const IMAGE_PEN_T *pen = &(spans->pen);
+
+    if (spans->yc + top < pen->clipTop) top = pen->clipTop - spans->yc;
+    if (spans->yc + bottom >= pen->clipBottom)
+    {
+        bottom = pen->clipBottom - 1 - spans->yc;
+    }
+
+    if ((top > bottom) ||
+        (spans->xc + a < pen->clipLeft) ||
+        (spans->xc - a >= pen->clipRight))
+    {
+        return;
+    }
+
+    int32_t y;
+    for (y = top ; y <= bottom ; y++)
+    {
+        int32_t extent = ellipseExtent(&outer, y);
+        int32_t within = -1;
+
+        if (extent < 0)
+        {
+            continue;
+        }
+
+        if (outline)
+        {
+            int32_t next = ellipseExtent(&outer, abs(y) + 1);
+            within = (next < extent) ? next : extent - 1;
+        }
+        else if (innerA >= 0)
+        {
+            within = ellipseExtent(&inner, y);
+        }
+
+        if (within >= extent)
+        {
+            continue;
+        }
+
+        if (within < 0)
+        {
+            ellipseSpan(spans, &wedge, y, -extent, extent);
+        }
+        else
+        {
+            ellipseSpan(spans, &wedge, y, -extent, -within - 1);
+            ellipseSpan(spans, &wedge, y, within + 1, extent);
+        }
+    }
+
+    VC_RECT_T dirty =
+    {
+        .x = spans->xc - a,
+        .y = spans->yc + top,
+        .width = (2 * a) + 1,
+        .height = bottom - top + 1
+    };
+
+    if (clipImageRect(pen->image, &dirty))
+    {
+        markImageDirty(pen->image, dirty.x, dirty.y, dirty.width, dirty.height);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageCircleIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, true, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageCircleRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, true, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageCircleFilledIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageCircleFilledRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageEllipseIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, a, b, -1, -1, true, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageEllipseRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, a, b, -1, -1, true, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageEllipseFilledIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, a, b, -1, -1, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageEllipseFilledRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, a, b, -1, -1, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageArcIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, true, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageArcRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, true, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageSectorIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, false, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageSectorRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, r, r, -1, -1, false, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageAnnulusIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, outer, outer, inner, inner, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageAnnulusRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, outer, outer, inner, inner, false, 0.0f, 0.0f, false);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageAnnulusSectorIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    float start,
+    float end,
+    int8_t index)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenIndexed(&(spans.pen), image, index))
+    {
+        ellipseSpans(&spans, outer, outer, inner, inner, false, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageAnnulusSectorRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    float start,
+    float end,
+    const RGBA8_T *rgb)
+{
+    ELLIPSE_SPANS_T spans = { .xc = xc, .yc = yc };
+
+    if (initImagePenRGB(&(spans.pen), image, rgb))
+    {
+        ellipseSpans(&spans, outer, outer, inner, inner, false, start, end, true);
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+// Flood fill, by the scanline seed fill of Heckbert (Graphics Gems, 1990).
+// Each segment on the stack is a run of a row to search, next to a run
+// that has been filled in the row it came from (y - dy). The runs found
+// are filled as spans. The stack is on the heap, so the size of the area
+// does not matter.
+//
+// Pixels are compared as stored in the image, so nothing is converted.
+// If the pen could write the colour being replaced, which happens when a
+// dithered pattern contains it, the filled pixels are also recorded in a
+// bit mask so that they are not found again.
+//
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int32_t y;
+    int32_t x1;
+    int32_t x2;
+    int32_t dy;
+} FLOOD_SEGMENT_T;
+
+typedef struct
+{
+    const IMAGE_PEN_T *pen;
+    uint32_t target;
+    int32_t bits;
+    uint8_t *filled;	// bit mask of the clip rectangle, or NULL
+    int32_t filledPitch;
+    FLOOD_SEGMENT_T *stack;
+    int32_t count;
+    int32_t capacity;
+} FLOOD_T;
+
+//-------------------------------------------------------------------------
+
+static inline uint32_t
+floodPixel(
+    const FLOOD_T *flood,
+    int32_t x,
+    int32_t y)
+{
+    const uint8_t *row = flood->pen->buffer + (y * flood->pen->pitch);
+
+    switch (flood->bits)
+    {
+    case 4:
+
+        return (x & 1) ? (row[x >> 1] & 0x0F) : (row[x >> 1] >> 4);
+
+    case 8:
+
+        return row[x];
+
+    case 16:
+
+        return ((const uint16_t *)row)[x];
+
+    case 24:
+
+        row += 3 * x;
+        return row[0] | (row[1] << 8) | (row[2] << 16);
+
+    default:
+
+        return ((const uint32_t *)row)[x];
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static inline bool
+floodInside(
+    const FLOOD_T *flood,
+    int32_t x,
+    int32_t y)
+{
+    if (floodPixel(flood, x, y) != flood->target)
+    {
+        return false;
+    }
+
+    if (flood->filled != NULL)
+    {
+        int32_t i = x - flood->pen->clipLeft;
+        int32_t j = y - flood->pen->clipTop;
+
+        return ((flood->filled[(j * flood->filledPitch) + (i >> 3)]
+                 >> (i & 7)) & 1) == 0;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+floodPush(
+    FLOOD_T *flood,
+    int32_t y,
+    int32_t x1,
+    int32_t x2,
+    int32_t dy)
+{
+    if ((y < flood->pen->clipTop) || (y >= flood->pen->clipBottom))
+    {
+        return;
+    }
+
+    if (flood->count == flood->capacity)
+    {
+        int32_t capacity = (flood->capacity) ? 2 * flood->capacity : 256;
+        FLOOD_SEGMENT_T *stack = realloc(flood->stack,
+                                         capacity * sizeof(FLOOD_SEGMENT_T));
+
+        if (stack == NULL)
+        {
+            fprintf(stderr, "imageGraphics: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+
+        flood->stack = stack;
+        flood->capacity = capacity;
+    }
+
+    FLOOD_SEGMENT_T *segment = &(flood->stack[flood->count++]);
+
+    segment->y = y;
+    segment->x1 = x1;
+    segment->x2 = x2;
+    segment->dy = dy;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+floodSpan(
+    FLOOD_T *flood,
+    int32_t x1,
+    int32_t x2,
+    int32_t y)
+{
+    imagePenSpanUnclipped(flood->pen, x1, y, x2 - x1 + 1);
+
+    if (flood->filled != NULL)
+    {
+        uint8_t *row = flood->filled
+                     + ((y - flood->pen->clipTop) * flood->filledPitch);
+
+        int32_t i;
+        for (i = x1 - flood->pen->clipLeft ; i <= x2 - flood->pen->clipLeft ; i++)
+        {
+            row[i >> 3] |= 1 << (i & 7);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+floodFill(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y)
+{
+    if ((pen->kind == IMAGE_PEN_NONE) ||
+        (x < pen->clipLeft) || (x >= pen->clipRight) ||
+        (y < pen->clipTop) || (y >= pen->clipBottom))
+    {
+        return;
+    }
+
+    FLOOD_T flood =
+    {
+        .pen = pen,
+        .bits = pen->image->bitsPerPixel
+    };
+
+    flood.target = floodPixel(&flood, x, y);
+
+    //---------------------------------------------------------------------
+    // Find out whether the pen can write the target value.
+
+    bool clash = false;
+
+    switch (pen->kind)
+    {
+    case IMAGE_PEN_DITHERED_16BPP:
+    {
+        int32_t i;
+        for (i = 0 ; i < 64 ; i++)
+        {
+            clash = clash || (pen->pattern[i >> 3][i & 7] == flood.target);
+        }
+
+        break;
+    }
+    case IMAGE_PEN_24BPP:
+
+        clash = (flood.target == (uint32_t)(pen->rgb[0] |
+                                            (pen->rgb[1] << 8) |
+                                            (pen->rgb[2] << 16)));
+        break;
+
+    default:
+
+        clash = (flood.target == pen->value);
+        break;
+    }
+
+    if (clash && (pen->kind != IMAGE_PEN_DITHERED_16BPP))
+    {
+        // a single value that is already there, nothing would change
+
+        return;
+    }
+
+    if (clash)
+    {
+        int32_t height = pen->clipBottom - pen->clipTop;
+
+        flood.filledPitch = (pen->clipRight - pen->clipLeft + 7) / 8;
+        flood.filled = calloc(height, flood.filledPitch);
+
+        if (flood.filled == NULL)
+        {
+            fprintf(stderr, "imageGraphics: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //---------------------------------------------------------------------
+
+    int32_t left = x;
+    int32_t top = y;
+    int32_t right = x;
+    int32_t bottom = y;
+
+    floodPush(&flood, y, x, x, 1);
+    floodPush(&flood, y - 1, x, x, -1);
+
+    while (flood.count > 0)
+    {
+        FLOOD_SEGMENT_T segment = flood.stack[--flood.count];
+        int32_t x1 = segment.x1;
+        int32_t x2 = segment.x2;
+        int32_t dy = segment.dy;
+        int32_t l;
+
+        y = segment.y;
+        x = x1;
+
+        if (floodInside(&flood, x, y))
+        {
+            // The run may reach back past the start of the segment, and
+            // what it touches in the row it came from needs searching.
+
+            l = x;
+            while ((l > pen->clipLeft) && floodInside(&flood, l - 1, y))
+            {
+                --l;
+            }
+
+            if (l < x1)
+            {
+                floodPush(&flood, y - dy, l, x1 - 1, -dy);
+            }
+        }
+        else
+        {
+            while ((++x <= x2) && (floodInside(&flood, x, y) == false))
+            {
+                ;
+            }
+
+            l = x;
+        }
+
+        while (x <= x2)
+        {
+            int32_t r = x;
+            while ((r + 1 < pen->clipRight) && floodInside(&flood, r + 1, y))
+            {
+                ++r;
+            }
+
+            floodSpan(&flood, l, r, y);
+
+            if (l < left) left = l;
+            if (r > right) right = r;
+            if (y < top) top = y;
+            if (y > bottom) bottom = y;
+
+            floodPush(&flood, y + dy, l, r, dy);
+
+            if (r > x2)
+            {
+                floodPush(&flood, y - dy, x2 + 1, r, -dy);
+            }
+
+            x = r + 2;
+            while ((x <= x2) && (floodInside(&flood, x, y) == false))
+            {
+                ++x;
+            }
+
+            l = x;
+        }
+    }
+
+    free(flood.stack);
+    free(flood.filled);
+
+    markImageDirty(pen->image, left, top, right - left + 1, bottom - top + 1);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageFloodFillIndexed(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int8_t index)
+{
+    IMAGE_PEN_T pen;
+
+    if (initImagePenIndexed(&pen, image, index))
+    {
+        floodFill(&pen, x, y);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imageFloodFillRGB(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    const RGBA8_T *rgb)
+{
+    IMAGE_PEN_T pen;
+
+    if (initImagePenRGB(&pen, image, rgb))
+    {
+        floodFill(&pen, x, y);
     }
 }
 
@@ -29,6 +29,7 @@
 #define IMAGE_GRAPHICS_H
 
 #include "image.h"
+#include "imageRaster.h"
 
 //-------------------------------------------------------------------------
 
@@ -142,6 +143,9 @@ imageVerticalLineRGB(
 
 //-------------------------------------------------------------------------
 
+// Filled with the even-odd rule. The Rule variants below choose the fill
+// rule and, for RGB, whether edges are antialiased.
+
 void
 imagePolygonFilledIndexed(
     IMAGE_T *image,
@@ -154,6 +158,301 @@ imagePolygonFilledRGB(
     POLYGON_T *poly,
     const RGBA8_T *rgb);
 
+void
+imagePolygonFilledRuleIndexed(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index);
+
+void
+imagePolygonFilledRuleRGB(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// Lines of any width with the joins and caps of the stroke. RGB lines
+// have antialiased edges, blended a span at a time. Integer points are
+// the centres of pixels, as for imageLineRGB(); the points passed to
+// imageStrokeRGB() are in raster coordinates, see imageRaster.h.
+
+void
+imageLineWideIndexed(
+    IMAGE_T *image,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index);
+
+void
+imageLineWideRGB(
+    IMAGE_T *image,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb);
+
+void
+imagePolylineIndexed(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index);
+
+void
+imagePolylineRGB(
+    IMAGE_T *image,
+    const POLYGON_T *poly,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb);
+
+void
+imageStrokeRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// Paths of quadratic (degree 2) or cubic (degree 3) Bezier curves, in
+// raster coordinates. points holds the start of the path and then degree
+// points for each curve: its control points and its end, which is the
+// start of the next. Degree 1 makes a path of straight lines. The curves
+// are flattened to within IMAGE_RASTER_TOLERANCE of a pixel, into buffers
+// that are reused, so drawing does not allocate once they have grown.
+
+void
+imageBezierIndexed(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    int8_t index);
+
+void
+imageBezierRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    bool closed,
+    const IMAGE_STROKE_T *stroke,
+    const RGBA8_T *rgb);
+
+void
+imageBezierFilledIndexed(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index);
+
+void
+imageBezierFilledRGB(
+    IMAGE_T *image,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    int32_t degree,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// Circles, ellipses and their parts, centred on the pixel (xc, yc) and
+// drawn as spans. A circle of radius r is 2r + 1 pixels across. Angles
+// are in radians from the positive x axis towards positive y (clockwise
+// on the screen), and include start but not end, so that sectors sharing
+// an edge fit together exactly. When start equals end nothing is drawn,
+// and a range of 2 pi or more is the whole ellipse. Arcs are part of the
+// outline, sectors are filled, and annuli fill between the outer and
+// inner radii.
+
+void
+imageCircleIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    int8_t index);
+
+void
+imageCircleRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    const RGBA8_T *rgb);
+
+void
+imageCircleFilledIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    int8_t index);
+
+void
+imageCircleFilledRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    const RGBA8_T *rgb);
+
+void
+imageEllipseIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    int8_t index);
+
+void
+imageEllipseRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    const RGBA8_T *rgb);
+
+void
+imageEllipseFilledIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    int8_t index);
+
+void
+imageEllipseFilledRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t a,
+    int32_t b,
+    const RGBA8_T *rgb);
+
+void
+imageArcIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    int8_t index);
+
+void
+imageArcRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    const RGBA8_T *rgb);
+
+void
+imageSectorIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    int8_t index);
+
+void
+imageSectorRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t r,
+    float start,
+    float end,
+    const RGBA8_T *rgb);
+
+void
+imageAnnulusIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    int8_t index);
+
+void
+imageAnnulusRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    const RGBA8_T *rgb);
+
+void
+imageAnnulusSectorIndexed(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    float start,
+    float end,
+    int8_t index);
+
+void
+imageAnnulusSectorRGB(
+    IMAGE_T *image,
+    int32_t xc,
+    int32_t yc,
+    int32_t outer,
+    int32_t inner,
+    float start,
+    float end,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// Fill the area of pixels that are the same as the one at (x, y) and
+// joined to it horizontally or vertically, within the clip rectangle.
+
+void
+imageFloodFillIndexed(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    int8_t index);
+
+void
+imageFloodFillRGB(
+    IMAGE_T *image,
+    int32_t x,
+    int32_t y,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
 void
 setPolygonNodes( POLYGON_T *poly, int num, ...);
 
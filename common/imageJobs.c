@@ -0,0 +1,296 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "imageJobs.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+#define IMAGE_JOBS_MAX_THREADS 16
+#define IMAGE_JOBS_BANDS_PER_THREAD 2
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_mutex_t submit;
+
+    pthread_t workers[IMAGE_JOBS_MAX_THREADS];
+    int32_t workerCount;
+    int32_t threads;
+    size_t threshold;
+    bool stop;
+
+    uint32_t generation;
+    IMAGE_JOB_ROWS_T function;
+    void *context;
+    int32_t rows;
+    int32_t bands;
+    int32_t nextBand;
+    int32_t pending;
+} IMAGE_JOBS_T;
+
+static IMAGE_JOBS_T jobs =
+{
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .threads = 0,
+    .threshold = IMAGE_JOBS_DEFAULT_THRESHOLD,
+};
+
+static __thread bool insideJob = false;
+
+//-------------------------------------------------------------------------
+
+// Run bands of the current job until there are none left. Called with
+// the mutex held and returns with it held.
+
+static void
+runBands(void)
+{
+    while (jobs.nextBand < jobs.bands)
+    {
+        int32_t band = jobs.nextBand++;
+
+        int32_t first = (int32_t)(((int64_t)jobs.rows * band) / jobs.bands);
+        int32_t last = (int32_t)(((int64_t)jobs.rows * (band + 1)) / jobs.bands);
+
+        pthread_mutex_unlock(&jobs.mutex);
+
+        if (last > first)
+        {
+            jobs.function(jobs.context, first, last);
+        }
+
+        pthread_mutex_lock(&jobs.mutex);
+
+        if (--jobs.pending == 0)
+        {
+            pthread_cond_broadcast(&jobs.done);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void *
+worker(
+    void *arg)
+{
+    uint32_t seen = 0;
+
+    insideJob = true;
+
+    pthread_mutex_lock(&jobs.mutex);
+
+    while (true)
+    {
+        while ((jobs.stop == false) && (jobs.generation == seen))
+        {
+            pthread_cond_wait(&jobs.start, &jobs.mutex);
+        }
+
+        if (jobs.stop)
+        {
+            break;
+        }
+
+        seen = jobs.generation;
+        runBands();
+    }
+
+    pthread_mutex_unlock(&jobs.mutex);
+
+    return NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static int32_t
+threadCount(void)
+{
+    if (jobs.threads == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        jobs.threads = (processors < 1) ? 1 : processors;
+    }
+
+    if (jobs.threads > IMAGE_JOBS_MAX_THREADS + 1)
+    {
+        jobs.threads = IMAGE_JOBS_MAX_THREADS + 1;
+    }
+
+    return jobs.threads;
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+startWorkers(void)
+{
+    int32_t wanted = threadCount() - 1;
+
+    while (jobs.workerCount < wanted)
+    {
+        if (pthread_create(&(jobs.workers[jobs.workerCount]),
+                           NULL,
+                           worker,
+                           NULL) != 0)
+        {
+            fprintf(stderr, "imageJobs: unable to start worker thread\n");
+            break;
+        }
+
+        jobs.workerCount++;
+    }
+
+    return jobs.workerCount > 0;
+}
+
+//-------------------------------------------------------------------------
+
+void
+runImageJobRows(
+    IMAGE_JOB_ROWS_T function,
+    void *context,
+    int32_t rows,
+    size_t bytes)
+{
+    if (rows <= 0)
+    {
+        return;
+    }
+
+    if ((bytes < jobs.threshold) ||
+        (rows < 2) ||
+        insideJob ||
+        (threadCount() < 2))
+    {
+        function(context, 0, rows);
+        return;
+    }
+
+    pthread_mutex_lock(&jobs.submit);
+
+    pthread_mutex_lock(&jobs.mutex);
+
+    if (startWorkers() == false)
+    {
+        pthread_mutex_unlock(&jobs.mutex);
+        pthread_mutex_unlock(&jobs.submit);
+
+        function(context, 0, rows);
+        return;
+    }
+
+    int32_t bands = (jobs.workerCount + 1) * IMAGE_JOBS_BANDS_PER_THREAD;
+    if (bands > rows) bands = rows;
+
+    jobs.function = function;
+    jobs.context = context;
+    jobs.rows = rows;
+    jobs.bands = bands;
+    jobs.nextBand = 0;
+    jobs.pending = bands;
+    jobs.generation++;
+
+    pthread_cond_broadcast(&jobs.start);
+
+    insideJob = true;
+    runBands();
+    insideJob = false;
+
+    while (jobs.pending > 0)
+    {
+        pthread_cond_wait(&jobs.done, &jobs.mutex);
+    }
+
+    pthread_mutex_unlock(&jobs.mutex);
+    pthread_mutex_unlock(&jobs.submit);
+}
+
+//-------------------------------------------------------------------------
+
+void
+setImageJobsThreshold(
+    size_t bytes)
+{
+    pthread_mutex_lock(&jobs.submit);
+    jobs.threshold = bytes;
+    pthread_mutex_unlock(&jobs.submit);
+}
+
+//-------------------------------------------------------------------------
+
+void
+setImageJobsThreads(
+    int32_t threads)
+{
+    destroyImageJobs();
+
+    pthread_mutex_lock(&jobs.submit);
+    jobs.threads = (threads < 1) ? 1 : threads;
+    pthread_mutex_unlock(&jobs.submit);
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyImageJobs(void)
+{
+    pthread_mutex_lock(&jobs.submit);
+
+    pthread_mutex_lock(&jobs.mutex);
+    jobs.stop = true;
+    pthread_cond_broadcast(&jobs.start);
+    pthread_mutex_unlock(&jobs.mutex);
+
+    int32_t i;
+    for (i = 0 ; i < jobs.workerCount ; i++)
+    {
+        pthread_join(jobs.workers[i], NULL);
+    }
+
+    jobs.workerCount = 0;
+    jobs.stop = false;
+
+    pthread_mutex_unlock(&jobs.submit);
+}
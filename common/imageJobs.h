@@ -0,0 +1,81 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_JOBS_H
+#define IMAGE_JOBS_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+//
+// A persistent pool of worker threads for whole image operations. A job
+// is split into bands of rows and the calling thread works on bands
+// alongside the workers until all of them are done. Jobs that touch
+// fewer bytes than the threshold (or that are started from inside
+// another job) run on the calling thread without any synchronisation.
+// The workers are started on the first job that is large enough.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_JOBS_DEFAULT_THRESHOLD (1024 * 1024)
+
+typedef void (*IMAGE_JOB_ROWS_T)(void *context, int32_t first, int32_t last);
+
+//-------------------------------------------------------------------------
+
+// Call rows(context, first, last) for bands of [0, rows) that together
+// cover every row once. bytes is the amount of memory written, which is
+// compared against the threshold.
+
+void
+runImageJobRows(
+    IMAGE_JOB_ROWS_T function,
+    void *context,
+    int32_t rows,
+    size_t bytes);
+
+void
+setImageJobsThreshold(
+    size_t bytes);
+
+// Number of threads (including the caller) that share a job. The default
+// is the number of online processors; 1 turns the pool off.
+
+void
+setImageJobsThreads(
+    int32_t threads);
+
+void
+destroyImageJobs(void);
+
+//-------------------------------------------------------------------------
+
+#endif
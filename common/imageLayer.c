@@ -218,6 +218,72 @@ void writeFlagImageLayer(
                                              &(il->fullRect));
     assert(result == 0);
     il->image_write_flag = 1;
+
+    clearImageDirty(&(il->image));
+}
+
+//-------------------------------------------------------------------------
+//
+// vc_dispmanx_resource_write_data() ignores the x and width of the
+// rectangle: it copies pitch * height bytes starting at buffer + y * pitch.
+// So the dirty rectangles are reduced to row bands, overlapping or
+// adjacent bands are merged and each band is written with one call.
+//
+//-------------------------------------------------------------------------
+
+static void
+writeDirtyImageLayer(
+    IMAGE_LAYER_T *il)
+{
+    IMAGE_DIRTY_T *dirty = &(il->image.dirty);
+    int32_t top[IMAGE_DIRTY_RECTS];
+    int32_t bottom[IMAGE_DIRTY_RECTS];
+    int32_t count = 0;
+    int32_t i;
+
+    for (i = 0 ; i < dirty->count ; i++)
+    {
+        int32_t y = dirty->rects[i].y;
+        int32_t y2 = y + dirty->rects[i].height;
+        int32_t j = count++;
+
+        while ((j > 0) && (top[j - 1] > y))
+        {
+            top[j] = top[j - 1];
+            bottom[j] = bottom[j - 1];
+            --j;
+        }
+
+        top[j] = y;
+        bottom[j] = y2;
+    }
+
+    i = 0;
+    while (i < count)
+    {
+        int32_t y = top[i];
+        int32_t y2 = bottom[i];
+
+        while ((++i < count) && (top[i] <= y2))
+        {
+            if (bottom[i] > y2)
+            {
+                y2 = bottom[i];
+            }
+        }
+
+        VC_RECT_T rect;
+        vc_dispmanx_rect_set(&rect, 0, y, il->image.width, y2 - y);
+
+        int result = vc_dispmanx_resource_write_data(il->resource,
+                                                     il->image.type,
+                                                     il->image.pitch,
+                                                     il->image.buffer,
+                                                     &rect);
+        assert(result == 0);
+    }
+
+    clearImageDirty(&(il->image));
 }
 
 
@@ -228,16 +294,11 @@ changeSourceImageLayer(
     IMAGE_LAYER_T *il,
     DISPMANX_UPDATE_HANDLE_T update)
 {
-    int result = vc_dispmanx_resource_write_data(il->resource,
-                                                 il->image.type,
-                                                 il->image.pitch,
-                                                 il->image.buffer,
-                                                 &(il->fullRect));
-    assert(result == 0);
+    writeDirtyImageLayer(il);
 
-    result = vc_dispmanx_element_change_source(update,
-                                               il->element,
-                                               il->resource);
+    int result = vc_dispmanx_element_change_source(update,
+                                                   il->element,
+                                                   il->resource);
     assert(result == 0);
 
 }
@@ -248,19 +309,14 @@ void
 changeSourceAndUpdateImageLayer(
     IMAGE_LAYER_T *il)
 {
-    int result = vc_dispmanx_resource_write_data(il->resource,
-                                                 il->image.type,
-                                                 il->image.pitch,
-                                                 il->image.buffer,
-                                                 &(il->fullRect));
-    assert(result == 0);
+    writeDirtyImageLayer(il);
 
     DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
     assert(update != 0);
 
-    result = vc_dispmanx_element_change_source(update,
-                                               il->element,
-                                               il->resource);
+    int result = vc_dispmanx_element_change_source(update,
+                                                   il->element,
+                                                   il->resource);
     assert(result == 0);
 
     result = vc_dispmanx_update_submit_sync(update);
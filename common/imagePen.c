@@ -0,0 +1,551 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "imageConvert.h"
+#include "imageDither.h"
+#include "imageJobs.h"
+#include "imagePen.h"
+#include "imageSpan.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+static void
+initImagePen(
+    IMAGE_PEN_T *pen,
+    IMAGE_T *image)
+{
+    memset(pen, 0, sizeof(*pen));
+
+    pen->image = image;
+    pen->kind = IMAGE_PEN_NONE;
+    pen->buffer = image->buffer;
+    pen->pitch = image->pitch;
+    pen->width = image->width;
+    pen->height = image->height;
+    pen->clipLeft = image->clip.x;
+    pen->clipTop = image->clip.y;
+    pen->clipRight = image->clip.x + image->clip.width;
+    pen->clipBottom = image->clip.y + image->clip.height;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initImagePenIndexed(
+    IMAGE_PEN_T *pen,
+    IMAGE_T *image,
+    int8_t index)
+{
+    initImagePen(pen, image);
+
+    switch (image->type)
+    {
+    case VC_IMAGE_4BPP:
+
+        pen->kind = IMAGE_PEN_4BPP;
+        pen->value = index & 0x0F;
+        break;
+
+    case VC_IMAGE_8BPP:
+
+        pen->kind = IMAGE_PEN_8BPP;
+        pen->value = (uint8_t)index;
+        break;
+
+    default:
+
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+initImagePenRGB(
+    IMAGE_PEN_T *pen,
+    IMAGE_T *image,
+    const RGBA8_T *rgb)
+{
+    initImagePen(pen, image);
+
+    switch (image->type)
+    {
+    case VC_IMAGE_RGB565:
+    case VC_IMAGE_RGBA16:
+
+        if (isImageDithered(image))
+        {
+            int32_t y;
+            for (y = 0 ; y < 8 ; y++)
+            {
+                ditherPattern16(image->type, rgb,
+                                image->xOrigin, image->yOrigin + y,
+                                pen->pattern[y], 8);
+            }
+
+            pen->kind = IMAGE_PEN_DITHERED_16BPP;
+        }
+        else
+        {
+            uint16_t value;
+            convertImageRow(VC_IMAGE_RGBA32, rgb, 0,
+                            image->type, &value, 0, 1, NULL);
+
+            pen->kind = IMAGE_PEN_16BPP;
+            pen->value = value;
+        }
+
+        break;
+
+    case VC_IMAGE_RGB888:
+
+        pen->kind = IMAGE_PEN_24BPP;
+        pen->rgb[0] = rgb->red;
+        pen->rgb[1] = rgb->green;
+        pen->rgb[2] = rgb->blue;
+        break;
+
+    case VC_IMAGE_RGBA32:
+
+        pen->kind = IMAGE_PEN_32BPP;
+        memcpy(&(pen->value), rgb, sizeof(pen->value));
+        break;
+
+    default:
+
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePenSpanUnclipped(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t count)
+{
+    uint8_t *row = pen->buffer + (y * pen->pitch);
+
+    switch (pen->kind)
+    {
+    case IMAGE_PEN_4BPP:
+
+        if (x & 1)
+        {
+            imagePenPlotKind(pen, IMAGE_PEN_4BPP, x++, y);
+            count--;
+        }
+
+        spanFill8(row + (x >> 1), pen->value | (pen->value << 4), count >> 1);
+
+        if (count & 1)
+        {
+            imagePenPlotKind(pen, IMAGE_PEN_4BPP, x + count - 1, y);
+        }
+
+        break;
+
+    case IMAGE_PEN_8BPP:
+
+        spanFill8(row + x, pen->value, count);
+        break;
+
+    case IMAGE_PEN_16BPP:
+
+        spanFill16((uint16_t *)row + x, pen->value, count);
+        break;
+
+    case IMAGE_PEN_DITHERED_16BPP:
+    {
+        uint16_t pattern[8];
+
+        int32_t i;
+        for (i = 0 ; i < 8 ; i++)
+        {
+            pattern[i] = pen->pattern[y & 7][(x + i) & 7];
+        }
+
+        spanFillPattern16((uint16_t *)row + x, pattern, count);
+        break;
+    }
+    case IMAGE_PEN_24BPP:
+
+        spanFill24(row + (3 * x), pen->rgb, count);
+        break;
+
+    case IMAGE_PEN_32BPP:
+
+        spanFill32((uint32_t *)row + x, pen->value, count);
+        break;
+
+    default:
+
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePenSpan(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t count)
+{
+    if ((y < pen->clipTop) || (y >= pen->clipBottom))
+    {
+        return;
+    }
+
+    if (x < pen->clipLeft)
+    {
+        count -= pen->clipLeft - x;
+        x = pen->clipLeft;
+    }
+
+    if (x + count > pen->clipRight)
+    {
+        count = pen->clipRight - x;
+    }
+
+    if (count > 0)
+    {
+        imagePenSpanUnclipped(pen, x, y, count);
+        markImageDirty(pen->image, x, y, count, 1);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    const IMAGE_PEN_T *pen;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+} PEN_FILL_JOB_T;
+
+static void
+penFillRows(
+    void *context,
+    int32_t first,
+    int32_t last)
+{
+    PEN_FILL_JOB_T *job = context;
+
+    int32_t j;
+    for (j = first ; j < last ; j++)
+    {
+        imagePenSpanUnclipped(job->pen, job->x, job->y + j, job->width);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePenFillRect(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    if (x < pen->clipLeft) { width -= pen->clipLeft - x; x = pen->clipLeft; }
+    if (y < pen->clipTop) { height -= pen->clipTop - y; y = pen->clipTop; }
+    if (x + width > pen->clipRight) width = pen->clipRight - x;
+    if (y + height > pen->clipBottom) height = pen->clipBottom - y;
+
+    if ((width <= 0) || (height <= 0))
+    {
+        return;
+    }
+
+    PEN_FILL_JOB_T job = { pen, x, y, width };
+    size_t bytes = ((size_t)(pen->pitch) * height * width) / pen->width;
+
+    runImageJobRows(penFillRows, &job, height, bytes);
+
+    markImageDirty(pen->image, x, y, width, height);
+}
+
+//-------------------------------------------------------------------------
+//
+// Bresenham's line, written once and inlined for each pixel format. The
+// line is clipped before it is drawn, so the loop has no per pixel test.
+//
+// Step k along the major axis moves n(k) = floor((2k.dMinor + dMajor - 1)
+// / (2.dMajor)) along the minor axis, which gives the first and last steps
+// inside the clip rectangle and the decision variable at the first one.
+//
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    bool xMajor;
+    int32_t x;
+    int32_t y;
+    int32_t sign_x;
+    int32_t sign_y;
+    int32_t d;
+    int32_t incr;	// added to d after a step along the major axis
+    int32_t incrBoth;	// added to d after a step along both axes
+    int32_t steps;
+} PEN_LINE_T;
+
+//-------------------------------------------------------------------------
+
+static int64_t
+floorDiv(
+    int64_t a,
+    int64_t b)
+{
+    return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+static int64_t
+ceilDiv(
+    int64_t a,
+    int64_t b)
+{
+    return -floorDiv(-a, b);
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+clipPenLine(
+    const IMAGE_PEN_T *pen,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    PEN_LINE_T *line,
+    VC_RECT_T *dirty)
+{
+    int64_t dx = llabs((int64_t)x2 - x1);
+    int64_t dy = llabs((int64_t)y2 - y1);
+
+    line->xMajor = (dx > dy);
+    line->sign_x = (x1 <= x2) ? 1 : -1;
+    line->sign_y = (y1 <= y2) ? 1 : -1;
+
+    int64_t dMajor = (line->xMajor) ? dx : dy;
+    int64_t dMinor = (line->xMajor) ? dy : dx;
+
+    // Clip the steps to the rectangle in each axis, measured from the
+    // start of the line in the direction that it is drawn.
+
+    int64_t xFirst = (line->sign_x > 0) ? pen->clipLeft - x1 : x1 - (pen->clipRight - 1);
+    int64_t xLast = (line->sign_x > 0) ? (pen->clipRight - 1) - x1 : x1 - pen->clipLeft;
+    int64_t yFirst = (line->sign_y > 0) ? pen->clipTop - y1 : y1 - (pen->clipBottom - 1);
+    int64_t yLast = (line->sign_y > 0) ? (pen->clipBottom - 1) - y1 : y1 - pen->clipTop;
+
+    int64_t first = (line->xMajor) ? xFirst : yFirst;
+    int64_t last = (line->xMajor) ? xLast : yLast;
+    int64_t nFirst = (line->xMajor) ? yFirst : xFirst;
+    int64_t nLast = (line->xMajor) ? yLast : xLast;
+
+    if (first < 0) first = 0;
+    if (last > dMajor) last = dMajor;
+
+    if ((nFirst > dMinor) || (nLast < 0) || (nLast < nFirst))
+    {
+        return false;
+    }
+
+    if ((dMinor > 0) && (nFirst > 0))
+    {
+        int64_t k = ceilDiv(2 * dMajor * nFirst - dMajor + 1, 2 * dMinor);
+        if (k > first) first = k;
+    }
+
+    if ((dMinor > 0) && (nLast < dMinor))
+    {
+        int64_t k = floorDiv(2 * dMajor * (nLast + 1) - dMajor, 2 * dMinor);
+        if (k < last) last = k;
+    }
+
+    if (first > last)
+    {
+        return false;
+    }
+
+    int64_t nStart = 0;
+    int64_t nEnd = 0;
+
+    if (dMajor > 0)
+    {
+        nStart = floorDiv(2 * first * dMinor + dMajor - 1, 2 * dMajor);
+        nEnd = floorDiv(2 * last * dMinor + dMajor - 1, 2 * dMajor);
+    }
+
+    int32_t xStart = x1 + line->sign_x * ((line->xMajor) ? first : nStart);
+    int32_t yStart = y1 + line->sign_y * ((line->xMajor) ? nStart : first);
+    int32_t xEnd = x1 + line->sign_x * ((line->xMajor) ? last : nEnd);
+    int32_t yEnd = y1 + line->sign_y * ((line->xMajor) ? nEnd : last);
+
+    line->x = xStart;
+    line->y = yStart;
+    line->d = 2 * dMinor - dMajor + 2 * first * dMinor - 2 * dMajor * nStart;
+    line->incr = 2 * dMinor;
+    line->incrBoth = 2 * (dMinor - dMajor);
+    line->steps = last - first;
+
+    dirty->x = (xStart < xEnd) ? xStart : xEnd;
+    dirty->y = (yStart < yEnd) ? yStart : yEnd;
+    dirty->width = abs(xEnd - xStart) + 1;
+    dirty->height = abs(yEnd - yStart) + 1;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+static inline __attribute__((always_inline)) void
+penLine(
+    const IMAGE_PEN_T *pen,
+    IMAGE_PEN_KIND_T kind,
+    const PEN_LINE_T *line)
+{
+    int32_t x = line->x;
+    int32_t y = line->y;
+    int32_t d = line->d;
+    int32_t steps = line->steps;
+
+    imagePenPlotKind(pen, kind, x, y);
+
+    if (line->xMajor)
+    {
+        while (steps-- > 0)
+        {
+            x += line->sign_x;
+
+            if (d <= 0)
+            {
+                d += line->incr;
+            }
+            else
+            {
+                d += line->incrBoth;
+                y += line->sign_y;
+            }
+
+            imagePenPlotKind(pen, kind, x, y);
+        }
+    }
+    else
+    {
+        while (steps-- > 0)
+        {
+            y += line->sign_y;
+
+            if (d <= 0)
+            {
+                d += line->incr;
+            }
+            else
+            {
+                d += line->incrBoth;
+                x += line->sign_x;
+            }
+
+            imagePenPlotKind(pen, kind, x, y);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePenLine(
+    const IMAGE_PEN_T *pen,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2)
+{
+    PEN_LINE_T line;
+    VC_RECT_T dirty;
+
+    if (clipPenLine(pen, x1, y1, x2, y2, &line, &dirty) == false)
+    {
+        return;
+    }
+
+    switch (pen->kind)
+    {
+    case IMAGE_PEN_4BPP:
+
+        penLine(pen, IMAGE_PEN_4BPP, &line);
+        break;
+
+    case IMAGE_PEN_8BPP:
+
+        penLine(pen, IMAGE_PEN_8BPP, &line);
+        break;
+
+    case IMAGE_PEN_16BPP:
+
+        penLine(pen, IMAGE_PEN_16BPP, &line);
+        break;
+
+    case IMAGE_PEN_DITHERED_16BPP:
+
+        penLine(pen, IMAGE_PEN_DITHERED_16BPP, &line);
+        break;
+
+    case IMAGE_PEN_24BPP:
+
+        penLine(pen, IMAGE_PEN_24BPP, &line);
+        break;
+
+    case IMAGE_PEN_32BPP:
+
+        penLine(pen, IMAGE_PEN_32BPP, &line);
+        break;
+
+    default:
+
+        return;
+    }
+
+    markImageDirty(pen->image, dirty.x, dirty.y, dirty.width, dirty.height);
+}
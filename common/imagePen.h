@@ -0,0 +1,204 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_PEN_H
+#define IMAGE_PEN_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bcm_host.h"
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// A pen resolves a colour against an image once: the pixel format, the
+// packed pixel value (or the 8x8 pattern of a dithered colour) and the
+// buffer geometry. Drawing code then writes through the pen without the
+// bounds check and indirect call that setPixelRGB() makes for every
+// pixel. The span, line and rectangle functions clip to the image's clip
+// rectangle and mark the area they draw as dirty; imagePenPlot() does
+// neither. The clip is copied when the pen is made, so a pen should not
+// outlive a change to it.
+//
+//-------------------------------------------------------------------------
+
+typedef enum
+{
+    IMAGE_PEN_NONE,
+    IMAGE_PEN_4BPP,
+    IMAGE_PEN_8BPP,
+    IMAGE_PEN_16BPP,
+    IMAGE_PEN_DITHERED_16BPP,
+    IMAGE_PEN_24BPP,
+    IMAGE_PEN_32BPP
+} IMAGE_PEN_KIND_T;
+
+typedef struct
+{
+    IMAGE_T *image;
+    IMAGE_PEN_KIND_T kind;
+    uint8_t *buffer;
+    int32_t pitch;
+    int32_t width;
+    int32_t height;
+    int32_t clipLeft;	// clip rectangle, right and bottom exclusive
+    int32_t clipTop;
+    int32_t clipRight;
+    int32_t clipBottom;
+    uint32_t value;
+    uint8_t rgb[3];
+    uint16_t pattern[8][8];
+} IMAGE_PEN_T;
+
+//-------------------------------------------------------------------------
+
+bool
+initImagePenIndexed(
+    IMAGE_PEN_T *pen,
+    IMAGE_T *image,
+    int8_t index);
+
+bool
+initImagePenRGB(
+    IMAGE_PEN_T *pen,
+    IMAGE_T *image,
+    const RGBA8_T *rgb);
+
+//-------------------------------------------------------------------------
+
+// kind is normally a constant, so that the switch folds away when this is
+// inlined into a loop written for one pixel format.
+
+static inline void
+imagePenPlotKind(
+    const IMAGE_PEN_T *pen,
+    IMAGE_PEN_KIND_T kind,
+    int32_t x,
+    int32_t y)
+{
+    uint8_t *row = pen->buffer + (y * pen->pitch);
+
+    switch (kind)
+    {
+    case IMAGE_PEN_4BPP:
+    {
+        uint8_t *value = row + (x >> 1);
+
+        if (x & 1)
+        {
+            *value = (*value & 0xF0) | pen->value;
+        }
+        else
+        {
+            *value = (*value & 0x0F) | (pen->value << 4);
+        }
+
+        break;
+    }
+    case IMAGE_PEN_8BPP:
+
+        row[x] = pen->value;
+        break;
+
+    case IMAGE_PEN_16BPP:
+
+        ((uint16_t *)row)[x] = pen->value;
+        break;
+
+    case IMAGE_PEN_DITHERED_16BPP:
+
+        ((uint16_t *)row)[x] = pen->pattern[y & 7][x & 7];
+        break;
+
+    case IMAGE_PEN_24BPP:
+
+        row[3 * x] = pen->rgb[0];
+        row[3 * x + 1] = pen->rgb[1];
+        row[3 * x + 2] = pen->rgb[2];
+        break;
+
+    case IMAGE_PEN_32BPP:
+
+        ((uint32_t *)row)[x] = pen->value;
+        break;
+
+    default:
+
+        break;
+    }
+}
+
+static inline void
+imagePenPlot(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y)
+{
+    imagePenPlotKind(pen, pen->kind, x, y);
+}
+
+//-------------------------------------------------------------------------
+
+void
+imagePenSpan(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t count);
+
+// Like imagePenPlot(), this neither clips nor marks the span dirty.
+
+void
+imagePenSpanUnclipped(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t count);
+
+void
+imagePenFillRect(
+    const IMAGE_PEN_T *pen,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+void
+imagePenLine(
+    const IMAGE_PEN_T *pen,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,1260 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "imagePen.h"
+#include "imageRaster.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int64_t x;		// 16.16 at the current sample line
+    int64_t step;	// 16.16 change in x from one sample line to the next
+    int32_t first;	// first sample line crossed
+    int32_t last;	// one past the last sample line crossed
+    int32_t winding;
+} RASTER_EDGE_T;
+
+//-------------------------------------------------------------------------
+
+void
+initImageRaster(
+    IMAGE_RASTER_T *raster)
+{
+    raster->lines = NULL;
+    raster->count = 0;
+    raster->capacity = 0;
+    raster->work = NULL;
+    raster->workSize = 0;
+    raster->cells = NULL;
+    raster->cellsWidth = 0;
+    raster->tolerance = IMAGE_RASTER_TOLERANCE;
+
+    resetImageRaster(raster);
+}
+
+//-------------------------------------------------------------------------
+
+void
+resetImageRaster(
+    IMAGE_RASTER_T *raster)
+{
+    raster->count = 0;
+    raster->startX = raster->startY = 0.0f;
+    raster->lastX = raster->lastY = 0.0f;
+    raster->open = false;
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyImageRaster(
+    IMAGE_RASTER_T *raster)
+{
+    free(raster->lines);
+    free(raster->work);
+    free(raster->cells);
+
+    raster->lines = NULL;
+    raster->capacity = 0;
+    raster->work = NULL;
+    raster->workSize = 0;
+    raster->cells = NULL;
+    raster->cellsWidth = 0;
+    raster->tolerance = IMAGE_RASTER_TOLERANCE;
+
+    resetImageRaster(raster);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+addLine(
+    IMAGE_RASTER_T *raster,
+    float x0,
+    float y0,
+    float x1,
+    float y1)
+{
+    if (y0 == y1)
+    {
+        return;		// horizontal lines cross no sample line
+    }
+
+    if (raster->count == raster->capacity)
+    {
+        int32_t capacity = (raster->capacity) ? 2 * raster->capacity : 64;
+        IMAGE_RASTER_LINE_T *lines =
+            realloc(raster->lines, capacity * sizeof(IMAGE_RASTER_LINE_T));
+
+        if (lines == NULL)
+        {
+            fprintf(stderr, "imageRaster: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+
+        raster->lines = lines;
+        raster->capacity = capacity;
+    }
+
+    IMAGE_RASTER_LINE_T *line = &(raster->lines[raster->count++]);
+
+    line->x0 = x0;
+    line->y0 = y0;
+    line->x1 = x1;
+    line->y1 = y1;
+}
+
+//-------------------------------------------------------------------------
+
+void
+moveToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float x,
+    float y)
+{
+    closeImageRaster(raster);
+
+    raster->startX = raster->lastX = x;
+    raster->startY = raster->lastY = y;
+    raster->open = true;
+}
+
+//-------------------------------------------------------------------------
+
+void
+lineToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float x,
+    float y)
+{
+    if (raster->open == false)
+    {
+        moveToImageRaster(raster, x, y);
+        return;
+    }
+
+    addLine(raster, raster->lastX, raster->lastY, x, y);
+
+    raster->lastX = x;
+    raster->lastY = y;
+}
+
+//-------------------------------------------------------------------------
+//
+// A curve is flattened into n lines with equal steps of t. Wang's bound
+// on the distance between a curve of degree d and those lines is
+//
+//     d (d - 1) / 8 * M / n^2
+//
+// where M is the length of the largest second difference of the points,
+// so n is the smallest number of steps that keeps within the tolerance.
+// That needs no recursion and no stack, and the points are evaluated
+// directly so that no error builds up along the curve.
+//
+//-------------------------------------------------------------------------
+
+int32_t
+imageBezierSegments(
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree,
+    float tolerance)
+{
+    float m = 0.0f;
+
+    int32_t i;
+    for (i = 0 ; i + 2 <= degree ; i++)
+    {
+        float ddx = curve[i].x - (2.0f * curve[i + 1].x) + curve[i + 2].x;
+        float ddy = curve[i].y - (2.0f * curve[i + 1].y) + curve[i + 2].y;
+
+        m = fmaxf(m, sqrtf((ddx * ddx) + (ddy * ddy)));
+    }
+
+    if (tolerance < 0.01f)
+    {
+        tolerance = 0.01f;
+    }
+
+    float n = ceilf(sqrtf((degree * (degree - 1) * m) / (8.0f * tolerance)));
+
+    if (n < 1.0f)
+    {
+        return 1;
+    }
+
+    return (n < IMAGE_RASTER_MAX_SEGMENTS) ? n : IMAGE_RASTER_MAX_SEGMENTS;
+}
+
+//-------------------------------------------------------------------------
+
+static IMAGE_RASTER_POINT_T
+bezierPoint(
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree,
+    float t)
+{
+    float s = 1.0f - t;
+    IMAGE_RASTER_POINT_T point;
+
+    switch (degree)
+    {
+    case 2:
+
+        point.x = (s * s * curve[0].x)
+                + (2.0f * s * t * curve[1].x)
+                + (t * t * curve[2].x);
+        point.y = (s * s * curve[0].y)
+                + (2.0f * s * t * curve[1].y)
+                + (t * t * curve[2].y);
+        break;
+
+    case 3:
+
+        point.x = (s * s * s * curve[0].x)
+                + (3.0f * s * s * t * curve[1].x)
+                + (3.0f * s * t * t * curve[2].x)
+                + (t * t * t * curve[3].x);
+        point.y = (s * s * s * curve[0].y)
+                + (3.0f * s * s * t * curve[1].y)
+                + (3.0f * s * t * t * curve[2].y)
+                + (t * t * t * curve[3].y);
+        break;
+
+    default:
+
+        point.x = (s * curve[0].x) + (t * curve[1].x);
+        point.y = (s * curve[0].y) + (t * curve[1].y);
+        break;
+    }
+
+    return point;
+}
+
+//-------------------------------------------------------------------------
+
+void
+flattenImageBezier(
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree,
+    int32_t segments,
+    IMAGE_RASTER_POINT_T *points)
+{
+    int32_t i;
+    for (i = 1 ; i < segments ; i++)
+    {
+        points[i - 1] = bezierPoint(curve, degree, (float)i / segments);
+    }
+
+    points[segments - 1] = curve[degree];
+}
+
+//-------------------------------------------------------------------------
+
+static void
+curveToRaster(
+    IMAGE_RASTER_T *raster,
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree)
+{
+    int32_t segments = imageBezierSegments(curve, degree, raster->tolerance);
+
+    int32_t i;
+    for (i = 1 ; i < segments ; i++)
+    {
+        IMAGE_RASTER_POINT_T point = bezierPoint(curve,
+                                                 degree,
+                                                 (float)i / segments);
+
+        lineToImageRaster(raster, point.x, point.y);
+    }
+
+    lineToImageRaster(raster, curve[degree].x, curve[degree].y);
+}
+
+//-------------------------------------------------------------------------
+
+void
+quadToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float cx,
+    float cy,
+    float x,
+    float y)
+{
+    IMAGE_RASTER_POINT_T curve[3] =
+    {
+        { raster->lastX, raster->lastY },
+        { cx, cy },
+        { x, y }
+    };
+
+    if (raster->open == false)
+    {
+        moveToImageRaster(raster, raster->lastX, raster->lastY);
+    }
+
+    curveToRaster(raster, curve, 2);
+}
+
+//-------------------------------------------------------------------------
+
+void
+cubicToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float c1x,
+    float c1y,
+    float c2x,
+    float c2y,
+    float x,
+    float y)
+{
+    IMAGE_RASTER_POINT_T curve[4] =
+    {
+        { raster->lastX, raster->lastY },
+        { c1x, c1y },
+        { c2x, c2y },
+        { x, y }
+    };
+
+    if (raster->open == false)
+    {
+        moveToImageRaster(raster, raster->lastX, raster->lastY);
+    }
+
+    curveToRaster(raster, curve, 3);
+}
+
+//-------------------------------------------------------------------------
+
+void
+closeImageRaster(
+    IMAGE_RASTER_T *raster)
+{
+    if (raster->open)
+    {
+        addLine(raster,
+                raster->lastX,
+                raster->lastY,
+                raster->startX,
+                raster->startY);
+
+        raster->lastX = raster->startX;
+        raster->lastY = raster->startY;
+        raster->open = false;
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+// Strokes are built from convex pieces: a rectangle for each segment and
+// a wedge, circle or nothing for each join and cap. Every piece is added
+// with a positive winding, so with the non-zero rule the overlaps are
+// filled once.
+//
+//-------------------------------------------------------------------------
+
+#define STROKE_CIRCLE_POINTS 64
+
+static void
+addPiece(
+    IMAGE_RASTER_T *raster,
+    const IMAGE_RASTER_POINT_T *p,
+    int32_t count)
+{
+    float area = 0.0f;
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        const IMAGE_RASTER_POINT_T *q = &(p[(i + 1) % count]);
+        area += (p[i].x * q->y) - (q->x * p[i].y);
+    }
+
+    if (area == 0.0f)
+    {
+        return;
+    }
+
+    if (area > 0.0f)
+    {
+        moveToImageRaster(raster, p[0].x, p[0].y);
+        for (i = 1 ; i < count ; i++)
+        {
+            lineToImageRaster(raster, p[i].x, p[i].y);
+        }
+    }
+    else
+    {
+        moveToImageRaster(raster, p[count - 1].x, p[count - 1].y);
+        for (i = count - 2 ; i >= 0 ; i--)
+        {
+            lineToImageRaster(raster, p[i].x, p[i].y);
+        }
+    }
+
+    closeImageRaster(raster);
+}
+
+//-------------------------------------------------------------------------
+
+// Enough sides that the polygon is within an eighth of a pixel of the
+// circle.
+
+static void
+addCircle(
+    IMAGE_RASTER_T *raster,
+    float x,
+    float y,
+    float radius)
+{
+    IMAGE_RASTER_POINT_T p[STROKE_CIRCLE_POINTS];
+    int32_t count = 8;
+
+    if (radius > 0.125f)
+    {
+        count = (int32_t)ceilf(M_PI / acosf(1.0f - (0.125f / radius)));
+    }
+
+    if (count < 8) count = 8;
+    if (count > STROKE_CIRCLE_POINTS) count = STROKE_CIRCLE_POINTS;
+
+    int32_t i;
+    for (i = 0 ; i < count ; i++)
+    {
+        float angle = (2.0f * M_PI * i) / count;
+
+        p[i].x = x + (radius * cosf(angle));
+        p[i].y = y + (radius * sinf(angle));
+    }
+
+    addPiece(raster, p, count);
+}
+
+//-------------------------------------------------------------------------
+
+// a and b are unit directions of the segments into and out of p.
+
+static void
+addJoin(
+    IMAGE_RASTER_T *raster,
+    const IMAGE_RASTER_POINT_T *p,
+    const IMAGE_RASTER_POINT_T *a,
+    const IMAGE_RASTER_POINT_T *b,
+    const IMAGE_STROKE_T *stroke)
+{
+    float half = 0.5f * stroke->width;
+    float cross = (a->x * b->y) - (a->y * b->x);
+
+    if (stroke->join == IMAGE_JOIN_ROUND)
+    {
+        addCircle(raster, p->x, p->y, half);
+        return;
+    }
+
+    if (fabsf(cross) < 1e-6f)
+    {
+        return;		// straight on, or turning back on itself
+    }
+
+    // The outside of the turn, where the rectangles leave a gap.
+
+    float side = (cross > 0.0f) ? -half : half;
+
+    IMAGE_RASTER_POINT_T na = { -a->y, a->x };
+    IMAGE_RASTER_POINT_T nb = { -b->y, b->x };
+
+    IMAGE_RASTER_POINT_T piece[4];
+    int32_t count = 0;
+
+    piece[count++] = *p;
+    piece[count].x = p->x + (side * na.x);
+    piece[count++].y = p->y + (side * na.y);
+
+    // The miter point is along the bisector of the normals, at a distance
+    // of half / cos(theta / 2) where 1 + cos(theta) = 1 + na.nb.
+
+    float dot = (na.x * nb.x) + (na.y * nb.y);
+    float limit = (stroke->miterLimit > 1.0f) ? stroke->miterLimit : 1.0f;
+
+    if ((stroke->join == IMAGE_JOIN_MITER) &&
+        ((1.0f + dot) * limit * limit >= 2.0f))
+    {
+        float scale = side / (1.0f + dot);
+
+        piece[count].x = p->x + (scale * (na.x + nb.x));
+        piece[count++].y = p->y + (scale * (na.y + nb.y));
+    }
+
+    piece[count].x = p->x + (side * nb.x);
+    piece[count++].y = p->y + (side * nb.y);
+
+    addPiece(raster, piece, count);
+}
+
+//-------------------------------------------------------------------------
+
+void
+strokeImageRaster(
+    IMAGE_RASTER_T *raster,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    bool closed,
+    const IMAGE_STROKE_T *stroke)
+{
+    float half = 0.5f * stroke->width;
+
+    if ((count < 1) || (half <= 0.0f))
+    {
+        return;
+    }
+
+    closeImageRaster(raster);
+
+    // Directions of the segments, skipping those of zero length.
+
+    IMAGE_RASTER_POINT_T firstDirection = { 0.0f, 0.0f };
+    IMAGE_RASTER_POINT_T direction = { 0.0f, 0.0f };
+    const IMAGE_RASTER_POINT_T *firstPoint = NULL;
+    const IMAGE_RASTER_POINT_T *start = &(points[0]);
+    int32_t segments = 0;
+    int32_t last = (closed) ? count : count - 1;
+
+    // The last segment with a length, which a square cap extends.
+
+    int32_t final = last - 1;
+
+    while ((final > 0) &&
+           (points[final].x == points[(final + 1) % count].x) &&
+           (points[final].y == points[(final + 1) % count].y))
+    {
+        --final;
+    }
+
+    int32_t i;
+    for (i = 0 ; i < last ; i++)
+    {
+        const IMAGE_RASTER_POINT_T *end = &(points[(i + 1) % count]);
+
+        float dx = end->x - start->x;
+        float dy = end->y - start->y;
+
+        if ((dx == 0.0f) && (dy == 0.0f))
+        {
+            continue;
+        }
+
+        float length = sqrtf((dx * dx) + (dy * dy));
+
+        IMAGE_RASTER_POINT_T d = { dx / length, dy / length };
+
+        if (segments == 0)
+        {
+            firstDirection = d;
+            firstPoint = start;
+        }
+        else
+        {
+            addJoin(raster, start, &direction, &d, stroke);
+        }
+
+        // Square caps extend the open ends by half the width.
+
+        float back = 0.0f;
+        float forward = 0.0f;
+
+        if ((closed == false) && (stroke->cap == IMAGE_CAP_SQUARE))
+        {
+            if (segments == 0) back = half;
+            if (i == final) forward = half;
+        }
+
+        IMAGE_RASTER_POINT_T n = { -d.y * half, d.x * half };
+        IMAGE_RASTER_POINT_T a = { start->x - (d.x * back),
+                                   start->y - (d.y * back) };
+        IMAGE_RASTER_POINT_T b = { end->x + (d.x * forward),
+                                   end->y + (d.y * forward) };
+
+        IMAGE_RASTER_POINT_T piece[4] =
+        {
+            { a.x + n.x, a.y + n.y },
+            { b.x + n.x, b.y + n.y },
+            { b.x - n.x, b.y - n.y },
+            { a.x - n.x, a.y - n.y }
+        };
+
+        addPiece(raster, piece, 4);
+
+        direction = d;
+        start = end;
+        ++segments;
+    }
+
+    if (segments == 0)
+    {
+        // A single point is a dot for round and square caps.
+
+        if (stroke->cap == IMAGE_CAP_ROUND)
+        {
+            addCircle(raster, points[0].x, points[0].y, half);
+        }
+        else if (stroke->cap == IMAGE_CAP_SQUARE)
+        {
+            IMAGE_RASTER_POINT_T piece[4] =
+            {
+                { points[0].x - half, points[0].y - half },
+                { points[0].x + half, points[0].y - half },
+                { points[0].x + half, points[0].y + half },
+                { points[0].x - half, points[0].y + half }
+            };
+
+            addPiece(raster, piece, 4);
+        }
+    }
+    else if (closed)
+    {
+        addJoin(raster, firstPoint, &direction, &firstDirection, stroke);
+    }
+    else if (stroke->cap == IMAGE_CAP_ROUND)
+    {
+        addCircle(raster, firstPoint->x, firstPoint->y, half);
+        addCircle(raster, start->x, start->y, half);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static int
+compareEdges(
+    const void *a,
+    const void *b)
+{
+    const RASTER_EDGE_T *ea = a;
+    const RASTER_EDGE_T *eb = b;
+
+    return (ea->first > eb->first) - (ea->first < eb->first);
+}
+
+//-------------------------------------------------------------------------
+//
+// Turn the lines into edges that cross at least one sample line inside
+// the clip rectangle. Sample line s is at y = (s + 0.5) / samples. Edges
+// to the right of the clip rectangle can't change the spans inside it,
+// so they are dropped. Edges to the left are kept for their winding.
+//
+//-------------------------------------------------------------------------
+
+static int32_t
+buildEdges(
+    const IMAGE_RASTER_T *raster,
+    RASTER_EDGE_T *edges,
+    const VC_RECT_T *clip,
+    int32_t samples)
+{
+    int32_t firstLine = clip->y * samples;
+    int32_t lastLine = (clip->y + clip->height) * samples;
+    float right = clip->x + clip->width;
+    int32_t count = 0;
+
+    int32_t i;
+    for (i = 0 ; i < raster->count ; i++)
+    {
+        const IMAGE_RASTER_LINE_T *line = &(raster->lines[i]);
+
+        if ((line->x0 >= right) && (line->x1 >= right))
+        {
+            continue;
+        }
+
+        double xTop = line->x0;
+        double yTop = line->y0;
+        double xBottom = line->x1;
+        double yBottom = line->y1;
+        int32_t winding = 1;
+
+        if (yTop > yBottom)
+        {
+            xTop = line->x1;
+            yTop = line->y1;
+            xBottom = line->x0;
+            yBottom = line->y0;
+            winding = -1;
+        }
+
+        double top = ceil((yTop * samples) - 0.5);
+        double first = top;
+        double last = ceil((yBottom * samples) - 0.5);
+
+        if (first < firstLine) first = firstLine;
+        if (last > lastLine) last = lastLine;
+
+        if (first >= last)
+        {
+            continue;
+        }
+
+        // x is found at the top of the edge and stepped down to the clip,
+        // so that the edge crosses the same pixels whatever the clip.
+
+        double dxdy = (xBottom - xTop) / (yBottom - yTop);
+        double x = xTop + ((((top + 0.5) / samples) - yTop) * dxdy);
+
+        RASTER_EDGE_T *edge = &(edges[count++]);
+
+        edge->step = llround((dxdy / samples) * 65536.0);
+        edge->x = llround(x * 65536.0)
+                + (edge->step * (int64_t)(first - top));
+        edge->first = (int32_t)first;
+        edge->last = (int32_t)last;
+        edge->winding = winding;
+    }
+
+    qsort(edges, count, sizeof(RASTER_EDGE_T), compareEdges);
+
+    return count;
+}
+
+//-------------------------------------------------------------------------
+//
+// Add one sample line's span, from xa to xb in 24.8 fixed point relative
+// to the left of the clip rectangle, to the coverage of the current row.
+// Pixels between the ends are counted in delta and summed when the row is
+// emitted, so the cost does not depend on the length of the span.
+//
+//-------------------------------------------------------------------------
+
+static inline void
+accumulateSpan(
+    int32_t *partial,
+    int32_t *delta,
+    int32_t xa,
+    int32_t xb)
+{
+    int32_t ia = xa >> 8;
+    int32_t ib = xb >> 8;
+
+    if (ia == ib)
+    {
+        partial[ia] += xb - xa;
+    }
+    else
+    {
+        partial[ia] += 256 - (xa & 255);
+        partial[ib] += xb & 255;
+        delta[ia + 1] += 256;
+        delta[ib] -= 256;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static inline int32_t
+clampCoverage(
+    int32_t value)
+{
+    value >>= IMAGE_RASTER_AA_SHIFT;
+
+    return (value > 255) ? 255 : value;
+}
+
+//-------------------------------------------------------------------------
+//
+// Runs of pixels that are fully covered are passed to the span function
+// without a coverage array. Inside a run nothing was accumulated, so the
+// run is found by looking for the next pixel an edge touched.
+//
+//-------------------------------------------------------------------------
+
+static void
+emitCoverage(
+    int32_t *partial,
+    int32_t *delta,
+    uint8_t *coverage,
+    int32_t first,
+    int32_t last,
+    int32_t left,
+    int32_t y,
+    IMAGE_RASTER_SPAN_T span,
+    void *context)
+{
+    int32_t running = 0;
+    int32_t i = first;
+
+    while (i <= last)
+    {
+        int32_t start = i;
+        int32_t value = clampCoverage(running + delta[i] + partial[i]);
+
+        if ((value == 0) || (value == 255))
+        {
+            running += delta[i];
+            delta[i] = partial[i] = 0;
+            i++;
+
+            if (clampCoverage(running) == value)
+            {
+                while ((i <= last) && (delta[i] == 0) && (partial[i] == 0))
+                {
+                    i++;
+                }
+            }
+
+            if (value == 255)
+            {
+                span(context, left + start, y, i - start, NULL);
+            }
+        }
+        else
+        {
+            do
+            {
+                running += delta[i];
+                coverage[i] = value;
+                delta[i] = partial[i] = 0;
+
+                if (++i > last)
+                {
+                    break;
+                }
+
+                value = clampCoverage(running + delta[i] + partial[i]);
+            }
+            while ((value != 0) && (value != 255));
+
+            span(context, left + start, y, i - start, coverage + start);
+        }
+    }
+
+    delta[last + 1] = 0;
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    int64_t left;	// clip rectangle in 16.16
+    int64_t right;
+    bool antialias;
+    int32_t *partial;
+    int32_t *delta;
+    int32_t first;	// pixels touched in the row being accumulated
+    int32_t last;
+    IMAGE_RASTER_SPAN_T span;
+    void *context;
+} RASTER_ROW_T;
+
+//-------------------------------------------------------------------------
+
+static inline void
+addSpan(
+    RASTER_ROW_T *row,
+    int64_t xa,
+    int64_t xb,
+    int32_t y)
+{
+    if (xa < row->left) xa = row->left;
+    if (xb > row->right) xb = row->right;
+
+    if (xa >= xb)
+    {
+        return;
+    }
+
+    if (row->antialias)
+    {
+        int32_t a = (int32_t)((xa - row->left) >> 8);
+        int32_t b = (int32_t)((xb - row->left) >> 8);
+
+        if (b > a)
+        {
+            accumulateSpan(row->partial, row->delta, a, b);
+
+            if ((a >> 8) < row->first) row->first = a >> 8;
+            if ((b >> 8) > row->last) row->last = b >> 8;
+        }
+    }
+    else
+    {
+        // pixels whose centres are in [xa, xb)
+
+        int32_t pa = (int32_t)((xa + 32767) >> 16);
+        int32_t pb = (int32_t)((xb + 32767) >> 16);
+
+        if (pb > pa)
+        {
+            row->span(row->context, pa, y, pb - pa, NULL);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+renderImageRaster(
+    IMAGE_RASTER_T *raster,
+    const VC_RECT_T *clip,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    IMAGE_RASTER_SPAN_T span,
+    void *context)
+{
+    closeImageRaster(raster);
+
+    if ((raster->count == 0) || (clip->width <= 0) || (clip->height <= 0))
+    {
+        return;
+    }
+
+    int32_t samples = (antialias) ? IMAGE_RASTER_AA_SAMPLES : 1;
+    int32_t width = clip->width;
+
+    //---------------------------------------------------------------------
+
+    size_t edgeBytes = raster->count * sizeof(RASTER_EDGE_T);
+    size_t workSize = edgeBytes + (raster->count * sizeof(int32_t));
+
+    if (workSize > raster->workSize)
+    {
+        free(raster->work);
+        raster->work = malloc(workSize);
+        raster->workSize = (raster->work) ? workSize : 0;
+
+        if (raster->work == NULL)
+        {
+            fprintf(stderr, "imageRaster: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The coverage cells are zeroed when they are allocated, and after
+    // that each row clears the cells it used as it is emitted.
+
+    if (antialias && (width > raster->cellsWidth))
+    {
+        free(raster->cells);
+        raster->cells = calloc(width + 2, 2 * sizeof(int32_t) + 1);
+        raster->cellsWidth = (raster->cells) ? width : 0;
+
+        if (raster->cells == NULL)
+        {
+            fprintf(stderr, "imageRaster: memory exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    RASTER_EDGE_T *edges = raster->work;
+    int32_t *active = (int32_t *)((uint8_t *)(raster->work) + edgeBytes);
+    int32_t *partial = raster->cells;
+    int32_t *delta = partial + (raster->cellsWidth + 2);
+    uint8_t *coverage = (uint8_t *)(delta + (raster->cellsWidth + 2));
+
+    int32_t edgeCount = buildEdges(raster, edges, clip, samples);
+
+    if (edgeCount == 0)
+    {
+        return;
+    }
+
+    //---------------------------------------------------------------------
+
+    int64_t right = (int64_t)(clip->x + clip->width) << 16;
+    int32_t activeCount = 0;
+    int32_t next = 0;
+
+    RASTER_ROW_T row =
+    {
+        .left = (int64_t)(clip->x) << 16,
+        .right = right,
+        .antialias = antialias,
+        .partial = partial,
+        .delta = delta,
+        .first = width + 1,
+        .last = -1,
+        .span = span,
+        .context = context
+    };
+
+    int32_t line = edges[0].first;
+    int32_t lastLine = (clip->y + clip->height) * samples;
+
+    while (line < lastLine)
+    {
+        if ((activeCount == 0) && (row.last < 0))
+        {
+            // Nothing is active and no row is part way through being
+            // accumulated, so skip to the next edge.
+
+            if (next == edgeCount)
+            {
+                break;
+            }
+
+            if (edges[next].first > line)
+            {
+                line = edges[next].first;
+            }
+        }
+
+        // Drop the edges that end above this line, add those that start
+        // on it and sort by x. The order changes little from one line to
+        // the next, so an insertion sort is close to linear.
+
+        int32_t i;
+        int32_t j = 0;
+        for (i = 0 ; i < activeCount ; i++)
+        {
+            if (edges[active[i]].last > line)
+            {
+                active[j++] = active[i];
+            }
+        }
+        activeCount = j;
+
+        while ((next < edgeCount) && (edges[next].first <= line))
+        {
+            active[activeCount++] = next++;
+        }
+
+        for (i = 1 ; i < activeCount ; i++)
+        {
+            int32_t e = active[i];
+            int64_t x = edges[e].x;
+
+            for (j = i ; (j > 0) && (edges[active[j - 1]].x > x) ; j--)
+            {
+                active[j] = active[j - 1];
+            }
+
+            active[j] = e;
+        }
+
+        //-----------------------------------------------------------------
+
+        int32_t y = line / samples;
+        int32_t winding = 0;
+        bool inside = false;
+        int64_t spanStart = 0;
+
+        for (i = 0 ; i < activeCount ; i++)
+        {
+            RASTER_EDGE_T *edge = &(edges[active[i]]);
+
+            bool wasInside = inside;
+            winding += edge->winding;
+            inside = (rule == IMAGE_FILL_NON_ZERO) ? (winding != 0)
+                                                   : (winding & 1);
+
+            if (inside && (wasInside == false))
+            {
+                spanStart = edge->x;
+            }
+            else if (wasInside && (inside == false))
+            {
+                addSpan(&row, spanStart, edge->x, y);
+            }
+        }
+
+        // Edges to the right of the clip rectangle were dropped, so a span
+        // may still be open.
+
+        if (inside)
+        {
+            addSpan(&row, spanStart, right, y);
+        }
+
+        for (i = 0 ; i < activeCount ; i++)
+        {
+            edges[active[i]].x += edges[active[i]].step;
+        }
+
+        //-----------------------------------------------------------------
+
+        ++line;
+
+        if (antialias && ((line % samples) == 0) && (row.last >= 0))
+        {
+            if (row.last >= width)
+            {
+                row.last = width - 1;
+            }
+
+            emitCoverage(partial, delta, coverage,
+                         row.first, row.last, clip->x, y,
+                         span, context);
+
+            row.first = width + 1;
+            row.last = -1;
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    IMAGE_T *image;
+    IMAGE_PEN_T pen;
+    const RGBA8_T *rgb;
+} RASTER_FILL_T;
+
+static void
+fillSpan(
+    void *context,
+    int32_t x,
+    int32_t y,
+    int32_t count,
+    const uint8_t *coverage)
+{
+    RASTER_FILL_T *fill = context;
+
+    if (coverage == NULL)
+    {
+        imagePenSpanUnclipped(&(fill->pen), x, y, count);
+    }
+    else
+    {
+        fill->image->blendSpan(fill->image, x, y, count, fill->rgb, coverage);
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+// Mark the bounding box of the shape dirty once, rather than each span.
+//
+//-------------------------------------------------------------------------
+
+void
+markImageRasterDirty(
+    const IMAGE_RASTER_T *raster,
+    IMAGE_T *image)
+{
+    if (raster->count == 0)
+    {
+        return;
+    }
+
+    float x1 = raster->lines[0].x0;
+    float x2 = x1;
+    float y1 = raster->lines[0].y0;
+    float y2 = y1;
+
+    int32_t i;
+    for (i = 0 ; i < raster->count ; i++)
+    {
+        const IMAGE_RASTER_LINE_T *line = &(raster->lines[i]);
+
+        x1 = fminf(x1, fminf(line->x0, line->x1));
+        x2 = fmaxf(x2, fmaxf(line->x0, line->x1));
+        y1 = fminf(y1, fminf(line->y0, line->y1));
+        y2 = fmaxf(y2, fmaxf(line->y0, line->y1));
+    }
+
+    // clip before converting, the coordinates may be far outside
+
+    const VC_RECT_T *clip = &(image->clip);
+
+    x1 = fmaxf(x1, clip->x);
+    y1 = fmaxf(y1, clip->y);
+    x2 = fminf(x2, clip->x + clip->width);
+    y2 = fminf(y2, clip->y + clip->height);
+
+    if ((x2 > x1) && (y2 > y1))
+    {
+        int32_t left = floorf(x1);
+        int32_t top = floorf(y1);
+
+        markImageDirty(image,
+                       left,
+                       top,
+                       (int32_t)ceilf(x2) - left,
+                       (int32_t)ceilf(y2) - top);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+fillImageRasterRGB(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb)
+{
+    RASTER_FILL_T fill = { .image = image, .rgb = rgb };
+
+    if (initImagePenRGB(&(fill.pen), image, rgb) == false)
+    {
+        return;
+    }
+
+    if (image->blendSpan == NULL)
+    {
+        antialias = false;
+    }
+
+    VC_RECT_T clip = image->clip;
+
+    closeImageRaster(raster);
+    markImageRasterDirty(raster, image);
+    renderImageRaster(raster, &clip, rule, antialias, fillSpan, &fill);
+}
+
+//-------------------------------------------------------------------------
+
+void
+fillImageRasterIndexed(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index)
+{
+    RASTER_FILL_T fill = { .image = image, .rgb = NULL };
+
+    if (initImagePenIndexed(&(fill.pen), image, index) == false)
+    {
+        return;
+    }
+
+    VC_RECT_T clip = image->clip;
+
+    closeImageRaster(raster);
+    markImageRasterDirty(raster, image);
+    renderImageRaster(raster, &clip, rule, false, fillSpan, &fill);
+}
+
+//-------------------------------------------------------------------------
@@ -0,0 +1,265 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_RASTER_H
+#define IMAGE_RASTER_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// Scanline rasterizer for filled shapes. A shape is built from one or
+// more closed contours, in pixel coordinates where (0, 0) is the top left
+// corner of the top left pixel. Rendering sorts the edges into an edge
+// table and sweeps down the image keeping a list of active edges, whose
+// x positions are stepped in 16.16 fixed point. Each run of pixels inside
+// the shape is passed to a span function.
+//
+// Without antialiasing a pixel is inside if its centre is. With
+// antialiasing each row is sampled on IMAGE_RASTER_AA_SAMPLES lines, each
+// line contributes its exact horizontal coverage, and pixels that are only
+// partly covered are passed with a coverage value (0 to 255) for each.
+//
+// The edge list is kept between shapes, so a raster that is reset and
+// reused does not allocate memory once it has grown.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_RASTER_AA_SHIFT 2
+#define IMAGE_RASTER_AA_SAMPLES (1 << IMAGE_RASTER_AA_SHIFT)
+
+// Curves are flattened into lines that stay within this many pixels of
+// the curve, unless the raster's tolerance is changed.
+
+#define IMAGE_RASTER_TOLERANCE 0.25f
+#define IMAGE_RASTER_MAX_SEGMENTS 1024
+
+typedef enum
+{
+    IMAGE_FILL_EVEN_ODD,
+    IMAGE_FILL_NON_ZERO
+} IMAGE_FILL_RULE_T;
+
+typedef enum
+{
+    IMAGE_JOIN_MITER,
+    IMAGE_JOIN_ROUND,
+    IMAGE_JOIN_BEVEL
+} IMAGE_JOIN_T;
+
+typedef enum
+{
+    IMAGE_CAP_BUTT,
+    IMAGE_CAP_ROUND,
+    IMAGE_CAP_SQUARE
+} IMAGE_CAP_T;
+
+// A miter join longer than miterLimit times the width is drawn as a bevel.
+
+typedef struct
+{
+    float width;
+    IMAGE_JOIN_T join;
+    IMAGE_CAP_T cap;
+    float miterLimit;
+} IMAGE_STROKE_T;
+
+typedef struct
+{
+    float x;
+    float y;
+} IMAGE_RASTER_POINT_T;
+
+typedef struct
+{
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+} IMAGE_RASTER_LINE_T;
+
+typedef struct
+{
+    IMAGE_RASTER_LINE_T *lines;
+    int32_t count;
+    int32_t capacity;
+    float startX;
+    float startY;
+    float lastX;
+    float lastY;
+    bool open;
+    float tolerance;	// of curve flattening, in pixels
+    void *work;		// edge lists used by rendering
+    size_t workSize;
+    void *cells;	// coverage of the row being antialiased
+    int32_t cellsWidth;
+} IMAGE_RASTER_T;
+
+// coverage is NULL if every pixel of the span is fully covered.
+
+typedef void (*IMAGE_RASTER_SPAN_T)(void *context,
+                                    int32_t x,
+                                    int32_t y,
+                                    int32_t count,
+                                    const uint8_t *coverage);
+
+//-------------------------------------------------------------------------
+
+void
+initImageRaster(
+    IMAGE_RASTER_T *raster);
+
+void
+resetImageRaster(
+    IMAGE_RASTER_T *raster);
+
+void
+destroyImageRaster(
+    IMAGE_RASTER_T *raster);
+
+//-------------------------------------------------------------------------
+
+void
+moveToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float x,
+    float y);
+
+void
+lineToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float x,
+    float y);
+
+// Quadratic and cubic Bezier curves from the last point, through the
+// control points to (x, y).
+
+void
+quadToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float cx,
+    float cy,
+    float x,
+    float y);
+
+void
+cubicToImageRaster(
+    IMAGE_RASTER_T *raster,
+    float c1x,
+    float c1y,
+    float c2x,
+    float c2y,
+    float x,
+    float y);
+
+// Contours are also closed by moveToImageRaster() and when rendering.
+
+void
+closeImageRaster(
+    IMAGE_RASTER_T *raster);
+
+// Add the outline of a line through the points, drawn with a pen of the
+// stroke's width. The outline is made of overlapping contours that all
+// wind the same way, so it must be rendered with IMAGE_FILL_NON_ZERO.
+
+void
+strokeImageRaster(
+    IMAGE_RASTER_T *raster,
+    const IMAGE_RASTER_POINT_T *points,
+    int32_t count,
+    bool closed,
+    const IMAGE_STROKE_T *stroke);
+
+//-------------------------------------------------------------------------
+
+// A Bezier curve of degree 1 to 3 has degree + 1 points: the start, the
+// control points and the end. imageBezierSegments() is the number of
+// equal steps of t that keep the lines within tolerance of the curve,
+// from the bound of Wang (1984), and flattenImageBezier() writes the end
+// of each of those lines, finishing exactly at the end of the curve.
+
+int32_t
+imageBezierSegments(
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree,
+    float tolerance);
+
+void
+flattenImageBezier(
+    const IMAGE_RASTER_POINT_T *curve,
+    int32_t degree,
+    int32_t segments,
+    IMAGE_RASTER_POINT_T *points);
+
+//-------------------------------------------------------------------------
+
+// Calls span for every run of pixels inside the shape that lies within
+// the clip rectangle.
+
+void
+renderImageRaster(
+    IMAGE_RASTER_T *raster,
+    const VC_RECT_T *clip,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    IMAGE_RASTER_SPAN_T span,
+    void *context);
+
+// Mark the bounding box of the shape, inside the clip rectangle, as dirty.
+
+void
+markImageRasterDirty(
+    const IMAGE_RASTER_T *raster,
+    IMAGE_T *image);
+
+// Fill the shape in an image with a solid colour. Antialiased edges are
+// blended, so they need an image type with a blend span function;
+// otherwise (and for indexed images) the shape is filled without.
+
+void
+fillImageRasterRGB(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    bool antialias,
+    const RGBA8_T *rgb);
+
+void
+fillImageRasterIndexed(
+    IMAGE_RASTER_T *raster,
+    IMAGE_T *image,
+    IMAGE_FILL_RULE_T rule,
+    int8_t index);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,338 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "imageRaw.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+#ifndef ALIGN_TO_16
+#define ALIGN_TO_16(x)  ((x + 15) & ~15)
+#endif
+
+#ifndef ALIGN_TO_32
+#define ALIGN_TO_32(x)  ((x + 31) & ~31)
+#endif
+
+#define ALIGN_TO_PAGE(x) \
+    (((x) + IMAGE_RAW_PAGE_SIZE - 1) & ~(IMAGE_RAW_PAGE_SIZE - 1))
+
+//-------------------------------------------------------------------------
+
+static uint64_t
+rawBitsPerPixel(
+    uint32_t type)
+{
+    switch (type)
+    {
+    case VC_IMAGE_4BPP:
+
+        return 4;
+
+    case VC_IMAGE_8BPP:
+
+        return 8;
+
+    case VC_IMAGE_RGB565:
+    case VC_IMAGE_RGBA16:
+
+        return 16;
+
+    case VC_IMAGE_RGB888:
+
+        return 24;
+
+    case VC_IMAGE_RGBA32:
+
+        return 32;
+
+    default:
+
+        return 0;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+checkImageRawHeader(
+    const IMAGE_RAW_HEADER_T *header,
+    size_t fileSize,
+    const char *file)
+{
+    if (memcmp(header->magic, IMAGE_RAW_MAGIC, sizeof(header->magic)) != 0)
+    {
+        fprintf(stderr, "imageRaw: %s is not a raw image\n", file);
+        return false;
+    }
+
+    if (header->version != IMAGE_RAW_VERSION)
+    {
+        fprintf(stderr,
+                "imageRaw: %s has unsupported version %u\n",
+                file,
+                header->version);
+        return false;
+    }
+
+    uint64_t bitsPerPixel = rawBitsPerPixel(header->type);
+
+    if (bitsPerPixel == 0)
+    {
+        fprintf(stderr,
+                "imageRaw: %s has unsupported image type %u\n",
+                file,
+                header->type);
+        return false;
+    }
+
+    // The sizes are checked in 64 bits, as a crafted header could
+    // overflow the int32_t sums in initImageBuffer().
+
+    if ((header->width > INT32_MAX) ||
+        (header->height > INT32_MAX) ||
+        (header->pitch > INT32_MAX) ||
+        (header->alignedHeight > INT32_MAX) ||
+        (((uint64_t)(header->width) * bitsPerPixel / 8) > header->pitch))
+    {
+        fprintf(stderr, "imageRaw: %s has invalid dimensions\n", file);
+        return false;
+    }
+
+    uint64_t paletteEnd = sizeof(IMAGE_RAW_HEADER_T)
+                        + ((uint64_t)(header->paletteEntries) * sizeof(RGBA8_T));
+    uint64_t dataEnd = header->dataOffset
+                     + ((uint64_t)(header->pitch) * header->alignedHeight);
+
+    if ((header->dataOffset % IMAGE_RAW_PAGE_SIZE) ||
+        (header->dataOffset < paletteEnd) ||
+        (dataEnd > fileSize))
+    {
+        fprintf(stderr, "imageRaw: %s is truncated or corrupt\n", file);
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool
+loadImageRaw(
+    IMAGE_T *image,
+    const char *file)
+{
+    assert(image != NULL);
+
+    int fd = open(file, O_RDONLY);
+
+    if (fd == -1)
+    {
+        fprintf(stderr, "imageRaw: can't open %s for reading\n", file);
+        return false;
+    }
+
+    struct stat st;
+
+    if ((fstat(fd, &st) == -1) ||
+        (st.st_size < (off_t)sizeof(IMAGE_RAW_HEADER_T)))
+    {
+        fprintf(stderr, "imageRaw: %s is too short\n", file);
+        close(fd);
+        return false;
+    }
+
+    size_t length = st.st_size;
+
+    // A private writable mapping shares the page cache with every other
+    // process that maps the file, until a page is drawn on.
+
+    void *mapping = mmap(NULL,
+                         length,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE,
+                         fd,
+                         0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "imageRaw: unable to map %s\n", file);
+        return false;
+    }
+
+    const IMAGE_RAW_HEADER_T *header = mapping;
+
+    if ((checkImageRawHeader(header, length, file) == false) ||
+        (initImageBuffer(image,
+                         header->type,
+                         header->width,
+                         header->height,
+                         header->pitch,
+                         header->alignedHeight,
+                         (uint8_t *)mapping + header->dataOffset,
+                         false) == false))
+    {
+        munmap(mapping, length);
+        return false;
+    }
+
+    image->mapping = mapping;
+    image->mappingSize = length;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+const RGBA8_T *
+getImageRawPalette(
+    const IMAGE_T *image,
+    int32_t *entries)
+{
+    const IMAGE_RAW_HEADER_T *header = image->mapping;
+
+    if ((header == NULL) || (header->paletteEntries == 0))
+    {
+        if (entries != NULL)
+        {
+            *entries = 0;
+        }
+
+        return NULL;
+    }
+
+    if (entries != NULL)
+    {
+        *entries = header->paletteEntries;
+    }
+
+    return (const RGBA8_T *)(header + 1);
+}
+
+//-------------------------------------------------------------------------
+
+bool
+saveImageRaw(
+    const IMAGE_T *image,
+    const char *file,
+    const RGBA8_T *palette,
+    int32_t entries)
+{
+    if (palette == NULL)
+    {
+        entries = 0;
+    }
+
+    // The file always gets the layout initImage() would use, whatever the
+    // pitch of the image (a view has the pitch of its parent).
+
+    IMAGE_RAW_HEADER_T header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_RAW_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_RAW_VERSION;
+    header.type = image->type;
+    header.width = image->width;
+    header.height = image->height;
+    header.pitch = (ALIGN_TO_32(image->width) * image->bitsPerPixel) / 8;
+    header.alignedHeight = ALIGN_TO_16(image->height);
+    header.paletteEntries = entries;
+    header.dataOffset = ALIGN_TO_PAGE(sizeof(header) + entries * sizeof(RGBA8_T));
+
+    FILE *fp = fopen(file, "wb");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "imageRaw: can't open %s for writing\n", file);
+        return false;
+    }
+
+    size_t rowBytes = ((image->width * image->bitsPerPixel) + 7) / 8;
+    uint8_t *row = calloc(1, header.pitch);
+
+    if (row == NULL)
+    {
+        fprintf(stderr, "imageRaw: unable to allocate row buffer\n");
+        fclose(fp);
+        return false;
+    }
+
+    bool result = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+    if (result && (entries > 0))
+    {
+        result = (fwrite(palette, sizeof(RGBA8_T), entries, fp) == (size_t)entries);
+    }
+
+    if (result)
+    {
+        result = (fseek(fp, header.dataOffset, SEEK_SET) == 0);
+    }
+
+    uint32_t y = 0;
+    for (y = 0 ; result && (y < header.alignedHeight) ; y++)
+    {
+        if (y < header.height)
+        {
+            memcpy(row,
+                   (uint8_t *)(image->buffer) + (y * image->pitch),
+                   rowBytes);
+        }
+        else
+        {
+            memset(row, 0, header.pitch);
+        }
+
+        result = (fwrite(row, header.pitch, 1, fp) == 1);
+    }
+
+    free(row);
+
+    if ((fclose(fp) != 0) || (result == false))
+    {
+        fprintf(stderr, "imageRaw: error writing %s\n", file);
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_RAW_H
+#define IMAGE_RAW_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// Raw images are stored exactly as they are held in memory, so they can
+// be mapped straight into an IMAGE_T. The file starts with the header,
+// followed by the palette (if any). The pixels start at dataOffset, which
+// is a multiple of the page size, and are pitch * alignedHeight bytes.
+// All the header fields are in the byte order of the machine that wrote
+// the file.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_RAW_MAGIC "RAWIMAGE"
+#define IMAGE_RAW_VERSION 1
+#define IMAGE_RAW_PAGE_SIZE 4096
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t alignedHeight;
+    uint32_t paletteEntries;	// RGBA8_T entries after the header
+    uint32_t dataOffset;
+} IMAGE_RAW_HEADER_T;
+
+//-------------------------------------------------------------------------
+
+// The file is mapped copy on write, so drawing into the image does not
+// change the file. The mapping is released by destroyImage().
+
+bool
+loadImageRaw(
+    IMAGE_T *image,
+    const char *file);
+
+// Returns the palette stored with an image loaded by loadImageRaw(), or
+// NULL if there is none. It is valid until the image is destroyed.
+
+const RGBA8_T *
+getImageRawPalette(
+    const IMAGE_T *image,
+    int32_t *entries);
+
+bool
+saveImageRaw(
+    const IMAGE_T *image,
+    const char *file,
+    const RGBA8_T *palette,
+    int32_t entries);
+
+//-------------------------------------------------------------------------
+
+#endif
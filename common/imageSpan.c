@@ -0,0 +1,913 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "imageSpan.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SPAN_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SPAN_SSE2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPAN_AVX2
+#endif
+#endif
+
+//-------------------------------------------------------------------------
+//
+// (t + 128 + ((t + 128) >> 8)) >> 8 is t / 255 rounded to the nearest
+// integer for any t up to 255 * 255, without the divide. The vector
+// versions below use exactly the same sum, so all implementations produce
+// identical pixels.
+//
+//-------------------------------------------------------------------------
+
+#define DIV255(t) (((t) + 128 + (((t) + 128) >> 8)) >> 8)
+
+//-------------------------------------------------------------------------
+
+const char *
+spanImplementation(void)
+{
+#if defined(SPAN_NEON)
+    return "NEON";
+#elif defined(SPAN_AVX2)
+    return "AVX2";
+#elif defined(SPAN_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanFill8(
+    uint8_t *dst,
+    uint8_t value,
+    size_t count)
+{
+    memset(dst, value, count);
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanFill16(
+    uint16_t *dst,
+    uint16_t value,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_NEON)
+    uint16x8_t v = vdupq_n_u16(value);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        vst1q_u16(dst + i, v);
+        vst1q_u16(dst + i + 8, v);
+    }
+#elif defined(SPAN_AVX2)
+    __m256i v = _mm256_set1_epi16((int16_t)value);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#elif defined(SPAN_SSE2)
+    __m128i v = _mm_set1_epi16((int16_t)value);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        dst[i] = value;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanFill24(
+    uint8_t *dst,
+    const uint8_t value[3],
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_NEON)
+    uint8x16x3_t v;
+    v.val[0] = vdupq_n_u8(value[0]);
+    v.val[1] = vdupq_n_u8(value[1]);
+    v.val[2] = vdupq_n_u8(value[2]);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        vst3q_u8(dst + (3 * i), v);
+    }
+#elif defined(SPAN_AVX2) || defined(SPAN_SSE2)
+    // three bytes per pixel only line up with the vector width every
+    // 48 (SSE2) or 96 (AVX2) bytes, so build that much of the pattern
+    // once and store it repeatedly.
+
+    uint8_t pattern[96];
+    size_t j;
+    for (j = 0 ; j < sizeof(pattern) ; j++)
+    {
+        pattern[j] = value[j % 3];
+    }
+
+#if defined(SPAN_AVX2)
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(pattern));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *)(pattern + 32));
+    __m256i v2 = _mm256_loadu_si256((const __m256i *)(pattern + 64));
+    for ( ; i + 32 <= count ; i += 32)
+    {
+        uint8_t *p = dst + (3 * i);
+        _mm256_storeu_si256((__m256i *)(p), v0);
+        _mm256_storeu_si256((__m256i *)(p + 32), v1);
+        _mm256_storeu_si256((__m256i *)(p + 64), v2);
+    }
+#else
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(pattern));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(pattern + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(pattern + 32));
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        uint8_t *p = dst + (3 * i);
+        _mm_storeu_si128((__m128i *)(p), v0);
+        _mm_storeu_si128((__m128i *)(p + 16), v1);
+        _mm_storeu_si128((__m128i *)(p + 32), v2);
+    }
+#endif
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint8_t *p = dst + (3 * i);
+        p[0] = value[0];
+        p[1] = value[1];
+        p[2] = value[2];
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanFill32(
+    uint32_t *dst,
+    uint32_t value,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_NEON)
+    uint32x4_t v = vdupq_n_u32(value);
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        vst1q_u32(dst + i, v);
+        vst1q_u32(dst + i + 4, v);
+    }
+#elif defined(SPAN_AVX2)
+    __m256i v = _mm256_set1_epi32((int32_t)value);
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#elif defined(SPAN_SSE2)
+    __m128i v = _mm_set1_epi32((int32_t)value);
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 4), v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        dst[i] = value;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanFillPattern16(
+    uint16_t *dst,
+    const uint16_t pattern[8],
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_NEON)
+    uint16x8_t v = vld1q_u16(pattern);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        vst1q_u16(dst + i, v);
+        vst1q_u16(dst + i + 8, v);
+    }
+#elif defined(SPAN_AVX2)
+    __m128i p = _mm_loadu_si128((const __m128i *)pattern);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(p), p, 1);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+#elif defined(SPAN_SSE2)
+    __m128i v = _mm_loadu_si128((const __m128i *)pattern);
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), v);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        dst[i] = pattern[i & 7];
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static inline uint8_t
+gradientChannel(
+    int32_t value)
+{
+    value >>= 16;
+    return (value < 0) ? 0 : (value > 255) ? 255 : value;
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanGradientRGBA32(
+    uint8_t *dst,
+    const int32_t colour[4],
+    const int32_t step[4],
+    size_t count)
+{
+    int32_t c[4] = { colour[0], colour[1], colour[2], colour[3] };
+    size_t i = 0;
+
+#if defined(SPAN_SSE2)
+    // Four pixels per iteration, one 32 bit lane per channel. The packs
+    // saturate exactly as gradientChannel() clamps.
+
+    if (count >= 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)step);
+        __m128i c0 = _mm_loadu_si128((const __m128i *)c);
+        __m128i c1 = _mm_add_epi32(c0, s);
+        __m128i c2 = _mm_add_epi32(c1, s);
+        __m128i c3 = _mm_add_epi32(c2, s);
+        __m128i s4 = _mm_slli_epi32(s, 2);
+
+        for ( ; i + 4 <= count ; i += 4)
+        {
+            __m128i lo = _mm_packs_epi32(_mm_srai_epi32(c0, 16),
+                                         _mm_srai_epi32(c1, 16));
+            __m128i hi = _mm_packs_epi32(_mm_srai_epi32(c2, 16),
+                                         _mm_srai_epi32(c3, 16));
+
+            _mm_storeu_si128((__m128i *)(dst + (4 * i)),
+                             _mm_packus_epi16(lo, hi));
+
+            c0 = _mm_add_epi32(c0, s4);
+            c1 = _mm_add_epi32(c1, s4);
+            c2 = _mm_add_epi32(c2, s4);
+            c3 = _mm_add_epi32(c3, s4);
+        }
+
+        _mm_storeu_si128((__m128i *)c, c0);
+    }
+#elif defined(SPAN_NEON)
+    if (count >= 4)
+    {
+        int32x4_t s = vld1q_s32(step);
+        int32x4_t c0 = vld1q_s32(c);
+        int32x4_t c1 = vaddq_s32(c0, s);
+        int32x4_t c2 = vaddq_s32(c1, s);
+        int32x4_t c3 = vaddq_s32(c2, s);
+        int32x4_t s4 = vshlq_n_s32(s, 2);
+
+        for ( ; i + 4 <= count ; i += 4)
+        {
+            uint16x8_t lo = vcombine_u16(vqmovun_s32(vshrq_n_s32(c0, 16)),
+                                         vqmovun_s32(vshrq_n_s32(c1, 16)));
+            uint16x8_t hi = vcombine_u16(vqmovun_s32(vshrq_n_s32(c2, 16)),
+                                         vqmovun_s32(vshrq_n_s32(c3, 16)));
+
+            vst1q_u8(dst + (4 * i), vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+
+            c0 = vaddq_s32(c0, s4);
+            c1 = vaddq_s32(c1, s4);
+            c2 = vaddq_s32(c2, s4);
+            c3 = vaddq_s32(c3, s4);
+        }
+
+        vst1q_s32(c, c0);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint8_t *p = dst + (4 * i);
+
+        p[0] = gradientChannel(c[0]);
+        p[1] = gradientChannel(c[1]);
+        p[2] = gradientChannel(c[2]);
+        p[3] = gradientChannel(c[3]);
+
+        c[0] += step[0];
+        c[1] += step[1];
+        c[2] += step[2];
+        c[3] += step[3];
+    }
+}
+
+//-------------------------------------------------------------------------
+//
+// glyphMask[bits] has byte n set to 0xFF when the pixel n from the left of
+// an eight pixel glyph row is set, so a row becomes a mask for eight 8 bit
+// pixels in one lookup (the byte order assumes a little endian CPU, which
+// the Raspberry Pi and x86 are). The vector kernels widen it to 16 and 32
+// bit pixels by sign extension.
+//
+//-------------------------------------------------------------------------
+
+#define GLYPH_BIT(b, n) ((((b) >> (7 - (n))) & 1) ? (UINT64_C(0xFF) << (8 * (n))) : 0)
+
+#define GLYPH_MASK(b) \
+    (GLYPH_BIT(b, 0) | GLYPH_BIT(b, 1) | GLYPH_BIT(b, 2) | GLYPH_BIT(b, 3) | \
+     GLYPH_BIT(b, 4) | GLYPH_BIT(b, 5) | GLYPH_BIT(b, 6) | GLYPH_BIT(b, 7))
+
+#define GLYPH_MASK4(b) \
+    GLYPH_MASK(b), GLYPH_MASK(b + 1), GLYPH_MASK(b + 2), GLYPH_MASK(b + 3)
+
+#define GLYPH_MASK16(b) \
+    GLYPH_MASK4(b), GLYPH_MASK4(b + 4), GLYPH_MASK4(b + 8), GLYPH_MASK4(b + 12)
+
+static const uint64_t glyphMask[256] =
+{
+    GLYPH_MASK16(0), GLYPH_MASK16(16), GLYPH_MASK16(32), GLYPH_MASK16(48),
+    GLYPH_MASK16(64), GLYPH_MASK16(80), GLYPH_MASK16(96), GLYPH_MASK16(112),
+    GLYPH_MASK16(128), GLYPH_MASK16(144), GLYPH_MASK16(160), GLYPH_MASK16(176),
+    GLYPH_MASK16(192), GLYPH_MASK16(208), GLYPH_MASK16(224), GLYPH_MASK16(240)
+};
+
+//-------------------------------------------------------------------------
+
+void
+spanGlyph8(
+    uint8_t *dst,
+    size_t pitch,
+    uint8_t value,
+    const uint8_t *rows,
+    size_t count)
+{
+    uint64_t v = UINT64_C(0x0101010101010101) * value;
+
+    size_t i;
+    for (i = 0 ; i < count ; i++, dst += pitch)
+    {
+        if (rows[i] != 0)
+        {
+            uint64_t m = glyphMask[rows[i]];
+            uint64_t d;
+
+            memcpy(&d, dst, sizeof(d));
+            d = (d & ~m) | (v & m);
+            memcpy(dst, &d, sizeof(d));
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanGlyph16(
+    uint16_t *dst,
+    size_t pitch,
+    uint16_t value,
+    const uint8_t *rows,
+    size_t count)
+{
+    uint8_t *line = (uint8_t *)dst;
+
+#if defined(SPAN_NEON)
+    uint16x8_t v = vdupq_n_u16(value);
+#elif defined(SPAN_SSE2)
+    __m128i v = _mm_set1_epi16((int16_t)value);
+#endif
+
+    size_t i;
+    for (i = 0 ; i < count ; i++, line += pitch)
+    {
+        if (rows[i] == 0)
+        {
+            continue;
+        }
+
+        uint16_t *p = (uint16_t *)line;
+
+#if defined(SPAN_NEON)
+        int8x8_t m8 = vreinterpret_s8_u64(vld1_u64(glyphMask + rows[i]));
+        uint16x8_t m = vreinterpretq_u16_s16(vmovl_s8(m8));
+        vst1q_u16(p, vbslq_u16(m, v, vld1q_u16(p)));
+#elif defined(SPAN_SSE2)
+        __m128i m = _mm_loadl_epi64((const __m128i *)(glyphMask + rows[i]));
+        m = _mm_unpacklo_epi8(m, m);
+        __m128i d = _mm_loadu_si128((const __m128i *)p);
+        d = _mm_or_si128(_mm_and_si128(m, v), _mm_andnot_si128(m, d));
+        _mm_storeu_si128((__m128i *)p, d);
+#else
+        int j;
+        for (j = 0 ; j < 8 ; j++)
+        {
+            if (rows[i] & (0x80 >> j))
+            {
+                p[j] = value;
+            }
+        }
+#endif
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanGlyph24(
+    uint8_t *dst,
+    size_t pitch,
+    const uint8_t value[3],
+    const uint8_t *rows,
+    size_t count)
+{
+    // Three byte pixels do not line up with the vector lanes, so each set
+    // bit is stored on its own.
+
+    size_t i;
+    for (i = 0 ; i < count ; i++, dst += pitch)
+    {
+        uint8_t bits = rows[i];
+        uint8_t *p = dst;
+
+        for ( ; bits != 0 ; bits <<= 1, p += 3)
+        {
+            if (bits & 0x80)
+            {
+                p[0] = value[0];
+                p[1] = value[1];
+                p[2] = value[2];
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanGlyph32(
+    uint32_t *dst,
+    size_t pitch,
+    uint32_t value,
+    const uint8_t *rows,
+    size_t count)
+{
+    uint8_t *line = (uint8_t *)dst;
+
+#if defined(SPAN_NEON)
+    uint32x4_t v = vdupq_n_u32(value);
+#elif defined(SPAN_AVX2)
+    __m256i v = _mm256_set1_epi32((int32_t)value);
+#elif defined(SPAN_SSE2)
+    __m128i v = _mm_set1_epi32((int32_t)value);
+#endif
+
+    size_t i;
+    for (i = 0 ; i < count ; i++, line += pitch)
+    {
+        if (rows[i] == 0)
+        {
+            continue;
+        }
+
+        uint32_t *p = (uint32_t *)line;
+
+#if defined(SPAN_NEON)
+        int8x8_t m8 = vreinterpret_s8_u64(vld1_u64(glyphMask + rows[i]));
+        int16x8_t m16 = vmovl_s8(m8);
+        uint32x4_t m0 = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(m16)));
+        uint32x4_t m1 = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(m16)));
+        vst1q_u32(p, vbslq_u32(m0, v, vld1q_u32(p)));
+        vst1q_u32(p + 4, vbslq_u32(m1, v, vld1q_u32(p + 4)));
+#elif defined(SPAN_AVX2)
+        __m128i m8 = _mm_loadl_epi64((const __m128i *)(glyphMask + rows[i]));
+        _mm256_maskstore_epi32((int *)p, _mm256_cvtepi8_epi32(m8), v);
+#elif defined(SPAN_SSE2)
+        __m128i m = _mm_loadl_epi64((const __m128i *)(glyphMask + rows[i]));
+        m = _mm_unpacklo_epi8(m, m);
+        __m128i m0 = _mm_unpacklo_epi16(m, m);
+        __m128i m1 = _mm_unpackhi_epi16(m, m);
+        __m128i d0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i d1 = _mm_loadu_si128((const __m128i *)(p + 4));
+        d0 = _mm_or_si128(_mm_and_si128(m0, v), _mm_andnot_si128(m0, d0));
+        d1 = _mm_or_si128(_mm_and_si128(m1, v), _mm_andnot_si128(m1, d1));
+        _mm_storeu_si128((__m128i *)p, d0);
+        _mm_storeu_si128((__m128i *)(p + 4), d1);
+#else
+        int j;
+        for (j = 0 ; j < 8 ; j++)
+        {
+            if (rows[i] & (0x80 >> j))
+            {
+                p[j] = value;
+            }
+        }
+#endif
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static inline uint32_t
+coverageAlpha(
+    const uint8_t *coverage,
+    size_t i,
+    uint8_t alpha)
+{
+    if (coverage == NULL)
+    {
+        return alpha;
+    }
+
+    uint32_t t = coverage[i] * alpha;
+    return DIV255(t);
+}
+
+//-------------------------------------------------------------------------
+
+static inline uint8_t
+blendChannel(
+    uint8_t dst,
+    uint8_t src,
+    uint32_t alpha)
+{
+    uint32_t t = (dst * (255 - alpha)) + (src * alpha);
+    return DIV255(t);
+}
+
+//-------------------------------------------------------------------------
+
+#if defined(SPAN_SSE2)
+
+static inline __m128i
+div255Epi16(
+    __m128i t)
+{
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static inline __m128i
+blendEpi16(
+    __m128i dst,
+    __m128i src,
+    __m128i alpha)
+{
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, inverse),
+                              _mm_mullo_epi16(src, alpha));
+    return div255Epi16(t);
+}
+
+static inline __m128i
+coverageAlphaEpi16(
+    const uint8_t *coverage,
+    size_t i,
+    __m128i alpha)
+{
+    if (coverage == NULL)
+    {
+        return alpha;
+    }
+
+    __m128i c = _mm_loadl_epi64((const __m128i *)(coverage + i));
+    c = _mm_unpacklo_epi8(c, _mm_setzero_si128());
+    return div255Epi16(_mm_mullo_epi16(c, alpha));
+}
+
+#elif defined(SPAN_NEON)
+
+static inline uint8x8_t
+div255U16(
+    uint16x8_t t)
+{
+    return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+static inline uint8x8_t
+blendU8(
+    uint8x8_t dst,
+    uint8x8_t src,
+    uint8x8_t alpha)
+{
+    uint16x8_t t = vmull_u8(dst, vmvn_u8(alpha));
+    t = vmlal_u8(t, src, alpha);
+    return div255U16(t);
+}
+
+static inline uint8x8_t
+coverageAlphaU8(
+    const uint8_t *coverage,
+    size_t i,
+    uint8x8_t alpha)
+{
+    if (coverage == NULL)
+    {
+        return alpha;
+    }
+
+    return div255U16(vmull_u8(vld1_u8(coverage + i), alpha));
+}
+
+#endif
+
+//-------------------------------------------------------------------------
+
+void
+spanBlendRGBA16(
+    uint16_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_SSE2)
+    const __m128i alpha = _mm_set1_epi16(colour[3]);
+    const __m128i red = _mm_set1_epi16(colour[0]);
+    const __m128i green = _mm_set1_epi16(colour[1]);
+    const __m128i blue = _mm_set1_epi16(colour[2]);
+    const __m128i high = _mm_set1_epi16(0x00F0);
+    const __m128i low = _mm_set1_epi16(0x000F);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        __m128i a = coverageAlphaEpi16(coverage, i, alpha);
+        __m128i p = _mm_loadu_si128((const __m128i *)(dst + i));
+
+        __m128i r = _mm_and_si128(_mm_srli_epi16(p, 8), high);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(p, 4), high);
+        __m128i b = _mm_and_si128(p, high);
+
+        r = _mm_and_si128(blendEpi16(r, red, a), high);
+        g = _mm_and_si128(blendEpi16(g, green, a), high);
+        b = _mm_and_si128(blendEpi16(b, blue, a), high);
+
+        p = _mm_or_si128(_mm_and_si128(p, low), b);
+        p = _mm_or_si128(p, _mm_slli_epi16(g, 4));
+        p = _mm_or_si128(p, _mm_slli_epi16(r, 8));
+
+        _mm_storeu_si128((__m128i *)(dst + i), p);
+    }
+#elif defined(SPAN_NEON)
+    const uint8x8_t alpha = vdup_n_u8(colour[3]);
+    const uint16x8_t red = vdupq_n_u16(colour[0]);
+    const uint16x8_t green = vdupq_n_u16(colour[1]);
+    const uint16x8_t blue = vdupq_n_u16(colour[2]);
+    const uint16x8_t high = vdupq_n_u16(0x00F0);
+    const uint16x8_t low = vdupq_n_u16(0x000F);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint16x8_t a = vmovl_u8(coverageAlphaU8(coverage, i, alpha));
+        uint16x8_t inverse = vsubq_u16(vdupq_n_u16(255), a);
+        uint16x8_t p = vld1q_u16(dst + i);
+
+        uint16x8_t r = vandq_u16(vshrq_n_u16(p, 8), high);
+        uint16x8_t g = vandq_u16(vshrq_n_u16(p, 4), high);
+        uint16x8_t b = vandq_u16(p, high);
+
+        r = vmlaq_u16(vmulq_u16(r, inverse), red, a);
+        g = vmlaq_u16(vmulq_u16(g, inverse), green, a);
+        b = vmlaq_u16(vmulq_u16(b, inverse), blue, a);
+
+        r = vandq_u16(vmovl_u8(div255U16(r)), high);
+        g = vandq_u16(vmovl_u8(div255U16(g)), high);
+        b = vandq_u16(vmovl_u8(div255U16(b)), high);
+
+        p = vorrq_u16(vandq_u16(p, low), b);
+        p = vorrq_u16(p, vshlq_n_u16(g, 4));
+        p = vorrq_u16(p, vshlq_n_u16(r, 8));
+
+        vst1q_u16(dst + i, p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint32_t a = coverageAlpha(coverage, i, colour[3]);
+        uint16_t p = dst[i];
+
+        uint8_t r = blendChannel((p >> 8) & 0xF0, colour[0], a);
+        uint8_t g = blendChannel((p >> 4) & 0xF0, colour[1], a);
+        uint8_t b = blendChannel(p & 0xF0, colour[2], a);
+
+        dst[i] = ((r >> 4) << 12) | ((g >> 4) << 8) | ((b >> 4) << 4) | (p & 0xF);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanBlendRGB888(
+    uint8_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_SSE2)
+    const __m128i alpha = _mm_set1_epi16(colour[3]);
+    const __m128i zero = _mm_setzero_si128();
+
+    uint8_t pattern[48];
+    size_t j;
+    for (j = 0 ; j < sizeof(pattern) ; j++)
+    {
+        pattern[j] = colour[j % 3];
+    }
+
+    for ( ; i + 16 <= count ; i += 16)
+    {
+        // work out the alpha for 16 pixels at once, then spread each one
+        // over the three bytes of its pixel.
+
+        uint8_t alphas[48];
+        uint8_t a[16];
+
+        __m128i aLo = coverageAlphaEpi16(coverage, i, alpha);
+        __m128i aHi = coverageAlphaEpi16(coverage, i + 8, alpha);
+        _mm_storeu_si128((__m128i *)a, _mm_packus_epi16(aLo, aHi));
+
+        for (j = 0 ; j < 16 ; j++)
+        {
+            alphas[3 * j] = alphas[(3 * j) + 1] = alphas[(3 * j) + 2] = a[j];
+        }
+
+        uint8_t *p = dst + (3 * i);
+
+        for (j = 0 ; j < 48 ; j += 16)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i *)(p + j));
+            __m128i s = _mm_loadu_si128((const __m128i *)(pattern + j));
+            __m128i b = _mm_loadu_si128((const __m128i *)(alphas + j));
+
+            __m128i lo = blendEpi16(_mm_unpacklo_epi8(d, zero),
+                                    _mm_unpacklo_epi8(s, zero),
+                                    _mm_unpacklo_epi8(b, zero));
+            __m128i hi = blendEpi16(_mm_unpackhi_epi8(d, zero),
+                                    _mm_unpackhi_epi8(s, zero),
+                                    _mm_unpackhi_epi8(b, zero));
+
+            _mm_storeu_si128((__m128i *)(p + j), _mm_packus_epi16(lo, hi));
+        }
+    }
+#elif defined(SPAN_NEON)
+    const uint8x8_t alpha = vdup_n_u8(colour[3]);
+    const uint8x8_t red = vdup_n_u8(colour[0]);
+    const uint8x8_t green = vdup_n_u8(colour[1]);
+    const uint8x8_t blue = vdup_n_u8(colour[2]);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8_t a = coverageAlphaU8(coverage, i, alpha);
+        uint8x8x3_t p = vld3_u8(dst + (3 * i));
+
+        p.val[0] = blendU8(p.val[0], red, a);
+        p.val[1] = blendU8(p.val[1], green, a);
+        p.val[2] = blendU8(p.val[2], blue, a);
+
+        vst3_u8(dst + (3 * i), p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint32_t a = coverageAlpha(coverage, i, colour[3]);
+        uint8_t *p = dst + (3 * i);
+
+        p[0] = blendChannel(p[0], colour[0], a);
+        p[1] = blendChannel(p[1], colour[1], a);
+        p[2] = blendChannel(p[2], colour[2], a);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+spanBlendRGBA32(
+    uint8_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count)
+{
+    size_t i = 0;
+
+#if defined(SPAN_SSE2)
+    // Four pixels per iteration. The alpha lane of each pixel is given a
+    // weight of zero so the destination alpha is left as it was.
+
+    const __m128i alpha = _mm_set1_epi16(colour[3]);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgbMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i src = _mm_set_epi16(0, colour[2], colour[1], colour[0],
+                                      0, colour[2], colour[1], colour[0]);
+
+    for ( ; i + 4 <= count ; i += 4)
+    {
+        __m128i a = alpha;
+
+        if (coverage != NULL)
+        {
+            uint32_t c;
+            memcpy(&c, coverage + i, sizeof(c));
+            a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c), zero);
+            a = div255Epi16(_mm_mullo_epi16(a, alpha));
+        }
+
+        a = _mm_unpacklo_epi16(a, a);
+        __m128i aLo = _mm_and_si128(_mm_unpacklo_epi32(a, a), rgbMask);
+        __m128i aHi = _mm_and_si128(_mm_unpackhi_epi32(a, a), rgbMask);
+
+        uint8_t *p = dst + (4 * i);
+        __m128i d = _mm_loadu_si128((const __m128i *)p);
+
+        __m128i lo = blendEpi16(_mm_unpacklo_epi8(d, zero), src, aLo);
+        __m128i hi = blendEpi16(_mm_unpackhi_epi8(d, zero), src, aHi);
+
+        _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(lo, hi));
+    }
+#elif defined(SPAN_NEON)
+    const uint8x8_t alpha = vdup_n_u8(colour[3]);
+    const uint8x8_t red = vdup_n_u8(colour[0]);
+    const uint8x8_t green = vdup_n_u8(colour[1]);
+    const uint8x8_t blue = vdup_n_u8(colour[2]);
+
+    for ( ; i + 8 <= count ; i += 8)
+    {
+        uint8x8_t a = coverageAlphaU8(coverage, i, alpha);
+        uint8x8x4_t p = vld4_u8(dst + (4 * i));
+
+        p.val[0] = blendU8(p.val[0], red, a);
+        p.val[1] = blendU8(p.val[1], green, a);
+        p.val[2] = blendU8(p.val[2], blue, a);
+
+        vst4_u8(dst + (4 * i), p);
+    }
+#endif
+
+    for ( ; i < count ; i++)
+    {
+        uint32_t a = coverageAlpha(coverage, i, colour[3]);
+        uint8_t *p = dst + (4 * i);
+
+        p[0] = blendChannel(p[0], colour[0], a);
+        p[1] = blendChannel(p[1], colour[1], a);
+        p[2] = blendChannel(p[2], colour[2], a);
+    }
+}
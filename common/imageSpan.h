@@ -0,0 +1,169 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_SPAN_H
+#define IMAGE_SPAN_H
+
+//-------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+//
+// Span kernels write a run of identical pixels into a single row. The
+// implementation is selected at compile time: NEON on the Raspberry Pi
+// (when built with -mfpu=neon), AVX2 or SSE2 on x86 build hosts and a
+// portable scalar version everywhere else.
+//
+//-------------------------------------------------------------------------
+
+const char *
+spanImplementation(void);
+
+void
+spanFill8(
+    uint8_t *dst,
+    uint8_t value,
+    size_t count);
+
+void
+spanFill16(
+    uint16_t *dst,
+    uint16_t value,
+    size_t count);
+
+void
+spanFill24(
+    uint8_t *dst,
+    const uint8_t value[3],
+    size_t count);
+
+void
+spanFill32(
+    uint32_t *dst,
+    uint32_t value,
+    size_t count);
+
+// Fill with eight 16 bit pixels repeated along the row, as used for the
+// ordered dither of a solid colour. pattern[0] is written to dst[0].
+
+void
+spanFillPattern16(
+    uint16_t *dst,
+    const uint16_t pattern[8],
+    size_t count);
+
+// Fill with a colour that changes by a constant step from pixel to pixel.
+// colour (red, green, blue, alpha) is the first pixel and step is added
+// for each pixel after it, both in 16.16 fixed point. Each channel is
+// clamped to 0 to 255 as it is written.
+
+void
+spanGradientRGBA32(
+    uint8_t *dst,
+    const int32_t colour[4],
+    const int32_t step[4],
+    size_t count);
+
+//-------------------------------------------------------------------------
+//
+// Glyph kernels write value into the pixels of a 1 bit per pixel bitmap
+// eight pixels wide, such as a row of the simple font. rows holds count
+// bytes, one per row with the leftmost pixel in the most significant bit.
+// Pixels whose bit is clear are left alone. pitch is the length of a
+// destination row in bytes, and all eight pixels of each row must be
+// inside the image.
+//
+//-------------------------------------------------------------------------
+
+void
+spanGlyph8(
+    uint8_t *dst,
+    size_t pitch,
+    uint8_t value,
+    const uint8_t *rows,
+    size_t count);
+
+void
+spanGlyph16(
+    uint16_t *dst,
+    size_t pitch,
+    uint16_t value,
+    const uint8_t *rows,
+    size_t count);
+
+void
+spanGlyph24(
+    uint8_t *dst,
+    size_t pitch,
+    const uint8_t value[3],
+    const uint8_t *rows,
+    size_t count);
+
+void
+spanGlyph32(
+    uint32_t *dst,
+    size_t pitch,
+    uint32_t value,
+    const uint8_t *rows,
+    size_t count);
+
+//-------------------------------------------------------------------------
+//
+// Blend kernels mix colour (red, green, blue, alpha) into a run of pixels.
+// coverage holds one weight (0 to 255) per pixel that scales the alpha of
+// colour, as produced by an antialiased rasteriser or a glyph bitmap; pass
+// NULL to blend every pixel with the alpha of colour alone. The alpha of
+// the destination pixels is left unchanged.
+//
+//-------------------------------------------------------------------------
+
+void
+spanBlendRGBA16(
+    uint16_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count);
+
+void
+spanBlendRGB888(
+    uint8_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count);
+
+void
+spanBlendRGBA32(
+    uint8_t *dst,
+    const uint8_t colour[4],
+    const uint8_t *coverage,
+    size_t count);
+
+//-------------------------------------------------------------------------
+
+#endif
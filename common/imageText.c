@@ -0,0 +1,380 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "imageBuffer.h"
+#include "imageText.h"
+
+#ifdef DMALLOC
+#include "dmalloc.h"
+#endif
+
+//-------------------------------------------------------------------------
+
+void
+initImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache,
+    size_t budget)
+{
+    cache->budget = budget;
+    cache->used = 0;
+    memset(cache->buckets, 0, sizeof(cache->buckets));
+    cache->newest = NULL;
+    cache->oldest = NULL;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+removeImageText(
+    IMAGE_TEXT_CACHE_T *cache,
+    IMAGE_TEXT_T *text)
+{
+    IMAGE_TEXT_T **link = &(cache->buckets[text->hash % IMAGE_TEXT_BUCKETS]);
+
+    while (*link != text)
+    {
+        link = &((*link)->next);
+    }
+    *link = text->next;
+
+    if (text->newer != NULL)
+    {
+        text->newer->older = text->older;
+    }
+    else
+    {
+        cache->newest = text->older;
+    }
+
+    if (text->older != NULL)
+    {
+        text->older->newer = text->newer;
+    }
+    else
+    {
+        cache->oldest = text->newer;
+    }
+
+    cache->used -= text->bytes;
+
+    destroyImage(&(text->mask));
+    free(text);
+}
+
+//-------------------------------------------------------------------------
+
+void
+flushImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache)
+{
+    while (cache->oldest != NULL)
+    {
+        removeImageText(cache, cache->oldest);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+void
+destroyImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache)
+{
+    flushImageTextCache(cache);
+    initImageTextCache(cache, 0);
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t
+hashImageText(
+    const char *string,
+    int32_t font,
+    int32_t size)
+{
+    // FNV-1a
+
+    uint32_t hash = 2166136261u;
+
+    while (*string != '\0')
+    {
+        hash = (hash ^ (uint8_t)(*string++)) * 16777619u;
+    }
+
+    hash = (hash ^ (uint32_t)font) * 16777619u;
+    hash = (hash ^ (uint32_t)size) * 16777619u;
+
+    return hash;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+makeNewest(
+    IMAGE_TEXT_CACHE_T *cache,
+    IMAGE_TEXT_T *text)
+{
+    text->older = cache->newest;
+    text->newer = NULL;
+
+    if (cache->newest != NULL)
+    {
+        cache->newest->newer = text;
+    }
+    else
+    {
+        cache->oldest = text;
+    }
+
+    cache->newest = text;
+}
+
+//-------------------------------------------------------------------------
+
+IMAGE_TEXT_T *
+findImageText(
+    IMAGE_TEXT_CACHE_T *cache,
+    const char *string,
+    int32_t font,
+    int32_t size)
+{
+    uint32_t hash = hashImageText(string, font, size);
+    IMAGE_TEXT_T *text = cache->buckets[hash % IMAGE_TEXT_BUCKETS];
+
+    while ((text != NULL) &&
+           ((text->hash != hash) ||
+            (text->font != font) ||
+            (text->size != size) ||
+            (strcmp(text->string, string) != 0)))
+    {
+        text = text->next;
+    }
+
+    if ((text != NULL) && (text != cache->newest))
+    {
+        // Move it to the newest end of the list.
+
+        text->newer->older = text->older;
+
+        if (text->older != NULL)
+        {
+            text->older->newer = text->newer;
+        }
+        else
+        {
+            cache->oldest = text->newer;
+        }
+
+        makeNewest(cache, text);
+    }
+
+    return text;
+}
+
+//-------------------------------------------------------------------------
+
+IMAGE_TEXT_T *
+addImageText(
+    IMAGE_TEXT_CACHE_T *cache,
+    const char *string,
+    int32_t font,
+    int32_t size,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+    if ((width <= 0) || (height <= 0))
+    {
+        return NULL;
+    }
+
+    size_t length = strlen(string) + 1;
+    size_t rows = height * sizeof(IMAGE_TEXT_ROW_T);
+    IMAGE_TEXT_T *text = malloc(sizeof(IMAGE_TEXT_T) + rows + length);
+
+    if (text == NULL)
+    {
+        fprintf(stderr, "imageText: memory exhausted\n");
+        exit(EXIT_FAILURE);
+    }
+
+    initImage(&(text->mask), VC_IMAGE_8BPP, width, height, false);
+
+    // The mask buffer is counted as allocated, rounding and all.
+
+    text->bytes = sizeof(IMAGE_TEXT_T)
+                + rows
+                + length
+                + getImageBufferCapacity(text->mask.buffer);
+
+    if (text->bytes > cache->budget)
+    {
+        destroyImage(&(text->mask));
+        free(text);
+        return NULL;
+    }
+
+    while (cache->used + text->bytes > cache->budget)
+    {
+        removeImageText(cache, cache->oldest);
+    }
+
+    text->rows = (IMAGE_TEXT_ROW_T *)(text + 1);
+    text->scanned = false;
+
+    char *copy = (char *)(text->rows + height);
+    memcpy(copy, string, length);
+
+    text->string = copy;
+    text->font = font;
+    text->size = size;
+    text->hash = hashImageText(string, font, size);
+    text->x = x;
+    text->y = y;
+
+    clearImageIndexed(&(text->mask), 0);
+
+    IMAGE_TEXT_T **bucket = &(cache->buckets[text->hash % IMAGE_TEXT_BUCKETS]);
+    text->next = *bucket;
+    *bucket = text;
+
+    makeNewest(cache, text);
+    cache->used += text->bytes;
+
+    return text;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+scanImageText(
+    IMAGE_TEXT_T *text)
+{
+    int32_t left = text->mask.width;
+    int32_t right = 0;
+    int32_t top = text->mask.height;
+    int32_t bottom = 0;
+
+    int32_t j;
+    for (j = 0 ; j < text->mask.height ; j++)
+    {
+        const uint8_t *coverage = (const uint8_t *)(text->mask.buffer)
+                                + (j * text->mask.pitch);
+
+        int32_t first = 0;
+        int32_t end = text->mask.width;
+
+        while ((first < end) && (coverage[first] == 0))
+        {
+            ++first;
+        }
+
+        while ((end > first) && (coverage[end - 1] == 0))
+        {
+            --end;
+        }
+
+        text->rows[j].first = first;
+        text->rows[j].count = end - first;
+
+        if (end > first)
+        {
+            if (first < left) left = first;
+            if (end > right) right = end;
+            if (j < top) top = j;
+            bottom = j + 1;
+        }
+    }
+
+    text->ink.x = left;
+    text->ink.y = top;
+    text->ink.width = (right > left) ? right - left : 0;
+    text->ink.height = (bottom > top) ? bottom - top : 0;
+    text->scanned = true;
+}
+
+//-------------------------------------------------------------------------
+
+void
+drawImageTextRGB(
+    IMAGE_TEXT_T *text,
+    int32_t x,
+    int32_t y,
+    const RGBA8_T *rgb,
+    IMAGE_T *image)
+{
+    if (text->scanned == false)
+    {
+        scanImageText(text);
+    }
+
+    x += text->x;
+    y += text->y;
+
+    VC_RECT_T box =
+    {
+        .x = x + text->ink.x,
+        .y = y + text->ink.y,
+        .width = text->ink.width,
+        .height = text->ink.height
+    };
+
+    if ((image->blendSpan == NULL) ||
+        (box.width == 0) ||
+        (clipImageRect(image, &box) == false))
+    {
+        return;
+    }
+
+    int32_t j;
+    for (j = box.y ; j < box.y + box.height ; j++)
+    {
+        const IMAGE_TEXT_ROW_T *row = &(text->rows[j - y]);
+
+        int32_t first = x + row->first;
+        int32_t end = first + row->count;
+
+        if (first < box.x) first = box.x;
+        if (end > box.x + box.width) end = box.x + box.width;
+
+        if (end > first)
+        {
+            const uint8_t *coverage = (const uint8_t *)(text->mask.buffer)
+                                    + ((j - y) * text->mask.pitch)
+                                    + (first - x);
+
+            image->blendSpan(image, first, j, end - first, rgb, coverage);
+        }
+    }
+
+    markImageDirty(image, box.x, box.y, box.width, box.height);
+}
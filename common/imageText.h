@@ -0,0 +1,148 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef IMAGE_TEXT_H
+#define IMAGE_TEXT_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+//-------------------------------------------------------------------------
+//
+// A text cache keeps strings that have been drawn as coverage masks, so
+// text that is drawn again, such as a label drawn every frame, costs only
+// one blend of the covered part of each row of its mask. A string is found by its text, font
+// and size. The colour is applied when the mask is drawn, so one mask
+// serves every colour. The masks are kept within a budget of bytes, which
+// counts each mask buffer as allocated (see getImageBufferCapacity()), and
+// the least recently drawn are freed to make room for new ones.
+//
+// FreeType text is drawn through a cache with draw_FT_CachedStringRGB()
+// in freetype_font.h. The simple font has no cached version, as its glyphs
+// are already written a row at a time with masked stores, which is faster
+// than any blit of a cached mask.
+//
+//-------------------------------------------------------------------------
+
+#define IMAGE_TEXT_BUCKETS 64
+
+// The covered pixels of a row of a mask, found the first time it is drawn.
+
+typedef struct
+{
+    int32_t first;
+    int32_t count;	// 0 if the row is empty
+} IMAGE_TEXT_ROW_T;
+
+typedef struct IMAGE_TEXT_T_ IMAGE_TEXT_T;
+
+struct IMAGE_TEXT_T_
+{
+    const char *string;
+    int32_t font;
+    int32_t size;
+    uint32_t hash;
+    int32_t x;		// position of the mask from where the text is drawn
+    int32_t y;
+    IMAGE_T mask;	// VC_IMAGE_8BPP coverage
+    bool scanned;	// rows and ink have been found
+    IMAGE_TEXT_ROW_T *rows;	// one for each row of the mask
+    VC_RECT_T ink;	// the covered part of the mask
+    size_t bytes;	// counted against the budget
+    IMAGE_TEXT_T *next;	// in the same bucket
+    IMAGE_TEXT_T *newer;	// least recently used order
+    IMAGE_TEXT_T *older;
+};
+
+typedef struct
+{
+    size_t budget;
+    size_t used;
+    IMAGE_TEXT_T *buckets[IMAGE_TEXT_BUCKETS];
+    IMAGE_TEXT_T *newest;
+    IMAGE_TEXT_T *oldest;
+} IMAGE_TEXT_CACHE_T;
+
+//-------------------------------------------------------------------------
+
+void
+initImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache,
+    size_t budget);
+
+void
+flushImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache);
+
+void
+destroyImageTextCache(
+    IMAGE_TEXT_CACHE_T *cache);
+
+// Find a string, and make it the most recently used. Returns NULL if it
+// is not in the cache.
+
+IMAGE_TEXT_T *
+findImageText(
+    IMAGE_TEXT_CACHE_T *cache,
+    const char *string,
+    int32_t font,
+    int32_t size);
+
+// Add a string with a cleared mask for the caller to draw into, before
+// it is first drawn. Older strings are freed to keep within the budget.
+// Returns NULL if the mask would not fit in the budget by itself.
+
+IMAGE_TEXT_T *
+addImageText(
+    IMAGE_TEXT_CACHE_T *cache,
+    const char *string,
+    int32_t font,
+    int32_t size,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+
+// Blend the covered part of each row of the mask, clipped once, and mark
+// the area dirty once.
+
+void
+drawImageTextRGB(
+    IMAGE_TEXT_T *text,
+    int32_t x,
+    int32_t y,
+    const RGBA8_T *rgb,
+    IMAGE_T *image);
+
+//-------------------------------------------------------------------------
+
+#endif
@@ -32,6 +32,7 @@
 #include "bcm_host.h"
 
 #include "image.h"
+#include "imageConvert.h"
 #include "loadpng.h"
 
 #ifdef DMALLOC
@@ -108,31 +109,15 @@ loadPng(
 
     png_bytepp row_pointers = png_get_rows(png_ptr, info_ptr);
 
-    int i,j;
-    RGBA8_T rgb;
+    int i;
+
+    if ((png_Bpp == 3) || (png_Bpp == 4)) {
+	VC_IMAGE_TYPE_T png_type = (png_Bpp == 3) ? VC_IMAGE_RGB888 : VC_IMAGE_RGBA32;
 
-    if (png_Bpp == 3) {
-	for (i=0; i < height; i++) {
-	    for (j=0; j < width; j++) {
-		png_bytep byt_s = row_pointers[i] + (j * 3);
-		rgb.red   = byt_s[0];
-		rgb.green = byt_s[1];
-		rgb.blue  = byt_s[2];
-		rgb.alpha = 255;
-		setPixelRGB( image, j, i, 1, &rgb );
-	    }
-	}
-    } else
-    if (png_Bpp == 4) {
 	for (i=0; i < height; i++) {
-	    for (j=0; j < width; j++) {
-		png_bytep byt_s = row_pointers[i] + (j * 4);
-		rgb.red   = byt_s[0];
-		rgb.green = byt_s[1];
-		rgb.blue  = byt_s[2];
-		rgb.alpha = byt_s[3];
-		setPixelRGB( image, j, i, 1, &rgb );
-	    }
+	    convertImageRow( png_type, row_pointers[i], 0,
+		image->type, image->buffer + (i * image->pitch), 0,
+		width, NULL );
 	}
     }
 
@@ -36,6 +36,7 @@
 #include <unistd.h>
 
 #include "image.h"
+#include "imageConvert.h"
 
 //-----------------------------------------------------------------------
 
@@ -57,24 +58,16 @@ pngWriteImageRGB565(
     int32_t y = 0;
     for (y = 0; y < image->height; y++)
     {
-        int32_t x = 0;
-        for (x = 0; x < image->width; x++)
-        {
-            uint16_t pixels = *(uint16_t*)(image->buffer +
-                                          (y * image->pitch) +
-                                          ((x * image->bitsPerPixel) / 8));
-            int32_t index = x * 3;
-
-            uint8_t r5 = (pixels >> 11) & 0x1F;
-            uint8_t g6 = (pixels >> 5) & 0x3F;
-            uint8_t b5 = (pixels) & 0x1F;
-
-            imageRow[index] =  (r5 << 3) | (r5 >> 2);
-            imageRow[index + 1] =  (g6 << 2) | (g6 >> 4);
-            imageRow[index + 2] =  (b5 << 3) | (b5 >> 2);
-        }
-        png_write_row(pngPtr, imageRow);
+        convertImageRow(image->type,
+                        image->buffer + (y * image->pitch),
+                        0,
+                        VC_IMAGE_RGB888,
+                        imageRow,
+                        0,
+                        image->width,
+                        NULL);
 
+        png_write_row(pngPtr, imageRow);
     }
 
     free(imageRow);
@@ -119,26 +112,16 @@ pngWriteImageRGBA16(
     int32_t y = 0;
     for (y = 0; y < image->height; y++)
     {
-        int32_t x = 0;
-        for (x = 0; x < image->width; x++)
-        {
-            uint16_t pixels = *(uint16_t*)(image->buffer +
-                                           (y * image->pitch) +
-                                           ((x * image->bitsPerPixel) / 8));
-            int32_t index = x * 4;
-
-            uint8_t r4 = (pixels >> 12) & 0xF;
-            uint8_t g4 = (pixels >> 8) & 0xF;
-            uint8_t b4 = (pixels >> 4) & 0xF;
-            uint8_t a4 = pixels & 0xF;
-
-            imageRow[index] =  (r4 << 4) | r4;
-            imageRow[index + 1] =  (g4 << 4) | g4;
-            imageRow[index + 2] =  (b4 << 4) | b4;
-            imageRow[index + 3] =  (a4 << 4) | a4;
-        }
-        png_write_row(pngPtr, imageRow);
+        convertImageRow(image->type,
+                        image->buffer + (y * image->pitch),
+                        0,
+                        VC_IMAGE_RGBA32,
+                        imageRow,
+                        0,
+                        image->width,
+                        NULL);
 
+        png_write_row(pngPtr, imageRow);
     }
 
     free(imageRow);
@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "element_change.h"
 #include "image.h"
@@ -38,6 +39,112 @@
 
 //-------------------------------------------------------------------------
 
+static int32_t
+wrapScrollingOffset(
+    int32_t offset,
+    int32_t max)
+{
+    if (max <= 0)
+    {
+        return 0;
+    }
+
+    offset %= max;
+
+    if (offset < 0)
+    {
+        offset += max;
+    }
+
+    return offset;
+}
+
+//-------------------------------------------------------------------------
+//
+// Split the view at the right and bottom edges of the wrapped area. The
+// columns (and rows) on the far side of the seam start again at zero in
+// the source, so the image never needs a duplicated copy of itself.
+
+static void
+layoutScrollingLayer(
+    SCROLLING_LAYER_T *sl)
+{
+    int32_t srcX[2] = { sl->xOffset, 0 };
+    int32_t srcY[2] = { sl->yOffset, 0 };
+    int32_t width[2] = { sl->viewWidth, 0 };
+    int32_t height[2] = { sl->viewHeight, 0 };
+    int32_t columns = 1;
+    int32_t rows = 1;
+
+    if (sl->xOffset + sl->viewWidth > sl->xOffsetMax)
+    {
+        width[0] = sl->xOffsetMax - sl->xOffset;
+        width[1] = sl->viewWidth - width[0];
+        columns = 2;
+    }
+
+    if (sl->yOffset + sl->viewHeight > sl->yOffsetMax)
+    {
+        height[0] = sl->yOffsetMax - sl->yOffset;
+        height[1] = sl->viewHeight - height[0];
+        rows = 2;
+    }
+
+    int32_t row = 0;
+    int32_t column = 0;
+    int32_t tiles = 0;
+
+    for (row = 0 ; row < rows ; row++)
+    {
+        for (column = 0 ; column < columns ; column++)
+        {
+            SCROLLING_LAYER_TILE_T *tile = &(sl->tile[tiles++]);
+
+            int result = vc_dispmanx_rect_set(&(tile->srcRect),
+                                              srcX[column] << 16,
+                                              srcY[row] << 16,
+                                              width[column] << 16,
+                                              height[row] << 16);
+            assert(result == 0);
+
+            result = vc_dispmanx_rect_set(&(tile->dstRect),
+                                          sl->dstOffsetX + column * width[0],
+                                          sl->dstOffsetY + row * height[0],
+                                          width[column],
+                                          height[row]);
+            assert(result == 0);
+        }
+    }
+
+    sl->tiles = tiles;
+}
+
+//-------------------------------------------------------------------------
+
+static void
+addTileScrollingLayer(
+    SCROLLING_LAYER_T *sl,
+    SCROLLING_LAYER_TILE_T *tile,
+    DISPMANX_RESOURCE_HANDLE_T resource,
+    DISPMANX_UPDATE_HANDLE_T update)
+{
+    VC_DISPMANX_ALPHA_T alpha = { DISPMANX_FLAGS_ALPHA_FROM_SOURCE, 255, 0 };
+
+    tile->element = vc_dispmanx_element_add(update,
+                                            sl->display,
+                                            sl->layer,
+                                            &(tile->dstRect),
+                                            resource,
+                                            &(tile->srcRect),
+                                            DISPMANX_PROTECTION_NONE,
+                                            &alpha,
+                                            NULL,
+                                            DISPMANX_NO_ROTATE);
+    assert(tile->element != 0);
+}
+
+//-------------------------------------------------------------------------
+
 void
 initScrollingLayerPNG(SCROLLING_LAYER_T *sl,
     const char* file,
@@ -47,16 +154,12 @@ initScrollingLayerPNG(SCROLLING_LAYER_T *sl,
 
     bool loaded = loadPng( sl->image, file);
 
-    int32_t max_x = sl->image->width;
-    int32_t max_y = sl->image->height;
-    if (loaded) expand_and_duplicate_Image( sl->image, sl->image->width, sl->image->height );
-
     if (loaded == false)
     {
         fprintf(stderr, "scrolling: unable to load %s\n", file);
         exit(EXIT_FAILURE);
     }
-    initScrollingLayerImage( sl, NULL, max_x, max_y, layer);
+    initScrollingLayerImage( sl, NULL, sl->image->width, sl->image->height, layer);
 }
 
 
@@ -77,7 +180,9 @@ initScrollingLayerImage(SCROLLING_LAYER_T *sl,
     sl->xStepper = sl->yStepper = 0;
     sl->image_write_flag = 1;
     sl->scroll_step_flag = 1;
-    sl->element = 0;
+    sl->display = 0;
+    sl->tiles = 0;
+    memset(sl->tile, 0, sizeof(sl->tile));
 
     uint32_t vc_image_ptr = 1;
 
@@ -163,33 +268,34 @@ addElementScrollingLayer(
     DISPMANX_DISPLAY_HANDLE_T display,
     DISPMANX_UPDATE_HANDLE_T update)
 {
-    int result = vc_dispmanx_rect_set(&sl->srcRect,
-                         sl->xOffset << 16,
-                         sl->yOffset << 16,
-                         sl->viewWidth << 16,
-                         sl->viewHeight << 16);
-    assert(result == 0);
+    // The offsets wrap at the max values, so these are the size of the
+    // repeating area and the view can be no larger than one copy of it.
 
-    result = vc_dispmanx_rect_set(&(sl->dstRect),
-                         sl->dstOffsetX,
-                         sl->dstOffsetY,
-                         sl->viewWidth,
-                         sl->viewHeight);
-    assert(result == 0);
+    if (sl->xOffsetMax <= 0 || sl->xOffsetMax > sl->image->width)
+    {
+        sl->xOffsetMax = sl->image->width;
+    }
 
-    VC_DISPMANX_ALPHA_T alpha = { DISPMANX_FLAGS_ALPHA_FROM_SOURCE, 255, 0 };
+    if (sl->yOffsetMax <= 0 || sl->yOffsetMax > sl->image->height)
+    {
+        sl->yOffsetMax = sl->image->height;
+    }
+
+    if (sl->viewWidth > sl->xOffsetMax) sl->viewWidth = sl->xOffsetMax;
+    if (sl->viewHeight > sl->yOffsetMax) sl->viewHeight = sl->yOffsetMax;
+
+    sl->xOffset = wrapScrollingOffset(sl->xOffset, sl->xOffsetMax);
+    sl->yOffset = wrapScrollingOffset(sl->yOffset, sl->yOffsetMax);
+
+    sl->display = display;
+
+    layoutScrollingLayer(sl);
 
-    sl->element = vc_dispmanx_element_add(update,
-                                          display,
-                                          sl->layer,
-                                          &(sl->dstRect),
-                                          sl->frontResource,
-                                          &(sl->srcRect),
-                                          DISPMANX_PROTECTION_NONE,
-                                          &alpha,
-                                          NULL,
-                                          DISPMANX_NO_ROTATE);
-    assert(sl->element != 0);
+    int32_t i = 0;
+    for (i = 0 ; i < sl->tiles ; i++)
+    {
+        addTileScrollingLayer(sl, &(sl->tile[i]), sl->frontResource, update);
+    }
 }
 
 //-------------------------------------------------------------------------
@@ -209,21 +315,10 @@ void
 setScrollingLayer(
     SCROLLING_LAYER_T *sl)
 {
-    sl->xOffset += sl->xStepper;
-
-    if (sl->xOffset < 0) {
-        sl->xOffset = sl->xOffsetMax + sl->xOffset;
-    } else if (sl->xOffset > sl->xOffsetMax) {
-        sl->xOffset = sl->xOffset - sl->xOffsetMax;
-    }
-
-    sl->yOffset += sl->yStepper;
-
-    if (sl->yOffset < 0) {
-        sl->yOffset = sl->yOffsetMax + sl->yOffset;
-    } else if (sl->yOffset > sl->yOffsetMax) {
-        sl->yOffset = sl->yOffset - sl->yOffsetMax;
-    }
+    sl->xOffset = wrapScrollingOffset(sl->xOffset + sl->xStepper,
+                                      sl->xOffsetMax);
+    sl->yOffset = wrapScrollingOffset(sl->yOffset + sl->yStepper,
+                                      sl->yOffsetMax);
     sl->scroll_step_flag = 1;
 }
 
@@ -253,11 +348,18 @@ void writeFlagScrollingLayer(
                                              &(sl->fullRect));
     assert(result == 0);
 
-    if (sl->element != 0) {
+    if (sl->tiles > 0) {
 	DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
 	assert(update != 0);
-	result = vc_dispmanx_element_modified(update, sl->element, &(sl->dstRect) );
-	assert(result == 0);
+
+	int32_t i = 0;
+	for (i = 0 ; i < sl->tiles ; i++) {
+	    result = vc_dispmanx_element_modified(update,
+	                                          sl->tile[i].element,
+	                                          &(sl->tile[i].dstRect) );
+	    assert(result == 0);
+	}
+
 	result = vc_dispmanx_update_submit_sync(update);
 	assert(result == 0);
     }
@@ -276,27 +378,51 @@ updateScrollingLayer(
     sl->image_write_flag = 0;
     sl->scroll_step_flag = 0;
 
-    int result = vc_dispmanx_element_change_source( update, sl->element, sl->backResource);
-    assert(result == 0);
+    layoutScrollingLayer(sl);
 
-    result = vc_dispmanx_rect_set(&(sl->srcRect),
-                         sl->xOffset << 16,
-                         sl->yOffset << 16,
-                         sl->viewWidth << 16,
-                         sl->viewHeight << 16);
-    assert(result == 0);
+    int result = 0;
+    int32_t i = 0;
 
-    result = 
-    vc_dispmanx_element_change_attributes(update,
-                                          sl->element,
-                                          ELEMENT_CHANGE_SRC_RECT,
-                                          0,
-                                          255,
-                                          &(sl->dstRect),
-                                          &(sl->srcRect),
-                                          0,
-                                          DISPMANX_NO_ROTATE);
-    assert(result == 0);
+    for (i = 0 ; i < SCROLLING_LAYER_ELEMENTS ; i++)
+    {
+        SCROLLING_LAYER_TILE_T *tile = &(sl->tile[i]);
+
+        if (i >= sl->tiles)
+        {
+            // The view no longer straddles this seam.
+
+            if (tile->element != 0)
+            {
+                result = vc_dispmanx_element_remove(update, tile->element);
+                assert(result == 0);
+                tile->element = 0;
+            }
+        }
+        else if (tile->element == 0)
+        {
+            addTileScrollingLayer(sl, tile, sl->backResource, update);
+        }
+        else
+        {
+            result = vc_dispmanx_element_change_source(update,
+                                                       tile->element,
+                                                       sl->backResource);
+            assert(result == 0);
+
+            result = 
+            vc_dispmanx_element_change_attributes(update,
+                                                  tile->element,
+                                                  ELEMENT_CHANGE_SRC_RECT |
+                                                  ELEMENT_CHANGE_DEST_RECT,
+                                                  0,
+                                                  255,
+                                                  &(tile->dstRect),
+                                                  &(tile->srcRect),
+                                                  0,
+                                                  DISPMANX_NO_ROTATE);
+            assert(result == 0);
+        }
+    }
 
     //---------------------------------------------------------------------
 
@@ -315,8 +441,18 @@ destroyScrollingLayer(
 
     DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(0);
     assert(update != 0);
-    result = vc_dispmanx_element_remove(update, sl->element);
-    assert(result == 0);
+
+    int32_t i = 0;
+    for (i = 0 ; i < SCROLLING_LAYER_ELEMENTS ; i++)
+    {
+        if (sl->tile[i].element != 0)
+        {
+            result = vc_dispmanx_element_remove(update, sl->tile[i].element);
+            assert(result == 0);
+            sl->tile[i].element = 0;
+        }
+    }
+
     result = vc_dispmanx_update_submit_sync(update);
     assert(result == 0);
 
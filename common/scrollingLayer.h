@@ -36,6 +36,18 @@
 
 //-------------------------------------------------------------------------
 
+// A view that straddles the right and/or bottom edge of the image is
+// drawn with one element per wrapped quadrant, so at most four.
+
+#define SCROLLING_LAYER_ELEMENTS 4
+
+typedef struct
+{
+    VC_RECT_T srcRect;
+    VC_RECT_T dstRect;
+    DISPMANX_ELEMENT_HANDLE_T element;
+} SCROLLING_LAYER_TILE_T;
+
 typedef struct
 {
     IMAGE_T *image;
@@ -51,13 +63,13 @@ typedef struct
     int32_t dstOffsetY;
     int16_t xStepper;
     int16_t yStepper;
-    VC_RECT_T srcRect;
-    VC_RECT_T dstRect;
     VC_RECT_T fullRect;
     int32_t layer;
     DISPMANX_RESOURCE_HANDLE_T frontResource;
     DISPMANX_RESOURCE_HANDLE_T backResource;
-    DISPMANX_ELEMENT_HANDLE_T element;
+    DISPMANX_DISPLAY_HANDLE_T display;
+    int32_t tiles;	// tiles in use for the current offset
+    SCROLLING_LAYER_TILE_T tile[SCROLLING_LAYER_ELEMENTS];
 } SCROLLING_LAYER_T;
 
 //-------------------------------------------------------------------------
@@ -26,8 +26,13 @@
 //
 //-------------------------------------------------------------------------
 
+#include <string.h>
+
 #include "bits.h"
+#include "imageConvert.h"
+#include "imageSpan.h"
 #include "simple_font.h"
+#include "utf8.h"
 
 //-------------------------------------------------------------------------
 
@@ -4645,56 +4650,240 @@ uint8_t font[256][FONT_HEIGHT] =
 
 //-------------------------------------------------------------------------
 
-void
-drawCharIndexed(
+// The font is code page 437. These are the Unicode characters of its upper
+// half, sorted by codepoint.
+
+typedef struct
+{
+    uint16_t codepoint;
+    uint8_t glyph;
+} FONT_CODEPOINT_T;
+
+static const FONT_CODEPOINT_T fontCodepoints[128] =
+{
+    { 0x00A0, 0xFF }, { 0x00A1, 0xAD }, { 0x00A2, 0x9B }, { 0x00A3, 0x9C },
+    { 0x00A5, 0x9D }, { 0x00AA, 0xA6 }, { 0x00AB, 0xAE }, { 0x00AC, 0xAA },
+    { 0x00B0, 0xF8 }, { 0x00B1, 0xF1 }, { 0x00B2, 0xFD }, { 0x00B5, 0xE6 },
+    { 0x00B7, 0xFA }, { 0x00BA, 0xA7 }, { 0x00BB, 0xAF }, { 0x00BC, 0xAC },
+    { 0x00BD, 0xAB }, { 0x00BF, 0xA8 }, { 0x00C4, 0x8E }, { 0x00C5, 0x8F },
+    { 0x00C6, 0x92 }, { 0x00C7, 0x80 }, { 0x00C9, 0x90 }, { 0x00D1, 0xA5 },
+    { 0x00D6, 0x99 }, { 0x00DC, 0x9A }, { 0x00DF, 0xE1 }, { 0x00E0, 0x85 },
+    { 0x00E1, 0xA0 }, { 0x00E2, 0x83 }, { 0x00E4, 0x84 }, { 0x00E5, 0x86 },
+    { 0x00E6, 0x91 }, { 0x00E7, 0x87 }, { 0x00E8, 0x8A }, { 0x00E9, 0x82 },
+    { 0x00EA, 0x88 }, { 0x00EB, 0x89 }, { 0x00EC, 0x8D }, { 0x00ED, 0xA1 },
+    { 0x00EE, 0x8C }, { 0x00EF, 0x8B }, { 0x00F1, 0xA4 }, { 0x00F2, 0x95 },
+    { 0x00F3, 0xA2 }, { 0x00F4, 0x93 }, { 0x00F6, 0x94 }, { 0x00F7, 0xF6 },
+    { 0x00F9, 0x97 }, { 0x00FA, 0xA3 }, { 0x00FB, 0x96 }, { 0x00FC, 0x81 },
+    { 0x00FF, 0x98 }, { 0x0192, 0x9F }, { 0x0393, 0xE2 }, { 0x0398, 0xE9 },
+    { 0x03A3, 0xE4 }, { 0x03A6, 0xE8 }, { 0x03A9, 0xEA }, { 0x03B1, 0xE0 },
+    { 0x03B4, 0xEB }, { 0x03B5, 0xEE }, { 0x03C0, 0xE3 }, { 0x03C3, 0xE5 },
+    { 0x03C4, 0xE7 }, { 0x03C6, 0xED }, { 0x207F, 0xFC }, { 0x20A7, 0x9E },
+    { 0x2219, 0xF9 }, { 0x221A, 0xFB }, { 0x221E, 0xEC }, { 0x2229, 0xEF },
+    { 0x2248, 0xF7 }, { 0x2261, 0xF0 }, { 0x2264, 0xF3 }, { 0x2265, 0xF2 },
+    { 0x2310, 0xA9 }, { 0x2320, 0xF4 }, { 0x2321, 0xF5 }, { 0x2500, 0xC4 },
+    { 0x2502, 0xB3 }, { 0x250C, 0xDA }, { 0x2510, 0xBF }, { 0x2514, 0xC0 },
+    { 0x2518, 0xD9 }, { 0x251C, 0xC3 }, { 0x2524, 0xB4 }, { 0x252C, 0xC2 },
+    { 0x2534, 0xC1 }, { 0x253C, 0xC5 }, { 0x2550, 0xCD }, { 0x2551, 0xBA },
+    { 0x2552, 0xD5 }, { 0x2553, 0xD6 }, { 0x2554, 0xC9 }, { 0x2555, 0xB8 },
+    { 0x2556, 0xB7 }, { 0x2557, 0xBB }, { 0x2558, 0xD4 }, { 0x2559, 0xD3 },
+    { 0x255A, 0xC8 }, { 0x255B, 0xBE }, { 0x255C, 0xBD }, { 0x255D, 0xBC },
+    { 0x255E, 0xC6 }, { 0x255F, 0xC7 }, { 0x2560, 0xCC }, { 0x2561, 0xB5 },
+    { 0x2562, 0xB6 }, { 0x2563, 0xB9 }, { 0x2564, 0xD1 }, { 0x2565, 0xD2 },
+    { 0x2566, 0xCB }, { 0x2567, 0xCF }, { 0x2568, 0xD0 }, { 0x2569, 0xCA },
+    { 0x256A, 0xD8 }, { 0x256B, 0xD7 }, { 0x256C, 0xCE }, { 0x2580, 0xDF },
+    { 0x2584, 0xDC }, { 0x2588, 0xDB }, { 0x258C, 0xDD }, { 0x2590, 0xDE },
+    { 0x2591, 0xB0 }, { 0x2592, 0xB1 }, { 0x2593, 0xB2 }, { 0x25A0, 0xFE }
+};
+
+//-------------------------------------------------------------------------
+
+uint8_t
+nextFontGlyph(
+    const char **string)
+{
+    uint32_t codepoint;
+
+    if ((decodeUtf8(string, &codepoint) == false) || (codepoint < 0x80))
+    {
+        return codepoint;
+    }
+
+    int32_t low = 0;
+    int32_t high = 127;
+
+    while (low <= high)
+    {
+        int32_t middle = (low + high) / 2;
+
+        if (fontCodepoints[middle].codepoint == codepoint)
+        {
+            return fontCodepoints[middle].glyph;
+        }
+        else if (fontCodepoints[middle].codepoint < codepoint)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return '?';
+}
+
+//-------------------------------------------------------------------------
+//
+// Glyphs that are not cut by the sides of the clip rectangle are written
+// straight into the buffer a row of eight pixels at a time, see the glyph
+// kernels in imageSpan.h. That needs the pixel value packed for the image
+// type, which is worked out once per string. 4BPP and dithered images,
+// and glyphs cut by the clip, are drawn a pixel at a time.
+//
+//-------------------------------------------------------------------------
+
+typedef struct
+{
+    VC_IMAGE_TYPE_T type;
+    uint8_t value[4];
+    const RGBA8_T *rgb;
+    int8_t index;
+} FONT_PIXEL_T;
+
+//-------------------------------------------------------------------------
+
+static bool
+fontPixelIndexed(
+    FONT_PIXEL_T *pixel,
+    int8_t index,
+    const IMAGE_T *image)
+{
+    pixel->type = image->type;
+    pixel->value[0] = index;
+    pixel->rgb = NULL;
+    pixel->index = index;
+
+    return (image->type == VC_IMAGE_8BPP) && (image->setPixelIndexed != NULL);
+}
+
+//-------------------------------------------------------------------------
+
+static bool
+fontPixelRGB(
+    FONT_PIXEL_T *pixel,
+    const RGBA8_T *rgb,
+    const IMAGE_T *image)
+{
+    pixel->type = image->type;
+    pixel->rgb = rgb;
+    pixel->index = 0;
+
+    if ((image->setPixelDirect == NULL) || isImageDithered(image))
+    {
+        return false;
+    }
+
+    return convertImageRow(VC_IMAGE_RGBA32,
+                           rgb,
+                           0,
+                           image->type,
+                           pixel->value,
+                           0,
+                           1,
+                           NULL);
+}
+
+//-------------------------------------------------------------------------
+
+// Draw rows first to last - 1 of a glyph whose eight columns are all
+// inside the clip rectangle.
+
+static void
+drawFontGlyph(
     int x,
     int y,
+    int first,
+    int last,
     uint8_t c,
-    int8_t index,
+    const FONT_PIXEL_T *pixel,
     IMAGE_T *image)
 {
-    int j;
-    for (j = 0 ; j < FONT_HEIGHT ; j++)
+    const uint8_t *rows = font[c] + first;
+    size_t count = last - first;
+    uint8_t *line = (uint8_t *)(image->buffer) + ((y + first) * image->pitch);
+
+    switch (pixel->type)
     {
-        uint8_t byte = font[c][j];
+    case VC_IMAGE_8BPP:
 
-        if (byte != 0)
-        {
-            int i;
-            for (i = 0 ; i < FONT_WIDTH ; ++i)
-            {
-                if ((byte >> (FONT_WIDTH - i - 1)) & 1 )
-                {
-                    setPixelIndexed(image, x + i, y + j, 1, index);
-                }
-            }
-        }
+        spanGlyph8(line + x, image->pitch, pixel->value[0], rows, count);
+        break;
+
+    case VC_IMAGE_RGB565:
+    case VC_IMAGE_RGBA16:
+    {
+        uint16_t value;
+        memcpy(&value, pixel->value, sizeof(value));
+        spanGlyph16((uint16_t *)line + x, image->pitch, value, rows, count);
+        break;
+    }
+    case VC_IMAGE_RGB888:
+
+        spanGlyph24(line + (3 * x), image->pitch, pixel->value, rows, count);
+        break;
+
+    case VC_IMAGE_RGBA32:
+    {
+        uint32_t value;
+        memcpy(&value, pixel->value, sizeof(value));
+        spanGlyph32((uint32_t *)line + x, image->pitch, value, rows, count);
+        break;
+    }
+    default:
+
+        break;
     }
 }
 
 //-------------------------------------------------------------------------
 
-void
-drawCharRGB(
+static void
+drawFontGlyphByPixel(
     int x,
     int y,
     uint8_t c,
-    const RGBA8_T *rgb,
+    const FONT_PIXEL_T *pixel,
     IMAGE_T *image)
 {
+    VC_RECT_T box = { .x = x, .y = y, .width = FONT_WIDTH, .height = FONT_HEIGHT };
+
+    if (clipImageRect(image, &box) == false)
+    {
+        return;
+    }
+
+    markImageDirty(image, box.x, box.y, box.width, box.height);
+
     int j;
-    for (j = 0 ; j < FONT_HEIGHT ; j++)
+    for (j = box.y - y ; j < box.y + box.height - y ; j++)
     {
         uint8_t byte = font[c][j];
 
         if (byte != 0)
         {
             int i;
-            for (i = 0 ; i < FONT_WIDTH ; ++i)
+            for (i = box.x - x ; i < box.x + box.width - x ; ++i)
             {
                 if ((byte >> (FONT_WIDTH - i - 1)) & 1 )
                 {
-                    setPixelRGB(image, x + i, y + j, 1, rgb);
+                    if (pixel->rgb != NULL)
+                    {
+                        setPixelRGB(image, x + i, y + j, 1, pixel->rgb);
+                    }
+                    else
+                    {
+                        setPixelIndexed(image, x + i, y + j, 1, pixel->index);
+                    }
                 }
             }
         }
@@ -4703,67 +4892,170 @@ drawCharRGB(
 
 //-------------------------------------------------------------------------
 
-void
-drawStringIndexed(
+static void
+drawFontChar(
     int x,
     int y,
-    const char *string,
-    int8_t index,
+    uint8_t c,
+    const FONT_PIXEL_T *pixel,
+    bool direct,
     IMAGE_T *image)
 {
-    if (string == NULL)
+    VC_RECT_T box = { .x = x, .y = y, .width = FONT_WIDTH, .height = FONT_HEIGHT };
+
+    if (clipImageRect(image, &box) == false)
     {
         return;
     }
 
+    if (direct && (box.width == FONT_WIDTH))
+    {
+        markImageDirty(image, box.x, box.y, box.width, box.height);
+        drawFontGlyph(x, y, box.y - y, box.y + box.height - y, c, pixel, image);
+    }
+    else
+    {
+        drawFontGlyphByPixel(x, y, c, pixel, image);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+// The clip rectangle is applied once for each line of the string, rather
+// than for each glyph, and each line is marked dirty as a whole.
+
+static void
+drawFontString(
+    int x,
+    int y,
+    const char *string,
+    const FONT_PIXEL_T *pixel,
+    bool direct,
+    IMAGE_T *image)
+{
+    const VC_RECT_T *clip = &(image->clip);
     int x_first = x;
 
     while (*string != '\0')
     {
+        int first = clip->y - y;
+        int last = clip->y + clip->height - y;
+
+        if (first < 0) first = 0;
+        if (last > FONT_HEIGHT) last = FONT_HEIGHT;
+
+        bool visible = (first < last);
+
+        while ((*string != '\0') && (*string != '\n'))
+        {
+            uint8_t c = nextFontGlyph(&string);
+
+            if (visible == false)
+            {
+                continue;
+            }
+            else if (direct &&
+                     (x >= clip->x) &&
+                     (x + FONT_WIDTH <= clip->x + clip->width))
+            {
+                drawFontGlyph(x, y, first, last, c, pixel, image);
+            }
+            else if ((x + FONT_WIDTH > clip->x) &&
+                     (x < clip->x + clip->width))
+            {
+                drawFontGlyphByPixel(x, y, c, pixel, image);
+            }
+
+            x += FONT_WIDTH;
+        }
+
+        int left = (x_first > clip->x) ? x_first : clip->x;
+        int right = (x < clip->x + clip->width) ? x : clip->x + clip->width;
+
+        if (visible && (left < right))
+        {
+            markImageDirty(image, left, y + first, right - left, last - first);
+        }
+
         if (*string == '\n')
         {
             x = x_first;
             y += FONT_HEIGHT;
+            ++string;
         }
-        else
-        {
-            drawCharIndexed(x, y, *string, index, image);
-            x += FONT_WIDTH;
-        }
-        ++string;
     }
 }
 
 //-------------------------------------------------------------------------
 
 void
-drawStringRGB(
+drawCharIndexed(
     int x,
     int y,
-    const char *string,
+    uint8_t c,
+    int8_t index,
+    IMAGE_T *image)
+{
+    FONT_PIXEL_T pixel;
+    bool direct = fontPixelIndexed(&pixel, index, image);
+
+    drawFontChar(x, y, c, &pixel, direct, image);
+}
+
+//-------------------------------------------------------------------------
+
+void
+drawCharRGB(
+    int x,
+    int y,
+    uint8_t c,
     const RGBA8_T *rgb,
     IMAGE_T *image)
+{
+    FONT_PIXEL_T pixel;
+    bool direct = fontPixelRGB(&pixel, rgb, image);
+
+    drawFontChar(x, y, c, &pixel, direct, image);
+}
+
+//-------------------------------------------------------------------------
+
+void
+drawStringIndexed(
+    int x,
+    int y,
+    const char *string,
+    int8_t index,
+    IMAGE_T *image)
 {
     if (string == NULL)
     {
         return;
     }
 
-    int x_first = x;
+    FONT_PIXEL_T pixel;
+    bool direct = fontPixelIndexed(&pixel, index, image);
 
-    while (*string != '\0')
+    drawFontString(x, y, string, &pixel, direct, image);
+}
+
+//-------------------------------------------------------------------------
+
+void
+drawStringRGB(
+    int x,
+    int y,
+    const char *string,
+    const RGBA8_T *rgb,
+    IMAGE_T *image)
+{
+    if (string == NULL)
     {
-        if (*string == '\n')
-        {
-            x = x_first;
-            y += FONT_HEIGHT;
-        }
-        else
-        {
-            drawCharRGB(x, y, *string, rgb, image);
-            x += FONT_WIDTH;
-        }
-        ++string;
+        return;
     }
-}
 
+    FONT_PIXEL_T pixel;
+    bool direct = fontPixelRGB(&pixel, rgb, image);
+
+    drawFontString(x, y, string, &pixel, direct, image);
+}
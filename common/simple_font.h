@@ -40,6 +40,15 @@
 
 //-------------------------------------------------------------------------
 
+// Strings are UTF-8, drawn with the font's code page 437 glyphs. Characters
+// it does not have are drawn as '?', and bytes that are not UTF-8 are taken
+// as code page 437. This returns the glyph for the character at *string
+// and steps past it.
+
+uint8_t
+nextFontGlyph(
+    const char **string);
+
 void
 drawCharIndexed(
     int x,
@@ -0,0 +1,109 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#ifndef UTF8_H
+#define UTF8_H
+
+//-------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------------------
+
+// Decode the character at *string and step past it. If the bytes are not
+// well formed UTF-8 (overlong, truncated, a surrogate or beyond U+10FFFF)
+// only the first byte is used, as the codepoint, and the result is false.
+// That lets strings in a single byte encoding still draw.
+
+static inline bool
+decodeUtf8(
+    const char **string,
+    uint32_t *codepoint)
+{
+    const uint8_t *s = (const uint8_t *)*string;
+    uint32_t c = s[0];
+    uint32_t least = 0;
+    int32_t length = 0;
+
+    if (c < 0x80)
+    {
+        *codepoint = c;
+        *string += 1;
+        return true;
+    }
+    else if ((c & 0xE0) == 0xC0)
+    {
+        c &= 0x1F;
+        least = 0x80;
+        length = 1;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        c &= 0x0F;
+        least = 0x800;
+        length = 2;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        c &= 0x07;
+        least = 0x10000;
+        length = 3;
+    }
+
+    // A continuation byte is never '\0', so this stops at the end of the
+    // string.
+
+    int32_t i;
+    for (i = 1 ; i <= length ; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            length = 0;
+            break;
+        }
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+
+    if ((length == 0) ||
+        (c < least) ||
+        (c > 0x10FFFF) ||
+        ((c >= 0xD800) && (c <= 0xDFFF)))
+    {
+        *codepoint = s[0];
+        *string += 1;
+        return false;
+    }
+
+    *codepoint = c;
+    *string += length + 1;
+    return true;
+}
+
+//-------------------------------------------------------------------------
+
+#endif
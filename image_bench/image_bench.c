@@ -0,0 +1,367 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bcm_host.h"
+
+#include "image.h"
+#include "imageSpan.h"
+
+//-------------------------------------------------------------------------
+
+#define NDEBUG
+
+//-------------------------------------------------------------------------
+
+const char* program = NULL;
+
+static const char *typeNames[] =
+{
+    "4BPP", "8BPP", "RGB565", "RGB888", "RGBA16", "RGBA32"
+};
+
+//-------------------------------------------------------------------------
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1.0e9);
+}
+
+//-------------------------------------------------------------------------
+//
+// The byte doubling fill that image.c used before the span kernels. Kept
+// here as the baseline the kernels are measured against.
+//
+//-------------------------------------------------------------------------
+
+static void
+memfill(
+    void *dest,
+    size_t destsize,
+    size_t elemsize)
+{
+    void *nextdest = dest + elemsize;
+    size_t movesize, donesize = elemsize;
+
+    while (destsize)
+    {
+        movesize = (donesize < destsize) ? donesize : destsize;
+        memcpy(nextdest, dest, movesize);
+        nextdest += movesize;
+        destsize -= movesize;
+        donesize += movesize;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+clearMemfill(
+    IMAGE_T *image,
+    const RGBA8_T *rgb)
+{
+    size_t elemsize = (image->bitsPerPixel < 8) ? 1 : image->bitsPerPixel / 8;
+    size_t destsize = (image->pitch * image->height) - elemsize;
+
+    if (image->setPixelDirect != NULL)
+    {
+        image->setPixelDirect(image, 0, 0, 1, rgb);
+    }
+    else
+    {
+        image->setPixelIndexed(image, 0, 0, 2, 1);
+    }
+
+    memfill(image->buffer, destsize, elemsize);
+}
+
+//-------------------------------------------------------------------------
+
+static void
+clearSpan(
+    IMAGE_T *image,
+    const RGBA8_T *rgb)
+{
+    if (image->setPixelDirect != NULL)
+    {
+        clearImageRGB(image, rgb);
+    }
+    else
+    {
+        clearImageIndexed(image, 1);
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static double
+timeClear(
+    IMAGE_T *image,
+    void (*clear)(IMAGE_T *, const RGBA8_T *),
+    int32_t iterations)
+{
+    RGBA8_T rgb = { 0x12, 0x34, 0x56, 0x78 };
+
+    clear(image, &rgb);
+
+    double start = now();
+
+    int32_t i;
+    for (i = 0 ; i < iterations ; i++)
+    {
+        rgb.red = i;
+        clear(image, &rgb);
+    }
+
+    return (now() - start) / iterations;
+}
+
+//-------------------------------------------------------------------------
+//
+// The pixel at a time copy that copyImageRGB() used for images of
+// different types before the row converters.
+//
+//-------------------------------------------------------------------------
+
+static void
+copyPerPixel(
+    IMAGE_T *src,
+    IMAGE_T *dst)
+{
+    RGBA8_T rgb;
+
+    int32_t y;
+    for (y = 0 ; y < src->height ; y++)
+    {
+        int32_t x;
+        for (x = 0 ; x < src->width ; x++)
+        {
+            getPixelRGB(src, x, y, &rgb);
+            setPixelRGB(dst, x, y, 1, &rgb);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------
+
+static void
+copyConverted(
+    IMAGE_T *src,
+    IMAGE_T *dst)
+{
+    copyImageRGB(src, dst, 0, 0, src->width, src->height, 0, 0);
+}
+
+//-------------------------------------------------------------------------
+
+static double
+timeCopy(
+    IMAGE_T *src,
+    IMAGE_T *dst,
+    void (*copy)(IMAGE_T *, IMAGE_T *),
+    int32_t iterations)
+{
+    copy(src, dst);
+
+    double start = now();
+
+    int32_t i;
+    for (i = 0 ; i < iterations ; i++)
+    {
+        copy(src, dst);
+    }
+
+    return (now() - start) / iterations;
+}
+
+//-------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    int opt = 0;
+
+    int32_t width = 1920;
+    int32_t height = 1080;
+    int32_t iterations = 100;
+
+    program = basename(argv[0]);
+
+    //-------------------------------------------------------------------
+
+    while ((opt = getopt(argc, argv, "w:h:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+
+            width = atoi(optarg);
+            break;
+
+        case 'h':
+
+            height = atoi(optarg);
+            break;
+
+        case 'n':
+
+            iterations = atoi(optarg);
+            break;
+
+        default:
+
+            fprintf(stderr, "Usage: %s ", program);
+            fprintf(stderr, "[-w <width>] [-h <height>] [-n <iterations>]\n");
+            fprintf(stderr, "    -w - width of the test image\n");
+            fprintf(stderr, "    -h - height of the test image\n");
+            fprintf(stderr, "    -n - number of times to repeat each test\n");
+
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    if ((width < 1) || (height < 1) || (iterations < 1))
+    {
+        fprintf(stderr, "%s: invalid image size or iteration count\n", program);
+        exit(EXIT_FAILURE);
+    }
+
+    //-------------------------------------------------------------------
+
+    printf("clear %dx%d, %d iterations, span kernels: %s\n\n",
+           width,
+           height,
+           iterations,
+           spanImplementation());
+
+    printf("%-8s %12s %12s %12s %12s %8s\n",
+           "type",
+           "memfill ms",
+           "MB/s",
+           "span ms",
+           "MB/s",
+           "speedup");
+
+    size_t i;
+    for (i = 0 ; i < sizeof(typeNames) / sizeof(typeNames[0]) ; i++)
+    {
+        IMAGE_TYPE_INFO_T typeInfo;
+
+        if (findImageType(&typeInfo, typeNames[i], IMAGE_TYPES_ALL) == false)
+        {
+            continue;
+        }
+
+        IMAGE_T image;
+        initImage(&image, typeInfo.type, width, height, false);
+
+        double bytes = ((double)width * height * image.bitsPerPixel) / 8.0;
+
+        double memfillTime = timeClear(&image, clearMemfill, iterations);
+        double spanTime = timeClear(&image, clearSpan, iterations);
+
+        printf("%-8s %12.3f %12.1f %12.3f %12.1f %7.2fx\n",
+               typeInfo.name,
+               memfillTime * 1.0e3,
+               bytes / memfillTime / 1.0e6,
+               spanTime * 1.0e3,
+               bytes / spanTime / 1.0e6,
+               memfillTime / spanTime);
+
+        destroyImage(&image);
+    }
+
+    //-------------------------------------------------------------------
+
+    int32_t copyIterations = (iterations + 9) / 10;
+
+    printf("\ncopyImageRGB %dx%d, %d iterations\n\n",
+           width,
+           height,
+           copyIterations);
+
+    printf("%-16s %12s %12s %8s\n",
+           "conversion",
+           "per pixel ms",
+           "row ms",
+           "speedup");
+
+    size_t j;
+    for (i = 2 ; i < sizeof(typeNames) / sizeof(typeNames[0]) ; i++)
+    {
+        for (j = 2 ; j < sizeof(typeNames) / sizeof(typeNames[0]) ; j++)
+        {
+            IMAGE_TYPE_INFO_T srcInfo;
+            IMAGE_TYPE_INFO_T dstInfo;
+
+            if ((i == j) ||
+                (findImageType(&srcInfo, typeNames[i], IMAGE_TYPES_ALL) == false) ||
+                (findImageType(&dstInfo, typeNames[j], IMAGE_TYPES_ALL) == false))
+            {
+                continue;
+            }
+
+            IMAGE_T src;
+            IMAGE_T dst;
+            initImage(&src, srcInfo.type, width, height, false);
+            initImage(&dst, dstInfo.type, width, height, false);
+
+            RGBA8_T rgb = { 0x12, 0x34, 0x56, 0x78 };
+            clearImageRGB(&src, &rgb);
+
+            double pixelTime = timeCopy(&src, &dst, copyPerPixel, copyIterations);
+            double rowTime = timeCopy(&src, &dst, copyConverted, copyIterations);
+
+            char name[32];
+            snprintf(name, sizeof(name), "%s>%s", srcInfo.name, dstInfo.name);
+
+            printf("%-16s %12.3f %12.3f %7.2fx\n",
+                   name,
+                   pixelTime * 1.0e3,
+                   rowTime * 1.0e3,
+                   pixelTime / rowTime);
+
+            destroyImage(&src);
+            destroyImage(&dst);
+        }
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,195 @@
+//-------------------------------------------------------------------------
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Andrew Duncan
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//-------------------------------------------------------------------------
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bcm_host.h"
+
+#include "image.h"
+#include "imageRaw.h"
+#include "loadpng.h"
+
+//-----------------------------------------------------------------------
+
+const char* program = NULL;
+
+//-----------------------------------------------------------------------
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: %s ", program);
+    fprintf(stderr, "[-d] [-t <type>] <file.png> [<file.raw>]\n");
+    fprintf(stderr, "    -d - dither\n");
+    fprintf(stderr, "    -t - type of image to create\n");
+    fprintf(stderr, "         can be one of the following:");
+    printImageTypes(stderr, " ", "", IMAGE_TYPES_ALL_DIRECT_COLOUR);
+    fprintf(stderr, "\n");
+
+    exit(EXIT_FAILURE);
+}
+
+//-----------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    int opt = 0;
+
+    bool dither = false;
+    const char* imageTypeName = "RGBA32";
+
+    program = basename(argv[0]);
+
+    //-------------------------------------------------------------------
+
+    while ((opt = getopt(argc, argv, "dt:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+
+            dither = true;
+            break;
+
+        case 't':
+
+            imageTypeName = optarg;
+            break;
+
+        default:
+
+            usage();
+            break;
+        }
+    }
+
+    if ((optind >= argc) || (argc - optind > 2))
+    {
+        usage();
+    }
+
+    //-------------------------------------------------------------------
+
+    IMAGE_TYPE_INFO_T typeInfo;
+
+    if (findImageType(&typeInfo,
+                      imageTypeName,
+                      IMAGE_TYPES_ALL_DIRECT_COLOUR) == false)
+    {
+        fprintf(stderr,
+                "%s: unknown image type %s\n",
+                program,
+                imageTypeName);
+
+        exit(EXIT_FAILURE);
+    }
+
+    //-------------------------------------------------------------------
+
+    const char *pngFile = argv[optind];
+    char *rawFile = NULL;
+
+    if (optind + 1 < argc)
+    {
+        rawFile = strdup(argv[optind + 1]);
+    }
+    else
+    {
+        // replace the .png extension (if there is one) with .raw
+
+        rawFile = malloc(strlen(pngFile) + 5);
+
+        if (rawFile != NULL)
+        {
+            strcpy(rawFile, pngFile);
+
+            char *extension = strrchr(rawFile, '.');
+
+            if ((extension != NULL) && (strcasecmp(extension, ".png") == 0))
+            {
+                *extension = '\0';
+            }
+
+            strcat(rawFile, ".raw");
+        }
+    }
+
+    if (rawFile == NULL)
+    {
+        fprintf(stderr, "%s: memory exhausted\n", program);
+        exit(EXIT_FAILURE);
+    }
+
+    //-------------------------------------------------------------------
+
+    IMAGE_T png;
+
+    if (loadPng(&png, pngFile) == false)
+    {
+        fprintf(stderr, "%s: unable to load %s\n", program, pngFile);
+        exit(EXIT_FAILURE);
+    }
+
+    IMAGE_T image;
+
+    if (typeInfo.type == png.type)
+    {
+        image = png;
+    }
+    else
+    {
+        initImage(&image, typeInfo.type, png.width, png.height, dither);
+        copyImageRGB(&png, &image, 0, 0, png.width, png.height, 0, 0);
+        destroyImage(&png);
+    }
+
+    //-------------------------------------------------------------------
+
+    bool saved = saveImageRaw(&image, rawFile, NULL, 0);
+
+    if (saved)
+    {
+        printf("%s: %s -> %s (%dx%d %s)\n",
+               program,
+               pngFile,
+               rawFile,
+               image.width,
+               image.height,
+               typeInfo.name);
+    }
+
+    destroyImage(&image);
+    free(rawFile);
+
+    return (saved) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
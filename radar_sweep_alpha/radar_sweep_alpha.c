@@ -39,6 +39,7 @@
 #include "bcm_host.h"
 
 #include "image.h"
+#include "imageGraphics.h"
 #include "imagePalette.h"
 #include "key.h"
 
@@ -118,31 +119,24 @@ int main(int argc, char *argv[])
 
     //---------------------------------------------------------------------
 
+    // One sector for each of the 254 palette entries that are rotated,
+    // starting from the negative x axis. A sector takes in pixels up to
+    // half a pixel outside its radius, so the rim is a little wider than
+    // the old x^2 + y^2 <= r^2 test drew it.
+
     int32_t r = size / 2;
-    int32_t r2 = r * r;
+    double step = (2.0 * M_PI) / 254.0;
 
-    int32_t y;
-    for (y = 0 ; y < image.height ; y++)
+    int32_t i;
+    for (i = 0 ; i < 254 ; i++)
     {
-        int32_t x;
-        for (x = 0 ; x < image.width ; x++)
-        {
-            int32_t i = x - (size / 2);
-            int32_t j = y - (size / 2);
-
-            if (((i * i) + (j * j)) <= r2)
-            {
-                double angle = atan2(j, i) + M_PI;
-                int32_t i = (int32_t)(floor(angle * 254.0 / (2*M_PI))) + 1;
-
-                if (i > 255)
-                {
-                    i = 255;
-                }
-
-                setPixelIndexed(&image, x, y, 1, i);
-            }
-        }
+        imageSectorIndexed(&image,
+                           size / 2,
+                           size / 2,
+                           r,
+                           (i * step) - M_PI,
+                           ((i + 1) * step) - M_PI,
+                           i + 1);
     }
 
     //---------------------------------------------------------------------
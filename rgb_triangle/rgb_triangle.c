@@ -39,6 +39,7 @@
 
 #include "element_change.h"
 #include "image.h"
+#include "imageGradient.h"
 #include "key.h"
 
 //-----------------------------------------------------------------------
@@ -206,32 +207,23 @@ int main(int argc, char *argv[])
     int32_t x_offset = (modeInfo.width - width) / 2;
     int32_t y_offset = (modeInfo.height - height) / 2;
 
-    int32_t y;
-    for (y = 0 ; y < 256 ; y++)
-    {
-        int32_t x;
-        for (x = 0 ; x < 256 ; x++)
-        {
-            RGBA8_T rgba;
+    // red, green and blue corners on a black background. The corners are
+    // placed so that the pixel centres sample the triangle the old per
+    // pixel formula drew, red = 255 - x - y/2 and green = x - y/2.
 
-            if (((255 - x - (y/2)) >= 0)&& ((x - (y/2)) >= 0))
-            {
-                rgba.red = 255 - x - (y/2);
-                rgba.green = x - (y/2);
-                rgba.blue = 255 - rgba.red - rgba.green;
-                rgba.alpha = 255;
-            }
-            else
-            {
-                rgba.red = 0;
-                rgba.green = 0;
-                rgba.blue = 0;
-                rgba.alpha = 255;
-            }
+    RGBA8_T black = { 0, 0, 0, 255 };
+    RGBA8_T red = { 255, 0, 0, 255 };
+    RGBA8_T green = { 0, 255, 0, 255 };
+    RGBA8_T blue = { 0, 0, 255, 255 };
 
-            setPixelRGB(&image, x, y, 1, &rgba);
-        }
-    }
+    IMAGE_GRADIENT_T gradient;
+    initImageGradientTriangle(&gradient,
+                              0.0f, 0.5f, &red,
+                              256.0f, 0.5f, &green,
+                              128.0f, 257.0f, &blue);
+
+    clearImageRGB(&image, &black);
+    imageTriangleGradientRGB(&image, &gradient);
 
     //---------------------------------------------------------------------
 
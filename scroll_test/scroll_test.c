@@ -137,7 +137,6 @@ int main(int argc, char *argv[])
 	int y2 = ((s_height * 3) / 30) * (y + 1);
 	imageBoxFilledRGB( &vert_image, x1, y1, x2, y2, &rgb );
     }
-    expand_and_duplicate_Image( &vert_image, 0, s_height );
     initScrollingLayerImage( &vert_scroll, &vert_image, s_width - margin - margin, s_height - margin - margin, 3);
     setDirectionScrollingLayer( &vert_scroll, 0, 3 );
 
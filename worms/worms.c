@@ -33,6 +33,7 @@
 
 #include "hsv2rgb.h"
 #include "image.h"
+#include "imageDiff.h"
 #include "worms.h"
 
 #include "bcm_host.h"
@@ -193,6 +194,8 @@ initWorms(
     DISPMANX_MODEINFO_T *info)
 {
     initImage(&(worms->image), imageType, info->width, info->height, false);
+    initImage(&(worms->snapshot), imageType, info->width, info->height, false);
+    worms->previousChanges.count = 0;
     srand(time(NULL));
 
     worms->size = number;
@@ -247,6 +250,13 @@ initWorms(
                                              worms->image.buffer,
                                              &dst_rect);
     assert(result == 0);
+
+    result = vc_dispmanx_resource_write_data(worms->backResource,
+                                             worms->image.type,
+                                             worms->image.pitch,
+                                             worms->image.buffer,
+                                             &dst_rect);
+    assert(result == 0);
 }
 
 //-------------------------------------------------------------------------
@@ -293,19 +303,48 @@ void
 writeDataWorms(
     WORMS_T *worms)
 {
-    VC_RECT_T dst_rect;
-    vc_dispmanx_rect_set(&dst_rect,
-                         0,
-                         0,
-                         worms->image.width,
-                         worms->image.height);
+    // Every worm is undrawn and drawn again each frame, but only a few
+    // pixels at each end of a worm really change. The back resource was
+    // written two frames ago, so it needs the rows that changed in the
+    // last frame as well as in this one.
 
-    int result = vc_dispmanx_resource_write_data(worms->backResource,
-                                                 worms->image.type,
-                                                 worms->image.pitch,
-                                                 worms->image.buffer,
-                                                 &dst_rect);
-    assert(result == 0);
+    markImageChanges(&(worms->image), &(worms->snapshot));
+
+    IMAGE_DIRTY_T changes = worms->image.dirty;
+    worms->image.dirty = worms->previousChanges;
+    worms->previousChanges = changes;
+
+    int32_t i = 0;
+    for (i = 0 ; i < changes.count ; i++)
+    {
+        addImageDirtyRect(&(worms->image.dirty),
+                          changes.rects[i].x,
+                          changes.rects[i].y,
+                          changes.rects[i].width,
+                          changes.rects[i].height);
+    }
+
+    // vc_dispmanx_resource_write_data() only uses the y and height of
+    // the rectangle, so whole rows are written.
+
+    for (i = 0 ; i < worms->image.dirty.count ; i++)
+    {
+        VC_RECT_T dst_rect;
+        vc_dispmanx_rect_set(&dst_rect,
+                             0,
+                             worms->image.dirty.rects[i].y,
+                             worms->image.width,
+                             worms->image.dirty.rects[i].height);
+
+        int result = vc_dispmanx_resource_write_data(worms->backResource,
+                                                     worms->image.type,
+                                                     worms->image.pitch,
+                                                     worms->image.buffer,
+                                                     &dst_rect);
+        assert(result == 0);
+    }
+
+    clearImageDirty(&(worms->image));
 }
 
 //-------------------------------------------------------------------------
@@ -387,6 +426,7 @@ destroyWorms(
     worms->worms = NULL;
 
     destroyImage(&(worms->image));
+    destroyImage(&(worms->snapshot));
 
 
     //---------------------------------------------------------------------
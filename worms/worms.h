@@ -56,6 +56,8 @@ typedef struct
     uint16_t size;
     WORM_T *worms;
     IMAGE_T image;
+    IMAGE_T snapshot;
+    IMAGE_DIRTY_T previousChanges;
     DISPMANX_RESOURCE_HANDLE_T frontResource;
     DISPMANX_RESOURCE_HANDLE_T backResource;
     DISPMANX_ELEMENT_HANDLE_T element;